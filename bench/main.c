@@ -0,0 +1,123 @@
+// For dup and fdopen
+#define _POSIX_C_SOURCE 200809L
+#include "chrono.h"
+#include "gfx/gfx.h"
+#include "job.h"
+#include "result.h"
+#include "util.h"
+#include "voxel/perlin.h"
+#include "voxel/region.h"
+#include "voxel/region_cpu_meshing.h"
+#include "voxel/region_management.h"
+#include "voxel/voxel.h"
+#include <cglm/types-struct.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define DEFAULT_NUM_BENCH_REGIONS 2048
+
+static uint64_t get_num_region_faces(void) {
+    uint64_t num_faces = 0;
+    for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
+        num_faces += region_render_pipeline_infos[region_index].num_faces;
+    }
+    return num_faces;
+}
+
+// Usage: bench.elf [number of regions] [JSON output path]
+// The JSON goes to stdout without a path, everything the engine logs goes to stderr so stdout only holds the JSON
+// Exits with 1 if any mesh checked against the CPU mesher differs
+int main(int argc, char* argv[]) {
+    size_t num_requested_regions = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_NUM_BENCH_REGIONS;
+    const char* output_path = argc > 2 ? argv[2] : NULL;
+
+    int json_fd = dup(STDOUT_FILENO);
+    if (json_fd == -1 || dup2(STDERR_FILENO, STDOUT_FILENO) == -1) {
+        print_result_error(result_file_open_failure);
+        return 1;
+    }
+
+    result_t result;
+    if ((result = init_jobs()) != result_success) {
+        print_result_error(result);
+        return 1;
+    }
+    if ((result = init_gfx(gfx_mode_headless)) != result_success) {
+        print_result_error(result);
+        return 1;
+    }
+
+    // The regions placed by init warm up the pipelines and aren't measured
+    if ((result = build_gfx_regions()) != result_success) {
+        print_result_error(result);
+        return 1;
+    }
+
+    // The GPU meshes are checked against the CPU mesher once, so a broken mesher doesn't go unnoticed behind good numbers
+    region_mesh_verification_t mesh_verification;
+    if ((result = verify_gfx_region_meshes(&mesh_verification)) != result_success) {
+        print_result_error(result);
+        return 1;
+    }
+
+    // Every round moves the camera a whole view diameter so all regions are placed anew
+    size_t num_rounds = div_ceil_uint32((uint32_t) num_requested_regions, NUM_REGIONS);
+    uint64_t num_vertices = 0;
+    microseconds_t elapsed = 0;
+
+    for (size_t round = 1; round <= num_rounds; round++) {
+        vec3s camera_position = {{ (float) (round * REGION_VIEW_DIAMETER * REGION_SIZE), 0.0f, 0.0f }};
+
+        microseconds_t start = get_current_microseconds();
+        if ((result = update_region_management(camera_position)) != result_success) {
+            print_result_error(result);
+            return 1;
+        }
+        if ((result = build_gfx_regions()) != result_success) {
+            print_result_error(result);
+            return 1;
+        }
+        elapsed += get_current_microseconds() - start;
+
+        num_vertices += NUM_CUBE_VOXEL_FACE_VERTICES * get_num_region_faces();
+
+        // Nothing is drawn, so replaced faces can be released as if every frame in flight had finished
+        for (size_t i = 0; i < NUM_FRAMES_IN_FLIGHT; i++) {
+            advance_deferred_region_face_frees();
+        }
+    }
+
+    size_t num_regions = num_rounds * NUM_REGIONS;
+    double seconds = (double) elapsed / 1000000.0;
+
+    FILE* output = output_path != NULL ? fopen(output_path, "w") : fdopen(json_fd, "w");
+    if (output_path != NULL) {
+        close(json_fd);
+    }
+    if (output == NULL) {
+        print_result_error(result_file_open_failure);
+        return 1;
+    }
+
+    fprintf(output, "{\"num_regions\": %lu, \"seconds\": %.6f, \"regions_per_second\": %.3f, \"voxels_per_second\": %.3f, \"vertices_per_region\": %.3f, \"peak_device_memory_bytes\": %lu, \"perlin_simd_level\": \"%s\", \"cpu_meshing_simd_level\": \"%s\", \"verified_meshes\": %lu, \"mismatched_meshes\": %lu}\n",
+        num_regions,
+        seconds,
+        (double) num_regions / seconds,
+        (double) num_regions * (double) (REGION_SIZE * REGION_SIZE * REGION_SIZE) / seconds,
+        (double) num_vertices / (double) num_regions,
+        get_gfx_peak_device_memory_usage(),
+        simd_level_names[get_perlin_simd_level()],
+        simd_level_names[get_region_cpu_meshing_simd_level()],
+        mesh_verification.num_verified_regions,
+        mesh_verification.num_mismatched_regions
+    );
+
+    fclose(output);
+
+    term_gfx();
+    term_jobs();
+
+    return mesh_verification.num_mismatched_regions == 0 ? 0 : 1;
+}
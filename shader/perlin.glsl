@@ -1,5 +1,59 @@
-// Using perlin noise from https://www.shadertoy.com/view/NlSGDz
 #ifndef PERLIN_GLSL
 #define PERLIN_GLSL
-#include "../lib/perlin.glsl"
-#endif
\ No newline at end of file
+
+// Mirrors src/voxel/perlin.c operation for operation so the CPU generator gives the same bits, precise keeps the operations from being fused
+
+uint get_perlin_hash(uint x, uint y, uint seed) {
+    uint hash = (x * 0x8da6b343u) ^ (y * 0xd8163841u) ^ seed;
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    hash *= 0x846ca68bu;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// The two lowest hash bits pick one of the four diagonal gradients
+float get_perlin_gradient_dot(uint hash, float dx, float dy) {
+    precise float dot = ((hash & 1u) != 0 ? -dx : dx) + ((hash & 2u) != 0 ? -dy : dy);
+    return dot;
+}
+
+float get_perlin_fade(float t) {
+    precise float fade = t * t * t * (t * (t * 6.0 - 15.0) + 10.0);
+    return fade;
+}
+
+float get_perlin(vec2 position, uint seed) {
+    vec2 floor_position = floor(position);
+    uvec2 cell = uvec2(ivec2(floor_position));
+    precise vec2 delta = position - floor_position;
+    precise vec2 next_delta = delta - 1.0;
+
+    float n00 = get_perlin_gradient_dot(get_perlin_hash(cell.x, cell.y, seed), delta.x, delta.y);
+    float n10 = get_perlin_gradient_dot(get_perlin_hash(cell.x + 1u, cell.y, seed), next_delta.x, delta.y);
+    float n01 = get_perlin_gradient_dot(get_perlin_hash(cell.x, cell.y + 1u, seed), delta.x, next_delta.y);
+    float n11 = get_perlin_gradient_dot(get_perlin_hash(cell.x + 1u, cell.y + 1u, seed), next_delta.x, next_delta.y);
+
+    float u = get_perlin_fade(delta.x);
+    float v = get_perlin_fade(delta.y);
+    precise float nx0 = n00 + u * (n10 - n00);
+    precise float nx1 = n01 + u * (n11 - n01);
+    precise float noise = nx0 + v * (nx1 - nx0);
+    return noise;
+}
+
+// The octaves are summed without normalising, each one within about [-1, 1] times its amplitude
+float get_perlin_fbm(vec2 position, float frequency, uint num_octaves, float persistence, float lacunarity, uint seed) {
+    precise float value = 0.0;
+    precise float amplitude = 1.0;
+    for (uint octave = 0; octave < num_octaves; octave++) {
+        precise vec2 octave_position = position * frequency;
+        value = value + amplitude * get_perlin(octave_position, seed + octave);
+        amplitude *= persistence;
+        frequency *= lacunarity;
+    }
+    return value;
+}
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef REGION_FACE_GLSL
+#define REGION_FACE_GLSL
+#include "../src/gfx/region_face.h"
+
+struct region_face_t {
+    uint position_data;
+    uint face_data;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "voxel.glsl"
+#include "region_meshing.glsl"
+
+// Each workgroup meshes one face direction, each invocation one slice of the region along that direction's axis
+// Each invocation is a meshing cell, the ones past the region's last slice at coarser levels of detail stay empty
+layout(local_size_x = 32) in;
+
+const ivec3 face_normals[NUM_CUBE_VOXEL_FACES] = {
+    ivec3(1, 0, 0),
+    ivec3(-1, 0, 0),
+    ivec3(0, 1, 0),
+    ivec3(0, -1, 0),
+    ivec3(0, 0, 1),
+    ivec3(0, 0, -1)
+};
+
+// Bit u of consumed_rows[v] is set once the face at (u, v) in the slice has been merged into a quad
+uint consumed_rows[REGION_SIZE];
+
+ivec3 get_slice_position(uint normal_axis, int slice, int u, int v) {
+    ivec3 position;
+    position[normal_axis] = slice;
+    position[(normal_axis + 1) % 3] = u;
+    position[(normal_axis + 2) % 3] = v;
+    return position;
+}
+
+uint get_visible_face_voxel_type(uint face_index, ivec3 voxel_sampler_position) {
+    uint voxel_type = get_voxel_type(voxel_sampler_position);
+    if (voxel_type == VOXEL_TYPE_AIR || get_voxel_type(voxel_sampler_position + face_normals[face_index]) != VOXEL_TYPE_AIR) {
+        return VOXEL_TYPE_AIR;
+    }
+    return voxel_type;
+}
+
+void main() {
+    uint face_index = gl_WorkGroupID.x;
+    uint normal_axis = face_index / 2;
+    int slice = int(gl_LocalInvocationID.x);
+    int size = get_region_lod_size();
+    int num_slice_rows = slice < size ? size : 0;
+
+#ifdef REGION_MESHING_WRITE_PASS
+    uint faces_index = face_offsets[gl_GlobalInvocationID.x];
+#else
+    uint num_cell_faces = 0;
+    uvec3 cell_box_min = uvec3(REGION_SIZE);
+    uvec3 cell_box_max = uvec3(0);
+#endif
+
+    for (int v = 0; v < size; v++) {
+        consumed_rows[v] = 0;
+    }
+
+    for (int v = 0; v < num_slice_rows; v++) {
+        for (int u = 0; u < size; u++) {
+            if ((consumed_rows[v] & (1u << u)) != 0) {
+                continue;
+            }
+
+            uint voxel_type = get_visible_face_voxel_type(face_index, get_slice_position(normal_axis, slice, u, v));
+            if (voxel_type == VOXEL_TYPE_AIR) {
+                continue;
+            }
+
+            int width = 1;
+            while (u + width < size && (consumed_rows[v] & (1u << (u + width))) == 0 && get_visible_face_voxel_type(face_index, get_slice_position(normal_axis, slice, u + width, v)) == voxel_type) {
+                width++;
+            }
+            uint row_mask = (width == int(REGION_SIZE) ? 0xffffffffu : ((1u << width) - 1u)) << u;
+
+            int height = 1;
+            for (; v + height < size; height++) {
+                if ((consumed_rows[v + height] & row_mask) != 0) {
+                    break;
+                }
+
+                bool is_row_mergeable = true;
+                for (int i = 0; i < width; i++) {
+                    if (get_visible_face_voxel_type(face_index, get_slice_position(normal_axis, slice, u + i, v + height)) != voxel_type) {
+                        is_row_mergeable = false;
+                        break;
+                    }
+                }
+                if (!is_row_mergeable) {
+                    break;
+                }
+            }
+
+            for (int i = 0; i < height; i++) {
+                consumed_rows[v + i] |= row_mask;
+            }
+
+#ifdef REGION_MESHING_WRITE_PASS
+            add_face(uvec3(get_slice_position(normal_axis, slice, u, v)), voxel_type, faces_index, face_index, uint(width), uint(height));
+            faces_index++;
+#else
+            num_cell_faces++;
+            cell_box_min = min(cell_box_min, uvec3(get_slice_position(normal_axis, slice, u, v)));
+            cell_box_max = max(cell_box_max, uvec3(get_slice_position(normal_axis, slice, u + width - 1, v + height - 1)));
+#endif
+
+            u += width - 1;
+        }
+    }
+
+#ifndef REGION_MESHING_WRITE_PASS
+    face_offsets[gl_GlobalInvocationID.x] = num_cell_faces;
+    if (num_cell_faces != 0) {
+        include_in_mesh_box(cell_box_min, cell_box_max);
+    }
+#endif
+}
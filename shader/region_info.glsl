@@ -0,0 +1,14 @@
+#ifndef REGION_INFO_GLSL
+#define REGION_INFO_GLSL
+
+// Matches region_info_t in region_management.c
+struct region_info_t {
+    ivec3 region_position;
+    uint first_face;
+    uint num_faces;
+    // Level of detail the faces were meshed at
+    uint lod;
+    uint padding[2];
+};
+
+#endif
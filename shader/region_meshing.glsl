@@ -0,0 +1,103 @@
+#ifndef REGION_MESHING_GLSL
+#define REGION_MESHING_GLSL
+#include "voxel.glsl"
+#include "region_face.glsl"
+#include "../src/voxel/region.h"
+
+// Meshing runs twice per region, the count pass only fills in face_offsets while the write pass (REGION_MESHING_WRITE_PASS) emits the faces
+// Each meshing cell (a workgroup or an invocation, depending on the mesher) must emit the same faces in both passes
+layout(set = 0, binding = 0) buffer face_offsets_t {
+    // Number of faces of each meshing cell after the count pass, index of each cell's first face after the scan pass
+    uint face_offsets[];
+};
+
+layout(push_constant, std430) uniform push_constants_t {
+    // Bit i is set when the neighbouring region across voxel face i has been generated and is meshed at the same level of detail
+    uint neighbour_mask;
+    // Index of the region's first face in the shared face buffer, only used by the write pass
+    uint first_face;
+    // Positions are in voxels of this level of detail, of which the region has REGION_SIZE >> lod per axis
+    uint lod;
+    // Bit i is set when the neighbouring region across voxel face i is meshed at another level of detail
+    uint seam_mask;
+};
+
+#ifndef REGION_MESHING_WRITE_PASS
+layout(set = 0, binding = 1) buffer mesh_info_t {
+    // Written by the scan pass
+    uint num_faces;
+    // Bounds of the voxels with visible faces, cleared to an empty box before the count pass
+    uint box_min[3];
+    uint box_max[3];
+};
+
+void include_in_mesh_box(uvec3 voxel_min_position, uvec3 voxel_max_position) {
+    for (uint axis = 0; axis < 3; axis++) {
+        atomicMin(box_min[axis], voxel_min_position[axis]);
+        atomicMax(box_max[axis], voxel_max_position[axis]);
+    }
+}
+#endif
+
+// The region's own voxel image followed by the images of its neighbours, indexed by voxel face index
+layout(set = 1, binding = 0) uniform usampler3D voxel_samplers[1 + NUM_CUBE_VOXEL_FACES];
+
+uint fetch_voxel_type(uint sampler_index, ivec3 voxel_sampler_position) {
+    // Sampler arrays may only be indexed dynamically with uniform indices
+    int level = int(lod);
+    switch (sampler_index) {
+        case 0: return texelFetch(voxel_samplers[0], voxel_sampler_position, level).x;
+        case 1: return texelFetch(voxel_samplers[1], voxel_sampler_position, level).x;
+        case 2: return texelFetch(voxel_samplers[2], voxel_sampler_position, level).x;
+        case 3: return texelFetch(voxel_samplers[3], voxel_sampler_position, level).x;
+        case 4: return texelFetch(voxel_samplers[4], voxel_sampler_position, level).x;
+        case 5: return texelFetch(voxel_samplers[5], voxel_sampler_position, level).x;
+        default: return texelFetch(voxel_samplers[6], voxel_sampler_position, level).x;
+    }
+}
+
+int get_region_lod_size() {
+    return int(REGION_SIZE >> lod);
+}
+
+// Positions may lie at most one voxel outside the region across a single face
+uint get_voxel_type(ivec3 voxel_sampler_position) {
+    int size = get_region_lod_size();
+
+    uint face_index = NUM_CUBE_VOXEL_FACES;
+    for (uint axis = 0; axis < 3; axis++) {
+        if (voxel_sampler_position[axis] >= size) {
+            face_index = 2 * axis;
+        } else if (voxel_sampler_position[axis] < 0) {
+            face_index = 2 * axis + 1;
+        }
+    }
+
+    if (face_index == NUM_CUBE_VOXEL_FACES) {
+        return fetch_voxel_type(0, voxel_sampler_position);
+    }
+    // The surfaces of two levels of detail don't line up along their border, so each region closes its side with faces instead of leaving cracks
+    if ((seam_mask & (1u << face_index)) != 0) {
+        return VOXEL_TYPE_AIR;
+    }
+    // Without a generated neighbour the border voxel is compared against itself, the region is remeshed once the neighbour is generated
+    if ((neighbour_mask & (1u << face_index)) == 0) {
+        return fetch_voxel_type(0, clamp(voxel_sampler_position, ivec3(0), ivec3(size - 1)));
+    }
+    return fetch_voxel_type(1 + face_index, voxel_sampler_position & ivec3(size - 1));
+}
+
+#ifdef REGION_MESHING_WRITE_PASS
+layout(set = 2, binding = 0) writeonly buffer faces_out_t {
+    region_face_t faces[];
+};
+
+void add_face(uvec3 voxel_position, uint voxel_type, uint faces_index, uint face_index, uint face_width, uint face_height) {
+    faces[first_face + faces_index] = region_face_t(
+        (voxel_position.x << REGION_FACE_X_OFFSET) | (voxel_position.y << REGION_FACE_Y_OFFSET) | (voxel_position.z << REGION_FACE_Z_OFFSET) | (face_index << REGION_FACE_INDEX_OFFSET),
+        (voxel_type << REGION_FACE_VOXEL_TYPE_OFFSET) | ((face_width - 1) << REGION_FACE_WIDTH_OFFSET) | ((face_height - 1) << REGION_FACE_HEIGHT_OFFSET)
+    );
+}
+#endif
+
+#endif
@@ -0,0 +1,85 @@
+#include "voxel.glsl"
+#include "region_meshing.glsl"
+
+// Each workgroup is a meshing cell, coarser levels of detail are dispatched with fewer workgroups
+layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+
+shared uint num_workgroup_faces;
+#ifndef REGION_MESHING_WRITE_PASS
+shared uint workgroup_box_min[3];
+shared uint workgroup_box_max[3];
+#endif
+
+void main() {
+    ivec3 voxel_sampler_position = ivec3(gl_GlobalInvocationID);
+    uint cell_index = gl_WorkGroupID.x + gl_NumWorkGroups.x * (gl_WorkGroupID.y + gl_NumWorkGroups.y * gl_WorkGroupID.z);
+
+    uint voxel_type = get_voxel_type(voxel_sampler_position);
+    // No early return for air since every invocation has to reach the barriers
+    bool is_solid = voxel_type != VOXEL_TYPE_AIR;
+
+    bool px_visible = is_solid && get_voxel_type(voxel_sampler_position + ivec3(1, 0, 0)) == VOXEL_TYPE_AIR;
+    bool nx_visible = is_solid && get_voxel_type(voxel_sampler_position - ivec3(1, 0, 0)) == VOXEL_TYPE_AIR;
+    bool py_visible = is_solid && get_voxel_type(voxel_sampler_position + ivec3(0, 1, 0)) == VOXEL_TYPE_AIR;
+    bool ny_visible = is_solid && get_voxel_type(voxel_sampler_position - ivec3(0, 1, 0)) == VOXEL_TYPE_AIR;
+    bool pz_visible = is_solid && get_voxel_type(voxel_sampler_position + ivec3(0, 0, 1)) == VOXEL_TYPE_AIR;
+    bool nz_visible = is_solid && get_voxel_type(voxel_sampler_position - ivec3(0, 0, 1)) == VOXEL_TYPE_AIR;
+
+    uint num_voxel_faces = uint(px_visible) + uint(nx_visible) + uint(py_visible) + uint(ny_visible) + uint(pz_visible) + uint(nz_visible);
+
+    if (gl_LocalInvocationIndex == 0) {
+        num_workgroup_faces = 0;
+#ifndef REGION_MESHING_WRITE_PASS
+        for (uint axis = 0; axis < 3; axis++) {
+            workgroup_box_min[axis] = 0xffffffffu;
+            workgroup_box_max[axis] = 0;
+        }
+#endif
+    }
+    barrier();
+    uint faces_index = atomicAdd(num_workgroup_faces, num_voxel_faces);
+
+#ifdef REGION_MESHING_WRITE_PASS
+    faces_index += face_offsets[cell_index];
+    uvec3 voxel_position = gl_GlobalInvocationID;
+
+    if (px_visible) {
+        add_face(voxel_position, voxel_type, faces_index, VOXEL_PX_FACE_INDEX, 1, 1);
+        faces_index++;
+    }
+    if (nx_visible) {
+        add_face(voxel_position, voxel_type, faces_index, VOXEL_NX_FACE_INDEX, 1, 1);
+        faces_index++;
+    }
+    if (py_visible) {
+        add_face(voxel_position, voxel_type, faces_index, VOXEL_PY_FACE_INDEX, 1, 1);
+        faces_index++;
+    }
+    if (ny_visible) {
+        add_face(voxel_position, voxel_type, faces_index, VOXEL_NY_FACE_INDEX, 1, 1);
+        faces_index++;
+    }
+    if (pz_visible) {
+        add_face(voxel_position, voxel_type, faces_index, VOXEL_PZ_FACE_INDEX, 1, 1);
+        faces_index++;
+    }
+    if (nz_visible) {
+        add_face(voxel_position, voxel_type, faces_index, VOXEL_NZ_FACE_INDEX, 1, 1);
+    }
+#else
+    // Reduced in shared memory first so each workgroup does only one set of global atomics
+    if (num_voxel_faces != 0) {
+        for (uint axis = 0; axis < 3; axis++) {
+            atomicMin(workgroup_box_min[axis], gl_GlobalInvocationID[axis]);
+            atomicMax(workgroup_box_max[axis], gl_GlobalInvocationID[axis]);
+        }
+    }
+    barrier();
+    if (gl_LocalInvocationIndex == 0) {
+        face_offsets[cell_index] = num_workgroup_faces;
+        if (num_workgroup_faces != 0) {
+            include_in_mesh_box(uvec3(workgroup_box_min[0], workgroup_box_min[1], workgroup_box_min[2]), uvec3(workgroup_box_max[0], workgroup_box_max[1], workgroup_box_max[2]));
+        }
+    }
+#endif
+}
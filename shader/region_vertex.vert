@@ -1,5 +1,7 @@
 #version 460
 #include "voxel.glsl"
+#include "region_face.glsl"
+#include "region_info.glsl"
 
 struct vertex_t {
     vec3 position;
@@ -55,19 +57,18 @@ layout(push_constant, std430) uniform push_constants_t {
     mat4 view_projection;
 };
 
-layout(set = 1, binding = 0) uniform uniform_t {
-    uvec3 region_position;
+// Indexed by region index, which every draw passes as its instance index
+layout(set = 1, binding = 0) readonly buffer region_infos_t {
+    region_info_t region_infos[];
 };
 
-layout(location = 0) in vec3 vertex_position;
-layout(location = 1) in uint vertex_index;
-layout(location = 2) in uint voxel_type;
+layout(set = 1, binding = 1) readonly buffer faces_t {
+    region_face_t faces[];
+};
 
 layout(location = 0) out vec3 vertex_texel_coord;
 
-float get_layer_index() {
-    uint face_index = vertex_index / NUM_CUBE_VOXEL_FACE_VERTICES;
-
+float get_layer_index(uint voxel_type, uint face_index) {
     switch (voxel_type) {
         case VOXEL_TYPE_GRASS: switch (face_index) {
             default: return 3.0;
@@ -81,9 +82,44 @@ float get_layer_index() {
 }
 
 void main() {
+    // Every face is drawn as NUM_CUBE_VOXEL_FACE_VERTICES vertices pulled from the same face record, the draw's first vertex points at the region's first face
+    region_face_t face = faces[gl_VertexIndex / NUM_CUBE_VOXEL_FACE_VERTICES];
+    region_info_t region_info = region_infos[gl_InstanceIndex];
+    // Faces of coarser levels of detail are positioned and sized in voxels of that level
+    float voxel_scale = float(1u << region_info.lod);
+
+    vec3 voxel_position = vec3(
+        bitfieldExtract(face.position_data, REGION_FACE_X_OFFSET, REGION_FACE_POSITION_BITS),
+        bitfieldExtract(face.position_data, REGION_FACE_Y_OFFSET, REGION_FACE_POSITION_BITS),
+        bitfieldExtract(face.position_data, REGION_FACE_Z_OFFSET, REGION_FACE_POSITION_BITS)
+    );
+    uint face_index = bitfieldExtract(face.position_data, REGION_FACE_INDEX_OFFSET, REGION_FACE_INDEX_BITS);
+    uint voxel_type = bitfieldExtract(face.face_data, REGION_FACE_VOXEL_TYPE_OFFSET, REGION_FACE_VOXEL_TYPE_BITS);
+    uint face_width = bitfieldExtract(face.face_data, REGION_FACE_WIDTH_OFFSET, REGION_FACE_SIZE_BITS) + 1;
+    uint face_height = bitfieldExtract(face.face_data, REGION_FACE_HEIGHT_OFFSET, REGION_FACE_SIZE_BITS) + 1;
+
+    uint vertex_index = NUM_CUBE_VOXEL_FACE_VERTICES * face_index + (uint(gl_VertexIndex) % NUM_CUBE_VOXEL_FACE_VERTICES);
+    uint normal_axis = face_index / 2;
+
+    // Merged faces are stretched along the two axes following the face's normal axis
+    vec3 face_extent = vec3(1.0);
+    face_extent[(normal_axis + 1) % 3] = float(face_width);
+    face_extent[(normal_axis + 2) % 3] = float(face_height);
+
+    vec2 texel_extent;
+    switch (normal_axis) {
+        case 0: texel_extent = face_extent.zy; break;
+        case 1: texel_extent = face_extent.xz; break;
+        default: texel_extent = face_extent.xy; break;
+    }
+
     vertex_t vertex = cube_vertices[vertex_index];
-    vec3 position = vec3(region_position) + vertex_position + vertex.position;
+    // Cube vertices span from -1 to 0 on the Z axis, so faces stretched along Z are shifted to cover the voxels after the first one
+    vec3 voxel_vertex_position = voxel_position + (vertex.position * face_extent) + vec3(0.0, 0.0, face_extent.z - 1.0);
+    // Scaled voxels are shifted along Z too, so they end where the last level 0 voxel they cover does
+    vec3 position = vec3(region_info.region_position) + voxel_scale * voxel_vertex_position + vec3(0.0, 0.0, voxel_scale - 1.0);
 
     gl_Position = view_projection * vec4(position, 1.0);
-    vertex_texel_coord = vec3(vertex.texel_coord, get_layer_index());
+    // Textures keep the density of level 0 voxels
+    vertex_texel_coord = vec3(vertex.texel_coord * texel_extent * voxel_scale, get_layer_index(voxel_type, face_index));
 }
\ No newline at end of file
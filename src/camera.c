@@ -1,5 +1,7 @@
 #include "camera.h"
 #include "gfx/gfx.h"
+#include "voxel/region.h"
+#include "voxel/region_management.h"
 #include <GLFW/glfw3.h>
 #include <cglm/struct/cam.h>
 #include <cglm/struct/vec2.h>
@@ -96,7 +98,9 @@ void camera_update(void) {
 
     float aspect = window_width/window_height;
 
-    mat4s projection = glms_perspective(M_TAU / 5.0f, aspect, 0.01f, 300.0f);
+    // Follows the view radius instead of cutting off distant regions, which cost little since they're meshed at coarser levels of detail
+    float far_distance = sqrtf(2.0f) * (float) ((REGION_VIEW_RADIUS + 1) * REGION_SIZE);
+    mat4s projection = glms_perspective(M_TAU / 5.0f, aspect, 0.01f, far_distance);
 
     vec2s desired_rot_vel = get_desired_rotational_velocity(aspect);
     cam_rot_vel = glms_vec2_lerp(cam_rot_vel, desired_rot_vel, 0.2f);
@@ -148,6 +152,10 @@ void camera_update(void) {
     // printf("%ff, %ff, %ff, %ff, %ff, %ff, %ff, %ff\n", cam_pos.x, cam_pos.y, cam_pos.z, cam_forward.x, cam_forward.y, cam_forward.z, cam_rot.x, cam_rot.y);
 }
 
+vec3s get_camera_position(void) {
+    return camera_position;
+}
+
 mat4s get_view_projection(void) {
     return camera_view_projection;
 }
\ No newline at end of file
@@ -2,4 +2,5 @@
 #include <cglm/types-struct.h>
 
 void camera_update(void);
+vec3s get_camera_position(void);
 mat4s get_view_projection(void);
\ No newline at end of file
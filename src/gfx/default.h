@@ -81,6 +81,10 @@ extern const VmaAllocationCreateInfo device_allocation_create_info;
     DEFAULT_VK_BUFFER,\
     .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
 
+#define DEFAULT_VK_STORAGE_BUFFER\
+    DEFAULT_VK_BUFFER,\
+    .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+
 #define DEFAULT_VK_UNIFORM_BUFFER\
     DEFAULT_VK_BUFFER,\
     .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
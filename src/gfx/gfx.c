@@ -1,16 +1,25 @@
 #include "gfx.h"
+#include "camera.h"
 #include "chrono.h"
 #include "gfx/default.h"
 #include "gfx/gfx_util.h"
+#include "gfx/gpu_profiler.h"
+#include "gfx/hi_z_compute_pipeline.h"
+#include "gfx/region_culling_compute_pipeline.h"
 #include "gfx/region_generation_compute_pipeline.h"
+#include "gfx/region_mesh_verification.h"
 #include "gfx/region_meshing_compute_pipeline.h"
 #include "gfx/region_render_pipeline.h"
+#include "gfx/upload.h"
 #include "result.h"
 #include "util.h"
 #include "vk_init.h"
+#include "voxel/region_culling.h"
 #include "voxel/region_management.h"
 #include <GLFW/glfw3.h>
+#include <assert.h>
 #include <cglm/types-struct.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,19 +29,33 @@
 #define WINDOW_WIDTH 640
 #define WINDOW_HEIGHT 480
 
-#define NUM_FRAMES_IN_FLIGHT 2
+#define REGION_GENERATION_MODE region_generation_mode_gpu
+#define REGION_MESHING_MODE region_meshing_mode_greedy
+#define REGION_CULLING_MODE region_culling_mode_gpu
+
+// The CPU mesher reads the voxels CPU generation left in staging memory
+static_assert(REGION_MESHING_MODE != region_meshing_mode_cpu || REGION_GENERATION_MODE == region_generation_mode_cpu);
+
+// Frames between printing the GPU pass timings
+#define GPU_PROFILE_PRINT_INTERVAL 256
 
 typedef union {
-    uint32_t data[2];
+    uint32_t data[4];
     struct {
         uint32_t graphics;
         uint32_t presentation;
+        // Same as the graphics family when the device has no dedicated compute family
+        uint32_t compute;
+        // Same as the graphics family when the device has no dedicated transfer family
+        uint32_t transfer;
     };
 } queue_family_indices_t;
 
 GLFWwindow* window;
 VkDevice device;
 VkQueue queue;
+VkQueue compute_queue;
+VkQueue transfer_queue;
 static VkPhysicalDevice physical_device;
 VmaAllocator allocator;
 static queue_family_indices_t queue_family_indices;
@@ -41,6 +64,9 @@ static VkPresentModeKHR present_mode;
 static VkSemaphore image_available_semaphores[NUM_FRAMES_IN_FLIGHT];
 static VkSemaphore render_finished_semaphores[NUM_FRAMES_IN_FLIGHT];
 static VkFence in_flight_fences[NUM_FRAMES_IN_FLIGHT];
+// Timeline semaphore reaching the number of frames that have finished rendering
+static VkSemaphore frame_semaphore;
+static uint64_t num_submitted_frames;
 static uint32_t num_swapchain_images;
 static VkImage* swapchain_images;
 static VkImageView* swapchain_image_views;
@@ -52,10 +78,15 @@ static VkExtent2D swap_image_extent;
 static VkQueue presentation_queue;
 static bool framebuffer_resized;
 static VkCommandPool command_pool;
+static gfx_mode_t gfx_mode;
+// Backs the only swapchain image when headless
+static VmaAllocation offscreen_image_allocation;
 
 VkSampleCountFlagBits render_multisample_flags;
 
 VkRenderPass frame_render_pass;
+// Continues the frame after the Hi-Z pyramid has been rebuilt from the depth of frame_render_pass, the two are compatible
+static VkRenderPass frame_second_render_pass;
 static VkCommandBuffer frame_command_buffers[NUM_FRAMES_IN_FLIGHT];
 
 static uint32_t frame_index = 0;
@@ -67,22 +98,36 @@ static VkImageView frame_image_view;
 static VkImage depth_image;
 static VmaAllocation depth_image_allocation;
 static VkImageView depth_image_view;
+// Only covers the depth aspect so the Hi-Z pyramid can sample it
+static VkImageView depth_sample_image_view;
 VkFormat depth_image_format;
 
 static VkCommandBuffer generic_command_buffer;
 static VkFence generic_command_fence;
 
+// Voxel generation runs on the compute queue so it doesn't hold up frames on devices with async compute
+static VkCommandPool compute_command_pool;
+static VkCommandBuffer compute_command_buffer;
+static VkFence compute_command_fence;
+
 static VkDescriptorPool generic_descriptor_pool;
 
+// Device local memory allocated by VMA, counted from its callbacks so allocations made and freed between samples still raise the peak
+static VkPhysicalDeviceMemoryProperties memory_properties;
+static VkDeviceSize device_memory_usage;
+static VkDeviceSize peak_device_memory_usage;
+
 static const char* layers[] = {
     "VK_LAYER_KHRONOS_validation"
 };
 
+// The swapchain extension comes first so headless runs can skip it
 static const char* extensions[] = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME,
     VK_EXT_MESH_SHADER_EXTENSION_NAME,
     VK_KHR_SPIRV_1_4_EXTENSION_NAME
 };
+#define NUM_HEADLESS_SKIPPED_EXTENSIONS 1
 
 static result_t check_layers(void) {
     uint32_t num_available_layers;
@@ -115,7 +160,7 @@ static result_t check_extensions(VkPhysicalDevice physical_device) {
     VkExtensionProperties available_extensions[num_available_extensions];
     vkEnumerateDeviceExtensionProperties(physical_device, NULL, &num_available_extensions, available_extensions);
 
-    for (size_t i = 0; i < NUM_ELEMS(extensions); i++) {
+    for (size_t i = gfx_mode == gfx_mode_headless ? NUM_HEADLESS_SKIPPED_EXTENSIONS : 0; i < NUM_ELEMS(extensions); i++) {
         bool not_found = true;
         for (size_t j = 0; j < num_available_extensions; j++) {
             if (strcmp(extensions[i], available_extensions[j].extensionName) == 0) {
@@ -141,6 +186,24 @@ static uint32_t get_graphics_queue_family_index(uint32_t num_queue_families, con
     return NULL_UINT32;
 }
 
+static uint32_t get_compute_queue_family_index(uint32_t num_queue_families, const VkQueueFamilyProperties queue_families[], uint32_t graphics_queue_family_index) {
+    for (uint32_t i = 0; i < num_queue_families; i++) {
+        if (!(queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+            return i;
+        }
+    }
+    return graphics_queue_family_index;
+}
+
+static uint32_t get_transfer_queue_family_index(uint32_t num_queue_families, const VkQueueFamilyProperties queue_families[], uint32_t graphics_queue_family_index) {
+    for (uint32_t i = 0; i < num_queue_families; i++) {
+        if (!(queue_families[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && (queue_families[i].queueFlags & VK_QUEUE_TRANSFER_BIT)) {
+            return i;
+        }
+    }
+    return graphics_queue_family_index;
+}
+
 static uint32_t get_presentation_queue_family_index(VkPhysicalDevice physical_device, uint32_t num_queue_families, const VkQueueFamilyProperties queue_families[]) {
     for (uint32_t i = 0; i < num_queue_families; i++) {
         if (!(queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
@@ -171,36 +234,50 @@ static result_t get_physical_device(uint32_t num_physical_devices, const VkPhysi
     for (size_t i = 0; i < num_physical_devices; i++) {
         VkPhysicalDevice physical_device = physical_devices[i];
 
-        // RenderDoc loads llvmpipe for some reason so this forces it to load the correct physical device
+        // RenderDoc loads llvmpipe for some reason so this forces it to load the correct physical device, headless runs are allowed to use software implementations
         VkPhysicalDeviceProperties physical_device_properties;
         vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
-        if (physical_device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU || physical_device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU || physical_device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_OTHER) {
+        if (gfx_mode == gfx_mode_windowed && (physical_device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU || physical_device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU || physical_device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_OTHER)) {
             continue;
         }
 
         VkPhysicalDeviceFeatures features;
         vkGetPhysicalDeviceFeatures(physical_device, &features);
 
-        if (!features.samplerAnisotropy) {
+        if (!features.samplerAnisotropy || !features.multiDrawIndirect || !features.drawIndirectFirstInstance) {
             continue;
         }
 
-        if ((result = check_extensions(physical_device)) != result_success) {
+        VkPhysicalDeviceVulkan12Features vulkan_12_features = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+        };
+        vkGetPhysicalDeviceFeatures2(physical_device, &(VkPhysicalDeviceFeatures2) {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &vulkan_12_features
+        });
+
+        if (!vulkan_12_features.drawIndirectCount || !vulkan_12_features.timelineSemaphore) {
             continue;
         }
-        
-        uint32_t num_surface_formats;
-        vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &num_surface_formats, NULL);
 
-        if (num_surface_formats == 0) {
+        if ((result = check_extensions(physical_device)) != result_success) {
             continue;
         }
+        
+        uint32_t num_surface_formats = 0;
+        uint32_t num_present_modes = 0;
+        if (gfx_mode == gfx_mode_windowed) {
+            vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &num_surface_formats, NULL);
 
-        uint32_t num_present_modes;
-        vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &num_present_modes, NULL);
+            if (num_surface_formats == 0) {
+                continue;
+            }
 
-        if (num_present_modes == 0) {
-            continue;
+            vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &num_present_modes, NULL);
+
+            if (num_present_modes == 0) {
+                continue;
+            }
         }
 
         uint32_t num_queue_families;
@@ -214,7 +291,7 @@ static result_t get_physical_device(uint32_t num_physical_devices, const VkPhysi
             continue;
         }
 
-        uint32_t presentation_queue_family_index = get_presentation_queue_family_index(physical_device, num_queue_families, queue_families);
+        uint32_t presentation_queue_family_index = gfx_mode == gfx_mode_headless ? graphics_queue_family_index : get_presentation_queue_family_index(physical_device, num_queue_families, queue_families);
         if (presentation_queue_family_index == NULL_UINT32) {
             break;
         }
@@ -222,7 +299,10 @@ static result_t get_physical_device(uint32_t num_physical_devices, const VkPhysi
         *out_physical_device = physical_device;
         *out_num_surface_formats = num_surface_formats;
         *out_num_present_modes = num_present_modes;
-        *out_queue_family_indices = (queue_family_indices_t) {{ graphics_queue_family_index, presentation_queue_family_index }};
+        uint32_t compute_queue_family_index = get_compute_queue_family_index(num_queue_families, queue_families, graphics_queue_family_index);
+        uint32_t transfer_queue_family_index = get_transfer_queue_family_index(num_queue_families, queue_families, graphics_queue_family_index);
+
+        *out_queue_family_indices = (queue_family_indices_t) {{ graphics_queue_family_index, presentation_queue_family_index, compute_queue_family_index, transfer_queue_family_index }};
         return result_success;
     }
     return result;
@@ -266,6 +346,24 @@ static VkExtent2D get_swap_image_extent(const VkSurfaceCapabilitiesKHR* capabili
     return extent;
 }
 
+// Stands in for the swapchain when headless, frames resolve into a single image that can be copied out afterwards
+static result_t init_offscreen_image(void) {
+    swap_image_extent = (VkExtent2D) { WINDOW_WIDTH, WINDOW_HEIGHT };
+    num_swapchain_images = 1;
+
+    if (vmaCreateImage(allocator, &(VkImageCreateInfo) {
+        DEFAULT_VK_IMAGE,
+        .extent.width = swap_image_extent.width,
+        .extent.height = swap_image_extent.height,
+        .format = surface_format.format,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+    }, &device_allocation_create_info, &swapchain_images[0], &offscreen_image_allocation, NULL) != VK_SUCCESS) {
+        return result_image_create_failure;
+    }
+
+    return result_success;
+}
+
 static result_t init_swapchain(void) {
     VkSurfaceCapabilitiesKHR capabilities;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &capabilities);
@@ -310,7 +408,9 @@ static result_t init_swapchain(void) {
 }
 
 static result_t init_swapchain_framebuffers(void) {
-    vkGetSwapchainImagesKHR(device, swapchain, &num_swapchain_images, swapchain_images);
+    if (gfx_mode == gfx_mode_windowed) {
+        vkGetSwapchainImagesKHR(device, swapchain, &num_swapchain_images, swapchain_images);
+    }
 
     for (size_t i = 0; i < num_swapchain_images; i++) {
         if (vkCreateImageView(device, &(VkImageViewCreateInfo) {
@@ -346,7 +446,7 @@ result_t init_swapchain_dependents(void) {
         .extent.height = swap_image_extent.height,
         .format = surface_format.format,
         .samples = render_multisample_flags,
-        .usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
     }, &device_allocation_create_info, &frame_image, &frame_image_allocation, NULL) != VK_SUCCESS) {
         return result_image_create_failure;
     }
@@ -366,7 +466,7 @@ result_t init_swapchain_dependents(void) {
         .extent.height = swap_image_extent.height,
         .format = depth_image_format,
         .samples = render_multisample_flags,
-        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
     }, &device_allocation_create_info, &depth_image, &depth_image_allocation, NULL) != VK_SUCCESS) {
         return result_image_create_failure;
     }
@@ -380,6 +480,15 @@ result_t init_swapchain_dependents(void) {
         return result_image_view_create_failure;
     }
 
+    if (vkCreateImageView(device, &(VkImageViewCreateInfo) {
+        DEFAULT_VK_IMAGE_VIEW,
+        .image = depth_image,
+        .format = depth_image_format,
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT
+    }, NULL, &depth_sample_image_view) != VK_SUCCESS) {
+        return result_image_view_create_failure;
+    }
+
     return result_success;
 }
 
@@ -387,6 +496,7 @@ void term_swapchain_dependents(void) {
     vkDestroyImageView(device, frame_image_view, NULL);
     vmaDestroyImage(allocator, frame_image, frame_image_allocation);
     vkDestroyImageView(device, depth_image_view, NULL);
+    vkDestroyImageView(device, depth_sample_image_view, NULL);
     vmaDestroyImage(allocator, depth_image, depth_image_allocation);
 }
 
@@ -396,7 +506,11 @@ static void term_swapchain(void) {
         vkDestroyFramebuffer(device, swapchain_framebuffers[i], NULL);
     }
     
-    vkDestroySwapchainKHR(device, swapchain, NULL);
+    if (gfx_mode == gfx_mode_headless) {
+        vmaDestroyImage(allocator, swapchain_images[0], offscreen_image_allocation);
+    } else {
+        vkDestroySwapchainKHR(device, swapchain, NULL);
+    }
 }
 
 void reinit_swapchain(void) {
@@ -411,11 +525,13 @@ void reinit_swapchain(void) {
     }
     //
     
+    term_hi_z_images();
     term_swapchain_dependents();
     term_swapchain();
     init_swapchain();
     init_swapchain_dependents();
     init_swapchain_framebuffers();
+    init_hi_z_images(swap_image_extent, depth_sample_image_view);
 }
 
 static void framebuffer_resize(GLFWwindow*, int, int) {
@@ -455,6 +571,151 @@ static VkSampleCountFlagBits get_max_multisample_flags(const VkPhysicalDevicePro
     return VK_SAMPLE_COUNT_1_BIT;
 }
 
+// Both passes share attachments and subpasses so they stay compatible, the first clears and keeps its attachments for the second which resolves into the swapchain image
+// The first pass's resolve is overwritten by the second
+static result_t create_frame_render_pass(region_culling_phase_t phase, VkRenderPass* render_pass) {
+    bool is_first_phase = phase == region_culling_phase_first;
+
+    if (vkCreateRenderPass(device, &(VkRenderPassCreateInfo) {
+        DEFAULT_VK_RENDER_PASS,
+
+        .attachmentCount = 3,
+        .pAttachments = (VkAttachmentDescription[3]) {
+            {
+                DEFAULT_VK_ATTACHMENT,
+                .format = surface_format.format,
+                .samples = render_multisample_flags,
+                .loadOp = is_first_phase ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                .initialLayout = is_first_phase ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+            },
+            {
+                DEFAULT_VK_ATTACHMENT,
+                .format = depth_image_format,
+                .samples = render_multisample_flags,
+                .loadOp = is_first_phase ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+                .storeOp = is_first_phase ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .initialLayout = is_first_phase ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                .finalLayout = is_first_phase ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+            },
+            {
+                DEFAULT_VK_ATTACHMENT,
+                .format = surface_format.format,
+                .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                .storeOp = is_first_phase ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
+                .finalLayout = is_first_phase ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : (gfx_mode == gfx_mode_headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
+            }
+        },
+
+        .pSubpasses = &(VkSubpassDescription) {
+            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &(VkAttachmentReference) {
+                .attachment = 0,
+                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+            },
+
+            .pDepthStencilAttachment = &(VkAttachmentReference) {
+                .attachment = 1,
+                .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+            },
+
+            .pResolveAttachments = &(VkAttachmentReference) {
+                .attachment = 2,
+                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+            }
+        },
+
+        // The Hi-Z pyramid is built from the depth of the first pass, and of the previous frame's first pass before this frame clears it
+        .dependencyCount = 2,
+        .pDependencies = (VkSubpassDependency[2]) {
+            {
+                .srcSubpass = VK_SUBPASS_EXTERNAL,
+                .dstSubpass = 0,
+                .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+            },
+            {
+                .srcSubpass = 0,
+                .dstSubpass = VK_SUBPASS_EXTERNAL,
+                .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+            }
+        }
+    }, NULL, render_pass) != VK_SUCCESS) {
+        return result_render_pass_create_failure;
+    }
+
+    return result_success;
+}
+
+static bool is_device_local_memory_type(uint32_t memory_type) {
+    return (memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type].heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+}
+
+static void VKAPI_PTR track_device_memory_allocation(VmaAllocator allocator, uint32_t memory_type, VkDeviceMemory memory, VkDeviceSize size, void* user_data) {
+    (void) allocator;
+    (void) memory;
+    (void) user_data;
+
+    if (!is_device_local_memory_type(memory_type)) {
+        return;
+    }
+    device_memory_usage += size;
+    if (device_memory_usage > peak_device_memory_usage) {
+        peak_device_memory_usage = device_memory_usage;
+    }
+}
+
+static void VKAPI_PTR track_device_memory_free(VmaAllocator allocator, uint32_t memory_type, VkDeviceMemory memory, VkDeviceSize size, void* user_data) {
+    (void) allocator;
+    (void) memory;
+    (void) user_data;
+
+    if (is_device_local_memory_type(memory_type)) {
+        device_memory_usage -= size;
+    }
+}
+
+static result_t process_regions(void) {
+    result_t result;
+
+    // Polled like the meshing batches, so frames keep going while the GPU generates
+    if ((result = complete_region_generation(REGION_GENERATION_MODE)) != result_success) {
+        return result;
+    }
+
+    // Slots left out by the last update may have been released by batches or the generation that finished since
+    if ((result = place_pending_regions()) != result_success) {
+        return result;
+    }
+
+    // Never waits on region files, loads finish on the I/O thread over later frames
+    if ((result = update_region_generation(REGION_GENERATION_MODE)) != result_success) {
+        return result;
+    }
+
+    // Generation rewrites voxel images, so it only runs while no meshing batch can be reading them
+    if (!is_region_generation_pending() && is_region_meshing_idle() && is_region_generation_ready(REGION_GENERATION_MODE)) {
+        if ((result = submit_region_generation_compute_pipeline(compute_command_buffer, REGION_GENERATION_MODE)) != result_success) {
+            return result;
+        }
+    }
+
+    // Regions of the generation in flight already await meshing, but their voxels and uniformity aren't known until it's completed
+    if (!is_region_generation_pending() && (result = update_region_meshing(REGION_MESHING_MODE)) != result_success) {
+        return result;
+    }
+
+    return result_success;
+}
+
 static result_t init_vk_core(void) {
     result_t result;
 
@@ -462,8 +723,11 @@ static result_t init_vk_core(void) {
         return result;
     }
 
-    uint32_t num_instance_extensions;
-    const char** instance_extensions = glfwGetRequiredInstanceExtensions(&num_instance_extensions);
+    uint32_t num_instance_extensions = 0;
+    const char** instance_extensions = NULL;
+    if (gfx_mode == gfx_mode_windowed) {
+        instance_extensions = glfwGetRequiredInstanceExtensions(&num_instance_extensions);
+    }
     
     if (vkCreateInstance(&(VkInstanceCreateInfo) {
         .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
@@ -483,7 +747,7 @@ static result_t init_vk_core(void) {
         return result_instance_create_failure;
     }
 
-    if (glfwCreateWindowSurface(instance, window, NULL, &surface) != VK_SUCCESS) {
+    if (gfx_mode == gfx_mode_windowed && glfwCreateWindowSurface(instance, window, NULL, &surface) != VK_SUCCESS) {
         return result_surface_create_failure;
     }
 
@@ -508,47 +772,87 @@ static result_t init_vk_core(void) {
     VkPhysicalDeviceProperties physical_device_properties;
     vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
     printf("Loaded physical device \"%s\"\n", physical_device_properties.deviceName);
+    if (queue_family_indices.compute != queue_family_indices.graphics) {
+        printf("Using dedicated compute queue family %u\n", queue_family_indices.compute);
+    }
+    if (queue_family_indices.transfer != queue_family_indices.graphics) {
+        printf("Using dedicated transfer queue family %u\n", queue_family_indices.transfer);
+    }
+
+    // Dedicated families get their own queue, the rest share the graphics queue
+    uint32_t num_queue_create_infos = 1;
+    VkDeviceQueueCreateInfo queue_create_infos[3] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = queue_family_indices.graphics,
+            .queueCount = 1,
+            .pQueuePriorities = (float[1]) { 1.0f }
+        }
+    };
+    if (queue_family_indices.compute != queue_family_indices.graphics) {
+        queue_create_infos[num_queue_create_infos++] = (VkDeviceQueueCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = queue_family_indices.compute,
+            .queueCount = 1,
+            .pQueuePriorities = (float[1]) { 0.5f }
+        };
+    }
+    if (queue_family_indices.transfer != queue_family_indices.graphics) {
+        queue_create_infos[num_queue_create_infos++] = (VkDeviceQueueCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = queue_family_indices.transfer,
+            .queueCount = 1,
+            .pQueuePriorities = (float[1]) { 0.5f }
+        };
+    }
 
     render_multisample_flags = get_max_multisample_flags(&physical_device_properties);
 
+    uint32_t num_skipped_extensions = gfx_mode == gfx_mode_headless ? NUM_HEADLESS_SKIPPED_EXTENSIONS : 0;
+
     if (vkCreateDevice(physical_device, &(VkDeviceCreateInfo) {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .pNext = &(VkPhysicalDeviceFeatures2) {
             .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
             .features = {
-                .samplerAnisotropy = VK_TRUE
+                .samplerAnisotropy = VK_TRUE,
+                .multiDrawIndirect = VK_TRUE,
+                .drawIndirectFirstInstance = VK_TRUE
             },
             .pNext = &(VkPhysicalDeviceMeshShaderFeaturesEXT) {
                 .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
                 .taskShader = true,
-                .meshShader = true
-            }
-        },
-        .queueCreateInfoCount = 1,
-        .pQueueCreateInfos = (VkDeviceQueueCreateInfo[1]) {
-            {
-                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-                .queueFamilyIndex = queue_family_indices.graphics,
-                .queueCount = 1,
-                .pQueuePriorities = (float[1]) { 1.0f }
+                .meshShader = true,
+                .pNext = &(VkPhysicalDeviceVulkan12Features) {
+                    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+                    .drawIndirectCount = VK_TRUE,
+                    .timelineSemaphore = VK_TRUE
+                }
             }
         },
+        .queueCreateInfoCount = num_queue_create_infos,
+        .pQueueCreateInfos = queue_create_infos,
         .pEnabledFeatures = NULL,
 
-        .enabledExtensionCount = NUM_ELEMS(extensions),
-        .ppEnabledExtensionNames = extensions,
+        .enabledExtensionCount = NUM_ELEMS(extensions) - num_skipped_extensions,
+        .ppEnabledExtensionNames = &extensions[num_skipped_extensions],
         .enabledLayerCount = NUM_ELEMS(layers),
         .ppEnabledLayerNames = layers
     }, NULL, &device) != VK_SUCCESS) {
         return result_device_create_failure;
     }
 
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
     if (vmaCreateAllocator(&(VmaAllocatorCreateInfo) {
         .instance = instance,
         .physicalDevice = physical_device,
         .device = device,
         .pAllocationCallbacks = NULL,
-        .pDeviceMemoryCallbacks = NULL,
+        .pDeviceMemoryCallbacks = &(VmaDeviceMemoryCallbacks) {
+            .pfnAllocate = track_device_memory_allocation,
+            .pfnFree = track_device_memory_free
+        },
         .vulkanApiVersion = VK_API_VERSION_1_0,
         .flags = 0 // Don't think any are needed
     }, &allocator) != VK_SUCCESS) {
@@ -557,23 +861,34 @@ static result_t init_vk_core(void) {
 
     vkGetDeviceQueue(device, queue_family_indices.graphics, 0, &queue);
     vkGetDeviceQueue(device, queue_family_indices.presentation, 0, &presentation_queue);
+    vkGetDeviceQueue(device, queue_family_indices.compute, 0, &compute_queue);
+    vkGetDeviceQueue(device, queue_family_indices.transfer, 0, &transfer_queue);
 
-    {
-        VkSurfaceFormatKHR surface_formats[num_surface_formats];
-        vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &num_surface_formats, surface_formats);
+    if (gfx_mode == gfx_mode_headless) {
+        surface_format = (VkSurfaceFormatKHR) { VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
 
-        surface_format = get_surface_format(num_surface_formats, surface_formats);
-    }
+        swapchain_images = malloc(sizeof(VkImage));
+        if ((result = init_offscreen_image()) != result_success) {
+            return result;
+        }
+    } else {
+        {
+            VkSurfaceFormatKHR surface_formats[num_surface_formats];
+            vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &num_surface_formats, surface_formats);
 
-    {
-        VkPresentModeKHR present_modes[num_present_modes];
-        vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &num_present_modes, present_modes);
+            surface_format = get_surface_format(num_surface_formats, surface_formats);
+        }
 
-        present_mode = get_present_mode(num_present_modes, present_modes);
-    }
+        {
+            VkPresentModeKHR present_modes[num_present_modes];
+            vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &num_present_modes, present_modes);
 
-    if ((result = init_swapchain()) != result_success) {
-        return result;
+            present_mode = get_present_mode(num_present_modes, present_modes);
+        }
+
+        if ((result = init_swapchain()) != result_success) {
+            return result;
+        }
     }
     
     depth_image_format = get_supported_format(3, (VkFormat[3]) { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT }, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
@@ -598,6 +913,17 @@ static result_t init_vk_core(void) {
         }
     }
 
+    if (vkCreateSemaphore(device, &(VkSemaphoreCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &(VkSemaphoreTypeCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0
+        }
+    }, NULL, &frame_semaphore) != VK_SUCCESS) {
+        return result_synchronization_primitive_create_failure;
+    }
+
     if (vkCreateCommandPool(device, &(VkCommandPoolCreateInfo) {
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
         .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
@@ -614,71 +940,17 @@ static result_t init_vk_core(void) {
         return result_command_buffers_allocate_failure;
     }
 
-    if (vkCreateRenderPass(device, &(VkRenderPassCreateInfo) {
-        DEFAULT_VK_RENDER_PASS,
-
-        .attachmentCount = 3,
-        .pAttachments = (VkAttachmentDescription[3]) {
-            {
-                DEFAULT_VK_ATTACHMENT,
-                .format = surface_format.format,
-                .samples = render_multisample_flags,
-                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-                .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-            },
-            {
-                DEFAULT_VK_ATTACHMENT,
-                .format = depth_image_format,
-                .samples = render_multisample_flags,
-                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-                .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-            },
-            {
-                DEFAULT_VK_ATTACHMENT,
-                .format = surface_format.format,
-                .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-                .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-            }
-        },
-
-        .pSubpasses = &(VkSubpassDescription) {
-            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-
-            .colorAttachmentCount = 1,
-            .pColorAttachments = &(VkAttachmentReference) {
-                .attachment = 0,
-                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-            },
-
-            .pDepthStencilAttachment = &(VkAttachmentReference) {
-                .attachment = 1,
-                .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-            },
-
-            .pResolveAttachments = &(VkAttachmentReference) {
-                .attachment = 2,
-                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-            }
-        },
-
-        .dependencyCount = 1,
-        .pDependencies = &(VkSubpassDependency) {
-            .srcSubpass = VK_SUBPASS_EXTERNAL,
-            .dstSubpass = 0,
-            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-            .srcAccessMask = 0,
-            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
-        }
-    }, NULL, &frame_render_pass) != VK_SUCCESS) {
-        return result_render_pass_create_failure;
+    if ((result = create_frame_render_pass(region_culling_phase_first, &frame_render_pass)) != result_success) {
+        return result;
+    }
+    if ((result = create_frame_render_pass(region_culling_phase_second, &frame_second_render_pass)) != result_success) {
+        return result;
     }
 
-    vkGetSwapchainImagesKHR(device, swapchain, &num_swapchain_images, NULL);
-    swapchain_images = malloc(num_swapchain_images*sizeof(VkImage));
+    if (gfx_mode == gfx_mode_windowed) {
+        vkGetSwapchainImagesKHR(device, swapchain, &num_swapchain_images, NULL);
+        swapchain_images = malloc(num_swapchain_images*sizeof(VkImage));
+    }
     swapchain_image_views = malloc(num_swapchain_images*sizeof(VkImageView));
     swapchain_framebuffers = malloc(num_swapchain_images*sizeof(VkFramebuffer));
 
@@ -699,6 +971,27 @@ static result_t init_vk_core(void) {
         return result_synchronization_primitive_create_failure;
     }
 
+    if (vkCreateCommandPool(device, &(VkCommandPoolCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queue_family_indices.compute
+    }, NULL, &compute_command_pool) != VK_SUCCESS) {
+        return result_command_pool_create_failure;
+    }
+
+    if (vkAllocateCommandBuffers(device, &(VkCommandBufferAllocateInfo) {
+        DEFAULT_VK_COMMAND_BUFFER,
+        .commandPool = compute_command_pool
+    }, &compute_command_buffer) != VK_SUCCESS) {
+        return result_command_buffers_allocate_failure;
+    }
+
+    if (vkCreateFence(device, &(VkFenceCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO
+    }, NULL, &compute_command_fence) != VK_SUCCESS) {
+        return result_synchronization_primitive_create_failure;
+    }
+
     if (vkCreateDescriptorPool(device, &(VkDescriptorPoolCreateInfo) {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .poolSizeCount = 1,
@@ -715,11 +1008,19 @@ static result_t init_vk_core(void) {
 
     vk_init_proc();
 
-    if ((result = init_region_generation_compute_pipeline()) != result_success) {
+    if ((result = init_upload(queue_family_indices.transfer)) != result_success) {
         return result;
     }
 
-    if ((result = init_region_meshing_compute_pipeline(&physical_device_properties)) != result_success) {
+    if ((result = init_gpu_profiler(&physical_device_properties)) != result_success) {
+        return result;
+    }
+
+    if ((result = init_region_generation_compute_pipeline(REGION_GENERATION_MODE)) != result_success) {
+        return result;
+    }
+
+    if ((result = init_region_meshing_compute_pipeline(&physical_device_properties, queue_family_indices.compute)) != result_success) {
         return result;
     }
     
@@ -727,40 +1028,28 @@ static result_t init_vk_core(void) {
         return result;
     }
 
-    if ((result = init_region_management()) != result_success) {
+    if ((result = init_hi_z_compute_pipeline()) != result_success) {
         return result;
     }
 
-    if ((result = record_region_generation_compute_pipeline(generic_command_buffer)) != result_success) {
+    if ((result = init_hi_z_images(swap_image_extent, depth_sample_image_view)) != result_success) {
         return result;
     }
-    microseconds_t start = get_current_microseconds();
-    if ((result = submit_and_wait(generic_command_buffer, generic_command_fence)) != result_success) {
+
+    if ((result = init_region_culling_compute_pipeline()) != result_success) {
         return result;
     }
-    printf("Voxel generation took %ldμs\n", get_current_microseconds() - start);
-    if ((result = reset_command_processing(generic_command_buffer, generic_command_fence)) != result_success) {
+
+    if ((result = init_region_management(compute_command_buffer, compute_command_fence, queue_family_indices.graphics, queue_family_indices.compute, queue_family_indices.transfer, REGION_GENERATION_MODE, REGION_MESHING_MODE)) != result_success) {
         return result;
     }
 
-    for (size_t i = 0; i < NUM_REGIONS / 8; i++) {
-        if ((result = record_region_meshing_compute_pipeline(generic_command_buffer)) != result_success) {
-            return result;
-        }
-        microseconds_t start = get_current_microseconds();
-        if ((result = submit_and_wait(generic_command_buffer, generic_command_fence)) != result_success) {
-            return result;
-        }
-        printf("Voxel meshing took %ldμs\n", get_current_microseconds() - start);
-        if ((result = reset_command_processing(generic_command_buffer, generic_command_fence)) != result_success) {
-            return result;
-        }
+    if ((result = update_region_management(get_camera_position())) != result_success) {
+        return result;
+    }
 
-        start = get_current_microseconds();
-        if ((result = create_vertex_buffers_for_awaiting_regions(generic_command_buffer, generic_command_fence)) != result_success) {
-            return result;
-        }
-        printf("Voxel mesh count read back took %ldμs\n", get_current_microseconds() - start);
+    if ((result = process_regions()) != result_success) {
+        return result;
     }
 
     return result_success;
@@ -769,17 +1058,26 @@ static result_t init_vk_core(void) {
 static void term_vk_core(void) {
     vkDeviceWaitIdle(device);
     term_region_management();
+    term_region_culling_compute_pipeline();
+    term_hi_z_images();
+    term_hi_z_compute_pipeline();
     term_region_render_pipeline();
     term_region_meshing_compute_pipeline();
     term_region_generation_compute_pipeline();
+    term_upload();
+    term_gpu_profiler();
 
     vkDestroyDescriptorPool(device, generic_descriptor_pool, NULL);
 
     vkDestroyRenderPass(device, frame_render_pass, NULL);
+    vkDestroyRenderPass(device, frame_second_render_pass, NULL);
     vkDestroyCommandPool(device, command_pool, NULL);
 
     vkDestroyFence(device, generic_command_fence, NULL);
 
+    vkDestroyCommandPool(device, compute_command_pool, NULL);
+    vkDestroyFence(device, compute_command_fence, NULL);
+
     term_swapchain_dependents();
     
     term_swapchain();
@@ -789,11 +1087,14 @@ static void term_vk_core(void) {
         vkDestroySemaphore(device, render_finished_semaphores[i], NULL);
         vkDestroyFence(device, in_flight_fences[i], NULL);
     }
+    vkDestroySemaphore(device, frame_semaphore, NULL);
 
     vmaDestroyAllocator(allocator);
 
     vkDestroyDevice(device, NULL);
-    vkDestroySurfaceKHR(instance, surface, NULL);
+    if (gfx_mode == gfx_mode_windowed) {
+        vkDestroySurfaceKHR(instance, surface, NULL);
+    }
     vkDestroyInstance(instance, NULL);
 
     free(swapchain_images);
@@ -827,13 +1128,18 @@ result_t draw_gfx(void) {
 
     result_t result;
 
+    // Meshing batches only advance once the GPU has finished them so newly streamed in regions don't stall presentation
+    if ((result = process_regions()) != result_success) {
+        return result;
+    }
+
     VkSemaphore image_available_semaphore = image_available_semaphores[frame_index];
     VkSemaphore render_finished_semaphore = render_finished_semaphores[frame_index];
     VkFence in_flight_fence = in_flight_fences[frame_index];
     vkWaitForFences(device, 1, &in_flight_fence, VK_TRUE, UINT64_MAX);
 
-    uint32_t image_index;
-    {
+    uint32_t image_index = 0;
+    if (gfx_mode == gfx_mode_windowed) {
         VkResult result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, image_available_semaphore, VK_NULL_HANDLE, &image_index);
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             reinit_swapchain();
@@ -844,6 +1150,8 @@ result_t draw_gfx(void) {
     }
 
     vkResetFences(device, 1, &in_flight_fence);
+    // Only counts frames that are actually submitted
+    advance_deferred_region_face_frees();
 
     VkCommandBuffer command_buffer = frame_command_buffers[frame_index];
 
@@ -871,45 +1179,90 @@ result_t draw_gfx(void) {
     };
     vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
-    vkCmdBeginRenderPass(command_buffer, &(VkRenderPassBeginInfo) {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .renderPass = frame_render_pass,
-        .framebuffer = swapchain_framebuffers[image_index],
-        .renderArea.offset = { 0, 0 },
-        .renderArea.extent = swap_image_extent,
-        .clearValueCount = 2,
-        .pClearValues = (VkClearValue[2]) {
-            { .color = { .float32 = { 0.62f, 0.78f, 1.0f, 1.0f } } },
-            { .depthStencil = { .depth = 1.0f, .stencil = 0 } },
+    // Regions occluded in the previous frame's Hi-Z pyramid are retested against the pyramid rebuilt from the first render pass and drawn in the second
+    for (region_culling_phase_t phase = region_culling_phase_first; phase < NUM_REGION_CULLING_PHASES; phase++) {
+        if (REGION_CULLING_MODE == region_culling_mode_gpu) {
+            if (phase == region_culling_phase_second) {
+                uint32_t hi_z_profile_scope_index = begin_gpu_profile(command_buffer, gpu_profile_pass_hi_z);
+                record_hi_z_build(command_buffer, get_view_projection());
+                end_gpu_profile(command_buffer, hi_z_profile_scope_index);
+            }
+            uint32_t culling_profile_scope_index = begin_gpu_profile(command_buffer, gpu_profile_pass_culling);
+            dispatch_region_culling_compute_pipeline(command_buffer, frame_index, phase);
+            end_gpu_profile(command_buffer, culling_profile_scope_index);
         }
-    }, VK_SUBPASS_CONTENTS_INLINE);
 
-    if ((result = draw_region_render_pipeline(command_buffer)) != result_success) {
-        return result;
-    }
+        uint32_t render_profile_scope_index = begin_gpu_profile(command_buffer, gpu_profile_pass_render);
+
+        vkCmdBeginRenderPass(command_buffer, &(VkRenderPassBeginInfo) {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .renderPass = phase == region_culling_phase_first ? frame_render_pass : frame_second_render_pass,
+            .framebuffer = swapchain_framebuffers[image_index],
+            .renderArea.offset = { 0, 0 },
+            .renderArea.extent = swap_image_extent,
+            .clearValueCount = 2,
+            .pClearValues = (VkClearValue[2]) {
+                { .color = { .float32 = { 0.62f, 0.78f, 1.0f, 1.0f } } },
+                { .depthStencil = { .depth = 1.0f, .stencil = 0 } },
+            }
+        }, VK_SUBPASS_CONTENTS_INLINE);
+
+        if ((result = draw_region_render_pipeline(command_buffer, frame_index, REGION_CULLING_MODE, phase)) != result_success) {
+            return result;
+        }
 
-    vkCmdEndRenderPass(command_buffer);
+        vkCmdEndRenderPass(command_buffer);
+        end_gpu_profile(command_buffer, render_profile_scope_index);
+    }
 
     if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
         return result_command_buffer_end_failure;
     }
 
-    VkPipelineStageFlags wait_stage_flags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    
+    // Only this frame's copy of the region infos is written, which was last read by the frame submitted NUM_FRAMES_IN_FLIGHT frames ago
+    // That frame's fence was waited for above already, so the upload never waits for the frames still in flight
+    if ((result = queue_region_info_uploads(frame_index)) != result_success) {
+        return result;
+    }
+    uint64_t reused_frame_semaphore_value = num_submitted_frames + 1 >= NUM_FRAMES_IN_FLIGHT ? num_submitted_frames + 1 - NUM_FRAMES_IN_FLIGHT : 0;
+    uint64_t upload_semaphore_value;
+    if ((result = flush_uploads(frame_semaphore, reused_frame_semaphore_value, &upload_semaphore_value)) != result_success) {
+        return result;
+    }
+
+    num_submitted_frames++;
+
+    // Faces of regions made drawable so far may still be written on the compute queue
+    uint64_t wait_semaphore_values[3] = { 0, region_meshing_drawable_semaphore_value, upload_semaphore_value };
+    VkSemaphore wait_semaphores[3] = { image_available_semaphore, region_meshing_semaphore, upload_semaphore };
+    VkPipelineStageFlags wait_stage_flags[3] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT };
+    uint64_t signal_semaphore_values[2] = { 0, num_submitted_frames };
+    VkSemaphore signal_semaphores[2] = { render_finished_semaphore, frame_semaphore };
+
+    // Headless frames skip the swapchain semaphores at the front
+    uint32_t first_semaphore_index = gfx_mode == gfx_mode_headless ? 1 : 0;
+
     if (vkQueueSubmit(queue, 1, &(VkSubmitInfo) {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &image_available_semaphore,
-        .pWaitDstStageMask = &wait_stage_flags,
+        .pNext = &(VkTimelineSemaphoreSubmitInfo) {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .waitSemaphoreValueCount = 3 - first_semaphore_index,
+            .pWaitSemaphoreValues = &wait_semaphore_values[first_semaphore_index],
+            .signalSemaphoreValueCount = 2 - first_semaphore_index,
+            .pSignalSemaphoreValues = &signal_semaphore_values[first_semaphore_index]
+        },
+        .waitSemaphoreCount = 3 - first_semaphore_index,
+        .pWaitSemaphores = &wait_semaphores[first_semaphore_index],
+        .pWaitDstStageMask = &wait_stage_flags[first_semaphore_index],
         .commandBufferCount = 1,
         .pCommandBuffers = &command_buffer,
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &render_finished_semaphore
+        .signalSemaphoreCount = 2 - first_semaphore_index,
+        .pSignalSemaphores = &signal_semaphores[first_semaphore_index]
     }, in_flight_fence) != VK_SUCCESS) {
         return result_queue_submit_failure;
     }
 
-    {
+    if (gfx_mode == gfx_mode_windowed) {
         VkResult result = vkQueuePresentKHR(presentation_queue, &(VkPresentInfoKHR) {
             .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
             .waitSemaphoreCount = 1,
@@ -932,13 +1285,53 @@ result_t draw_gfx(void) {
     frame_index %= NUM_FRAMES_IN_FLIGHT;
     printf("Frame took %ldμs\n", get_current_microseconds() - start);
 
+    update_gpu_profiler();
+    if (num_submitted_frames % GPU_PROFILE_PRINT_INTERVAL == 0) {
+        print_gpu_profile_stats();
+        // Counters only cover the latest frame, printed alongside the profile so they don't flood the log
+        if (REGION_CULLING_MODE == region_culling_mode_cpu) {
+            printf("Regions tested: %u, frustum culled: %u, distance culled: %u, simd: %s\n", region_culling_counters.num_tested_regions, region_culling_counters.num_frustum_culled_regions, region_culling_counters.num_distance_culled_regions, simd_level_names[get_region_culling_simd_level()]);
+        }
+    }
+
+    return result_success;
+}
+
+result_t build_gfx_regions(void) {
+    result_t result;
+
+    while (has_pending_region_placements() || is_any_region_in_mesh_state(region_mesh_state_await_generation) || is_any_region_in_mesh_state(region_mesh_state_await_meshing_compute) || !is_region_meshing_idle() || is_region_generation_pending()) {
+        if ((result = process_regions()) != result_success) {
+            return result;
+        }
+    }
+
     return result_success;
 }
 
-result_t init_gfx() {
+VkDeviceSize get_gfx_peak_device_memory_usage(void) {
+    return peak_device_memory_usage;
+}
+
+result_t verify_gfx_region_meshes(region_mesh_verification_t* verification) {
     result_t result;
 
-    if ((result = init_glfw_core()) != result_success) {
+    if ((result = wait_for_region_generation(REGION_GENERATION_MODE)) != result_success) {
+        return result;
+    }
+    if ((result = wait_for_region_meshing()) != result_success) {
+        return result;
+    }
+
+    return verify_region_meshes(compute_command_buffer, compute_command_fence, verification);
+}
+
+result_t init_gfx(gfx_mode_t mode) {
+    result_t result;
+
+    gfx_mode = mode;
+
+    if (gfx_mode == gfx_mode_windowed && (result = init_glfw_core()) != result_success) {
         return result;
     }
 
@@ -955,5 +1348,7 @@ bool should_window_close() {
 
 void term_gfx() {
     term_vk_core();
-    term_glfw_core();
+    if (gfx_mode == gfx_mode_windowed) {
+        term_glfw_core();
+    }
 }
\ No newline at end of file
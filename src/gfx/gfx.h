@@ -1,20 +1,39 @@
 #pragma once
+#include "gfx/region_mesh_verification.h"
 #include "result.h"
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan_core.h>
 
+#define NUM_FRAMES_IN_FLIGHT 2
+
 extern GLFWwindow* window;
 extern VkDevice device;
 extern VmaAllocator allocator;
 extern VkQueue queue;
+// Generation and meshing are submitted here, may be the same queue as the graphics one
+extern VkQueue compute_queue;
+// Uploads are submitted here, may be the same queue as the graphics one
+extern VkQueue transfer_queue;
 extern VkSurfaceFormatKHR surface_format;
 extern VkFormat depth_image_format;
 
 extern VkSampleCountFlagBits render_multisample_flags;
 extern VkRenderPass frame_render_pass;
 
-result_t init_gfx(void);
+typedef enum {
+    gfx_mode_windowed,
+    // No window, surface or swapchain, frames are rendered into an offscreen image instead
+    gfx_mode_headless
+} gfx_mode_t;
+
+result_t init_gfx(gfx_mode_t mode);
 result_t draw_gfx(void);
+// Places, generates and meshes every region in view without drawing, polling the GPU until done
+result_t build_gfx_regions(void);
+// Checks a few meshed regions against the CPU mesher once meshing has finished
+result_t verify_gfx_region_meshes(region_mesh_verification_t* verification);
+// Highest device local memory VMA has held at once since init
+VkDeviceSize get_gfx_peak_device_memory_usage(void);
 void term_gfx(void);
\ No newline at end of file
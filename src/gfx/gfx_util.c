@@ -177,7 +177,7 @@ result_t create_image(VkCommandBuffer command_buffer, VkFence command_fence, con
         return result_command_buffer_end_failure;
     }
 
-    if ((result = submit_and_wait(command_buffer, command_fence)) != result_success) {
+    if ((result = submit_and_wait(queue, command_buffer, command_fence)) != result_success) {
         return result;
     }
     if ((result = reset_command_processing(command_buffer, command_fence)) != result_success) {
@@ -244,8 +244,8 @@ result_t reset_command_processing(VkCommandBuffer command_buffer, VkFence comman
     return result_success;
 }
 
-result_t submit_and_wait(VkCommandBuffer command_buffer, VkFence command_fence) {
-    if (vkQueueSubmit(queue, 1, &(VkSubmitInfo) {
+result_t submit_and_wait(VkQueue submit_queue, VkCommandBuffer command_buffer, VkFence command_fence) {
+    if (vkQueueSubmit(submit_queue, 1, &(VkSubmitInfo) {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
         .commandBufferCount = 1,
         .pCommandBuffers = &command_buffer
@@ -25,4 +25,4 @@ void begin_pipeline(
 void end_pipeline(VkCommandBuffer command_buffer);
 
 result_t reset_command_processing(VkCommandBuffer command_buffer, VkFence command_fence);
-result_t submit_and_wait(VkCommandBuffer command_buffer, VkFence command_fence);
\ No newline at end of file
+result_t submit_and_wait(VkQueue submit_queue, VkCommandBuffer command_buffer, VkFence command_fence);
\ No newline at end of file
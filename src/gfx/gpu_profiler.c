@@ -0,0 +1,171 @@
+#include "gpu_profiler.h"
+#include "gfx/gfx.h"
+#include "result.h"
+#include "util.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+// Scopes stay in use from being recorded until their timestamps have been read back
+#define NUM_GPU_PROFILE_SCOPES 64
+
+typedef struct {
+    bool is_used;
+    gpu_profile_pass_t pass;
+} gpu_profile_scope_t;
+
+typedef struct {
+    float samples[NUM_GPU_PROFILE_SAMPLES];
+    uint32_t next_sample_index;
+    uint32_t num_samples;
+} gpu_profile_pass_samples_t;
+
+static const char* pass_names[NUM_GPU_PROFILE_PASSES] = {
+    [gpu_profile_pass_generation] = "Generation",
+    [gpu_profile_pass_meshing_count] = "Meshing count",
+    [gpu_profile_pass_meshing_write] = "Meshing write",
+    [gpu_profile_pass_hi_z] = "Hi-Z",
+    [gpu_profile_pass_culling] = "Culling",
+    [gpu_profile_pass_render] = "Render"
+};
+
+static bool is_enabled;
+static float timestamp_period;
+// Two timestamps per scope
+static VkQueryPool query_pool;
+static gpu_profile_scope_t scopes[NUM_GPU_PROFILE_SCOPES];
+// Scopes on different queues finish out of order, so they're handed out from a free list rather than a ring
+static uint32_t free_scope_indices[NUM_GPU_PROFILE_SCOPES];
+static uint32_t num_free_scopes;
+static gpu_profile_pass_samples_t pass_samples[NUM_GPU_PROFILE_PASSES];
+
+result_t init_gpu_profiler(const VkPhysicalDeviceProperties* physical_device_properties) {
+    // Every queue family used for profiled work is graphics or compute capable
+    is_enabled = physical_device_properties->limits.timestampComputeAndGraphics;
+    if (!is_enabled) {
+        return result_success;
+    }
+
+    timestamp_period = physical_device_properties->limits.timestampPeriod;
+
+    if (vkCreateQueryPool(device, &(VkQueryPoolCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2 * NUM_GPU_PROFILE_SCOPES
+    }, NULL, &query_pool) != VK_SUCCESS) {
+        return result_query_pool_create_failure;
+    }
+
+    // Popped from the end, so the lowest indices are handed out first
+    for (uint32_t i = 0; i < NUM_GPU_PROFILE_SCOPES; i++) {
+        free_scope_indices[num_free_scopes++] = NUM_GPU_PROFILE_SCOPES - 1 - i;
+    }
+
+    return result_success;
+}
+
+uint32_t begin_gpu_profile(VkCommandBuffer command_buffer, gpu_profile_pass_t pass) {
+    if (!is_enabled) {
+        return NULL_UINT32;
+    }
+
+    // Only skipped while every scope is waiting to be read back
+    if (num_free_scopes == 0) {
+        return NULL_UINT32;
+    }
+    uint32_t scope_index = free_scope_indices[--num_free_scopes];
+
+    scopes[scope_index] = (gpu_profile_scope_t) {
+        .is_used = true,
+        .pass = pass
+    };
+
+    vkCmdResetQueryPool(command_buffer, query_pool, 2 * scope_index, 2);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, 2 * scope_index);
+
+    return scope_index;
+}
+
+void end_gpu_profile(VkCommandBuffer command_buffer, uint32_t scope_index) {
+    if (scope_index == NULL_UINT32) {
+        return;
+    }
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, 2 * scope_index + 1);
+}
+
+void update_gpu_profiler(void) {
+    if (!is_enabled) {
+        return;
+    }
+
+    for (uint32_t scope_index = 0; scope_index < NUM_GPU_PROFILE_SCOPES; scope_index++) {
+        gpu_profile_scope_t* scope = &scopes[scope_index];
+        if (!scope->is_used) {
+            continue;
+        }
+
+        // Begin and end timestamps each followed by their availability
+        uint64_t results[4];
+        if (vkGetQueryPoolResults(device, query_pool, 2 * scope_index, 2, sizeof(results), results, 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) != VK_SUCCESS || results[1] == 0 || results[3] == 0) {
+            continue;
+        }
+        scope->is_used = false;
+        free_scope_indices[num_free_scopes++] = scope_index;
+
+        gpu_profile_pass_samples_t* samples = &pass_samples[scope->pass];
+        samples->samples[samples->next_sample_index] = (float) (results[2] - results[0]) * timestamp_period / 1000000.0f;
+        samples->next_sample_index = (samples->next_sample_index + 1) % NUM_GPU_PROFILE_SAMPLES;
+        if (samples->num_samples < NUM_GPU_PROFILE_SAMPLES) {
+            samples->num_samples++;
+        }
+    }
+}
+
+static int compare_floats(const void* a, const void* b) {
+    float float_a = *(const float*) a;
+    float float_b = *(const float*) b;
+    return (float_a > float_b) - (float_a < float_b);
+}
+
+void get_gpu_profile_stats(gpu_profile_pass_t pass, gpu_profile_stats_t* stats) {
+    const gpu_profile_pass_samples_t* samples = &pass_samples[pass];
+
+    *stats = (gpu_profile_stats_t) { .num_samples = samples->num_samples };
+    if (samples->num_samples == 0) {
+        return;
+    }
+
+    float sorted_samples[NUM_GPU_PROFILE_SAMPLES];
+    memcpy(sorted_samples, samples->samples, samples->num_samples * sizeof(float));
+    qsort(sorted_samples, samples->num_samples, sizeof(float), compare_floats);
+
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < samples->num_samples; i++) {
+        sum += sorted_samples[i];
+    }
+
+    stats->min_milliseconds = sorted_samples[0];
+    stats->avg_milliseconds = sum / (float) samples->num_samples;
+    stats->p99_milliseconds = sorted_samples[(samples->num_samples * 99u) / 100u];
+}
+
+void print_gpu_profile_stats(void) {
+    for (gpu_profile_pass_t pass = 0; pass < NUM_GPU_PROFILE_PASSES; pass++) {
+        gpu_profile_stats_t stats;
+        get_gpu_profile_stats(pass, &stats);
+        if (stats.num_samples == 0) {
+            continue;
+        }
+        printf("%s: min %.3fms, avg %.3fms, p99 %.3fms over %u samples\n", pass_names[pass], (double) stats.min_milliseconds, (double) stats.avg_milliseconds, (double) stats.p99_milliseconds, stats.num_samples);
+    }
+}
+
+void term_gpu_profiler(void) {
+    if (is_enabled) {
+        vkDestroyQueryPool(device, query_pool, NULL);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "result.h"
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+// Rolling window each pass's stats are computed over
+#define NUM_GPU_PROFILE_SAMPLES 128
+
+typedef enum {
+    gpu_profile_pass_generation,
+    gpu_profile_pass_meshing_count,
+    gpu_profile_pass_meshing_write,
+    gpu_profile_pass_hi_z,
+    gpu_profile_pass_culling,
+    gpu_profile_pass_render
+} gpu_profile_pass_t;
+
+#define NUM_GPU_PROFILE_PASSES 6
+
+typedef struct {
+    uint32_t num_samples;
+    float min_milliseconds;
+    float avg_milliseconds;
+    float p99_milliseconds;
+} gpu_profile_stats_t;
+
+result_t init_gpu_profiler(const VkPhysicalDeviceProperties* physical_device_properties);
+// Must be recorded outside of a render pass, returns NULL_UINT32 when the scope isn't profiled
+uint32_t begin_gpu_profile(VkCommandBuffer command_buffer, gpu_profile_pass_t pass);
+void end_gpu_profile(VkCommandBuffer command_buffer, uint32_t scope_index);
+// Collects the timestamps of finished scopes without waiting, so samples arrive a few frames late
+void update_gpu_profiler(void);
+void get_gpu_profile_stats(gpu_profile_pass_t pass, gpu_profile_stats_t* stats);
+void print_gpu_profile_stats(void);
+void term_gpu_profiler(void);
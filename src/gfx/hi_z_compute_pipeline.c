@@ -0,0 +1,398 @@
+#include "hi_z_compute_pipeline.h"
+#include "gfx/default.h"
+#include "gfx/gfx.h"
+#include "gfx/gfx_util.h"
+#include "gfx/pipeline.h"
+#include "result.h"
+#include <cglm/types-struct.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#define HI_Z_WORKGROUP_SIZE 8
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t num_samples;
+} push_constants_t;
+
+static pipeline_t copy_pipeline;
+static pipeline_t reduce_pipeline;
+
+static VkDescriptorSetLayout copy_descriptor_set_layout;
+static VkDescriptorSetLayout reduce_descriptor_set_layout;
+static VkDescriptorPool descriptor_pool;
+static VkSampler sampler;
+
+static VkImage image;
+static VmaAllocation image_allocation;
+static VkImageView image_view;
+static VkImageView level_image_views[MAX_NUM_HI_Z_LEVELS];
+
+// The copy set writes the first level, reduce set i writes level i from level i - 1
+static VkDescriptorSet copy_descriptor_set;
+static VkDescriptorSet reduce_descriptor_sets[MAX_NUM_HI_Z_LEVELS];
+
+VkDescriptorSetLayout hi_z_set_layout;
+VkDescriptorSet hi_z_descriptor_set;
+hi_z_state_t hi_z_state;
+
+static VkExtent2D get_level_extent(uint32_t level) {
+    VkExtent2D extent = hi_z_state.extent;
+    extent.width = extent.width >> level > 0 ? extent.width >> level : 1;
+    extent.height = extent.height >> level > 0 ? extent.height >> level : 1;
+    return extent;
+}
+
+static result_t create_pipeline(const char* shader_path, VkDescriptorSetLayout descriptor_set_layout, pipeline_t* pipeline) {
+    result_t result;
+
+    VkShaderModule shader_module;
+    if ((result = create_shader_module(shader_path, &shader_module)) != result_success) {
+        return result;
+    }
+
+    if (vkCreatePipelineLayout(device, &(VkPipelineLayoutCreateInfo) {
+        DEFAULT_VK_PIPELINE_LAYOUT,
+        .pSetLayouts = &descriptor_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &(VkPushConstantRange) {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .size = sizeof(push_constants_t)
+        }
+    }, NULL, &pipeline->pipeline_layout) != VK_SUCCESS) {
+        return result_pipeline_layout_create_failure;
+    }
+
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &(VkComputePipelineCreateInfo) {
+        DEFAULT_VK_COMPUTE_PIPELINE,
+        .stage = {
+            DEFAULT_VK_SHADER_STAGE,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader_module
+        },
+        .layout = pipeline->pipeline_layout
+    }, NULL, &pipeline->pipeline) != VK_SUCCESS) {
+        return result_compute_pipelines_create_failure;
+    }
+
+    vkDestroyShaderModule(device, shader_module, NULL);
+
+    return result_success;
+}
+
+result_t init_hi_z_compute_pipeline(void) {
+    result_t result;
+
+    if (vkCreateDescriptorPool(device, &(VkDescriptorPoolCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 2,
+        .pPoolSizes = (VkDescriptorPoolSize[2]) {
+            {
+                .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 2
+            },
+            {
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 2 * MAX_NUM_HI_Z_LEVELS
+            }
+        },
+        .maxSets = MAX_NUM_HI_Z_LEVELS + 1
+    }, NULL, &descriptor_pool) != VK_SUCCESS) {
+        return result_descriptor_pool_create_failure;
+    }
+
+    if (vkCreateSampler(device, &(VkSamplerCreateInfo) {
+        DEFAULT_VK_SAMPLER,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .magFilter = VK_FILTER_NEAREST,
+        .anisotropyEnable = VK_FALSE,
+        .maxLod = VK_LOD_CLAMP_NONE
+    }, NULL, &sampler) != VK_SUCCESS) {
+        return result_sampler_create_failure;
+    }
+
+    if (vkCreateDescriptorSetLayout(device, &(VkDescriptorSetLayoutCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 2,
+        .pBindings = (VkDescriptorSetLayoutBinding[2]) {
+            {
+                DEFAULT_VK_DESCRIPTOR_BINDING,
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            {
+                DEFAULT_VK_DESCRIPTOR_BINDING,
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            }
+        }
+    }, NULL, &copy_descriptor_set_layout) != VK_SUCCESS) {
+        return result_descriptor_set_layout_create_failure;
+    }
+
+    if (vkCreateDescriptorSetLayout(device, &(VkDescriptorSetLayoutCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 2,
+        .pBindings = (VkDescriptorSetLayoutBinding[2]) {
+            {
+                DEFAULT_VK_DESCRIPTOR_BINDING,
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            {
+                DEFAULT_VK_DESCRIPTOR_BINDING,
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            }
+        }
+    }, NULL, &reduce_descriptor_set_layout) != VK_SUCCESS) {
+        return result_descriptor_set_layout_create_failure;
+    }
+
+    if (vkCreateDescriptorSetLayout(device, &(VkDescriptorSetLayoutCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &(VkDescriptorSetLayoutBinding) {
+            DEFAULT_VK_DESCRIPTOR_BINDING,
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        }
+    }, NULL, &hi_z_set_layout) != VK_SUCCESS) {
+        return result_descriptor_set_layout_create_failure;
+    }
+
+    if ((result = create_pipeline("shader/hi_z_copy.spv", copy_descriptor_set_layout, &copy_pipeline)) != result_success) {
+        return result;
+    }
+    if ((result = create_pipeline("shader/hi_z_reduce.spv", reduce_descriptor_set_layout, &reduce_pipeline)) != result_success) {
+        return result;
+    }
+
+    return result_success;
+}
+
+result_t init_hi_z_images(VkExtent2D extent, VkImageView depth_image_view) {
+    uint32_t num_levels = 1;
+    while (num_levels < MAX_NUM_HI_Z_LEVELS && ((extent.width >> num_levels) > 0 || (extent.height >> num_levels) > 0)) {
+        num_levels++;
+    }
+
+    hi_z_state = (hi_z_state_t) {
+        .is_valid = false,
+        .extent = extent,
+        .num_levels = num_levels
+    };
+
+    if (vmaCreateImage(allocator, &(VkImageCreateInfo) {
+        DEFAULT_VK_IMAGE,
+        .extent.width = extent.width,
+        .extent.height = extent.height,
+        .mipLevels = num_levels,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+    }, &device_allocation_create_info, &image, &image_allocation, NULL) != VK_SUCCESS) {
+        return result_image_create_failure;
+    }
+
+    if (vkCreateImageView(device, &(VkImageViewCreateInfo) {
+        DEFAULT_VK_IMAGE_VIEW,
+        .image = image,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.levelCount = num_levels
+    }, NULL, &image_view) != VK_SUCCESS) {
+        return result_image_view_create_failure;
+    }
+
+    for (uint32_t level = 0; level < num_levels; level++) {
+        if (vkCreateImageView(device, &(VkImageViewCreateInfo) {
+            DEFAULT_VK_IMAGE_VIEW,
+            .image = image,
+            .format = VK_FORMAT_R32_SFLOAT,
+            .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .subresourceRange.baseMipLevel = level
+        }, NULL, &level_image_views[level]) != VK_SUCCESS) {
+            return result_image_view_create_failure;
+        }
+    }
+
+    if (vkAllocateDescriptorSets(device, &(VkDescriptorSetAllocateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &copy_descriptor_set_layout
+    }, &copy_descriptor_set) != VK_SUCCESS) {
+        return result_descriptor_sets_allocate_failure;
+    }
+
+    if (vkAllocateDescriptorSets(device, &(VkDescriptorSetAllocateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &hi_z_set_layout
+    }, &hi_z_descriptor_set) != VK_SUCCESS) {
+        return result_descriptor_sets_allocate_failure;
+    }
+
+    vkUpdateDescriptorSets(device, 3, (VkWriteDescriptorSet[3]) {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = copy_descriptor_set,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .pImageInfo = &(VkDescriptorImageInfo) {
+                .sampler = sampler,
+                .imageView = depth_image_view,
+                .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+            }
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = copy_descriptor_set,
+            .dstBinding = 1,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .pImageInfo = &(VkDescriptorImageInfo) {
+                .imageView = level_image_views[0],
+                .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+            }
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = hi_z_descriptor_set,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .pImageInfo = &(VkDescriptorImageInfo) {
+                .sampler = sampler,
+                .imageView = image_view,
+                .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+            }
+        }
+    }, 0, NULL);
+
+    for (uint32_t level = 1; level < num_levels; level++) {
+        if (vkAllocateDescriptorSets(device, &(VkDescriptorSetAllocateInfo) {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &reduce_descriptor_set_layout
+        }, &reduce_descriptor_sets[level]) != VK_SUCCESS) {
+            return result_descriptor_sets_allocate_failure;
+        }
+
+        vkUpdateDescriptorSets(device, 2, (VkWriteDescriptorSet[2]) {
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = reduce_descriptor_sets[level],
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .pImageInfo = &(VkDescriptorImageInfo) {
+                    .imageView = level_image_views[level - 1],
+                    .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+                }
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = reduce_descriptor_sets[level],
+                .dstBinding = 1,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .pImageInfo = &(VkDescriptorImageInfo) {
+                    .imageView = level_image_views[level],
+                    .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+                }
+            }
+        }, 0, NULL);
+    }
+
+    return result_success;
+}
+
+static void dispatch_level(VkCommandBuffer command_buffer, const pipeline_t* pipeline, VkDescriptorSet descriptor_set, uint32_t level) {
+    VkExtent2D extent = get_level_extent(level);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline_layout, 0, 1, &descriptor_set, 0, NULL);
+    vkCmdPushConstants(command_buffer, pipeline->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_t), &(push_constants_t) {
+        .width = extent.width,
+        .height = extent.height,
+        .num_samples = (uint32_t) render_multisample_flags
+    });
+    vkCmdDispatch(command_buffer, (extent.width + HI_Z_WORKGROUP_SIZE - 1) / HI_Z_WORKGROUP_SIZE, (extent.height + HI_Z_WORKGROUP_SIZE - 1) / HI_Z_WORKGROUP_SIZE, 1);
+}
+
+void record_hi_z_build(VkCommandBuffer command_buffer, mat4s view_projection) {
+    // Culling reads of the previous build must finish first, their contents are discarded
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &(VkImageMemoryBarrier) {
+        DEFAULT_VK_IMAGE_MEMORY_BARRIER,
+        .image = image,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .subresourceRange.levelCount = hi_z_state.num_levels
+    });
+
+    dispatch_level(command_buffer, &copy_pipeline, copy_descriptor_set, 0);
+
+    for (uint32_t level = 1; level < hi_z_state.num_levels; level++) {
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &(VkMemoryBarrier) {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+        }, 0, NULL, 0, NULL);
+
+        dispatch_level(command_buffer, &reduce_pipeline, reduce_descriptor_sets[level], level);
+    }
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &(VkMemoryBarrier) {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+    }, 0, NULL, 0, NULL);
+
+    hi_z_state.is_valid = true;
+    hi_z_state.view_projection = view_projection;
+}
+
+void term_hi_z_images(void) {
+    vkResetDescriptorPool(device, descriptor_pool, 0);
+
+    for (uint32_t level = 0; level < hi_z_state.num_levels; level++) {
+        vkDestroyImageView(device, level_image_views[level], NULL);
+    }
+    vkDestroyImageView(device, image_view, NULL);
+    vmaDestroyImage(allocator, image, image_allocation);
+
+    hi_z_state.is_valid = false;
+}
+
+void term_hi_z_compute_pipeline(void) {
+    destroy_pipeline(&copy_pipeline);
+    destroy_pipeline(&reduce_pipeline);
+
+    vkDestroyDescriptorSetLayout(device, copy_descriptor_set_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, reduce_descriptor_set_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, hi_z_set_layout, NULL);
+    vkDestroySampler(device, sampler, NULL);
+    vkDestroyDescriptorPool(device, descriptor_pool, NULL);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "result.h"
+#include <cglm/types-struct.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+// Enough levels for framebuffers up to 32768 pixels wide
+#define MAX_NUM_HI_Z_LEVELS 16
+
+typedef struct {
+    // False until the pyramid has been built since the last init_hi_z_images call
+    bool is_valid;
+    // View projection of the depth the pyramid was built from
+    mat4s view_projection;
+    VkExtent2D extent;
+    uint32_t num_levels;
+} hi_z_state_t;
+
+extern VkDescriptorSetLayout hi_z_set_layout;
+// Covers every level of the pyramid, reallocated by init_hi_z_images
+extern VkDescriptorSet hi_z_descriptor_set;
+extern hi_z_state_t hi_z_state;
+
+result_t init_hi_z_compute_pipeline(void);
+// The depth image view must only cover the depth aspect
+result_t init_hi_z_images(VkExtent2D extent, VkImageView depth_image_view);
+// Each texel of the pyramid holds the farthest depth it covers, the depth image must be in the depth stencil read only layout
+void record_hi_z_build(VkCommandBuffer command_buffer, mat4s view_projection);
+void term_hi_z_images(void);
+void term_hi_z_compute_pipeline(void);
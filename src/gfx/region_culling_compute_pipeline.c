@@ -0,0 +1,304 @@
+#include "region_culling_compute_pipeline.h"
+#include "camera.h"
+#include "gfx/default.h"
+#include "gfx/gfx.h"
+#include "gfx/gfx_util.h"
+#include "gfx/hi_z_compute_pipeline.h"
+#include "gfx/pipeline.h"
+#include "result.h"
+#include "voxel/region_management.h"
+#include <cglm/types-struct.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#define CULLING_WORKGROUP_SIZE 64
+
+typedef struct {
+    uint32_t num_regions;
+    uint32_t phase;
+    uint32_t is_hi_z_valid;
+    uint32_t num_hi_z_levels;
+    uint32_t hi_z_width;
+    uint32_t hi_z_height;
+} push_constants_t;
+
+typedef struct {
+    mat4s view_projection;
+    mat4s hi_z_view_projection;
+} view_projections_t;
+
+static pipeline_t pipeline;
+static VkDescriptorSetLayout draw_descriptor_set_layout;
+static VkDescriptorPool descriptor_pool;
+static VkDescriptorSet draw_descriptor_sets[NUM_FRAMES_IN_FLIGHT];
+
+static VmaAllocation draw_command_buffer_allocations[NUM_FRAMES_IN_FLIGHT];
+static VmaAllocation draw_count_buffer_allocations[NUM_FRAMES_IN_FLIGHT];
+
+// Regions the first phase found occluded, retested by the second phase
+static VkBuffer candidate_flags_buffers[NUM_FRAMES_IN_FLIGHT];
+static VmaAllocation candidate_flags_buffer_allocations[NUM_FRAMES_IN_FLIGHT];
+
+static VkBuffer view_projections_buffers[NUM_FRAMES_IN_FLIGHT];
+static VmaAllocation view_projections_buffer_allocations[NUM_FRAMES_IN_FLIGHT];
+
+VkDescriptorSetLayout region_culling_compute_pipeline_set_layout;
+
+VkBuffer region_culling_draw_command_buffers[NUM_FRAMES_IN_FLIGHT];
+VkBuffer region_culling_draw_count_buffers[NUM_FRAMES_IN_FLIGHT];
+
+result_t init_region_culling_compute_pipeline(void) {
+    result_t result;
+
+    if (vkCreateDescriptorPool(device, &(VkDescriptorPoolCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 2,
+        .pPoolSizes = (VkDescriptorPoolSize[2]) {
+            {
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = NUM_FRAMES_IN_FLIGHT * 3
+            },
+            {
+                .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorCount = NUM_FRAMES_IN_FLIGHT
+            }
+        },
+        .maxSets = NUM_FRAMES_IN_FLIGHT
+    }, NULL, &descriptor_pool) != VK_SUCCESS) {
+        return result_descriptor_pool_create_failure;
+    }
+
+    if (vkCreateDescriptorSetLayout(device, &(VkDescriptorSetLayoutCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &(VkDescriptorSetLayoutBinding) {
+            DEFAULT_VK_DESCRIPTOR_BINDING,
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        }
+    }, NULL, &region_culling_compute_pipeline_set_layout) != VK_SUCCESS) {
+        return result_descriptor_set_layout_create_failure;
+    }
+
+    if (vkCreateDescriptorSetLayout(device, &(VkDescriptorSetLayoutCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 4,
+        .pBindings = (VkDescriptorSetLayoutBinding[4]) {
+            {
+                DEFAULT_VK_DESCRIPTOR_BINDING,
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            {
+                DEFAULT_VK_DESCRIPTOR_BINDING,
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            {
+                DEFAULT_VK_DESCRIPTOR_BINDING,
+                .binding = 2,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            {
+                DEFAULT_VK_DESCRIPTOR_BINDING,
+                .binding = 3,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            }
+        }
+    }, NULL, &draw_descriptor_set_layout) != VK_SUCCESS) {
+        return result_descriptor_set_layout_create_failure;
+    }
+
+    for (size_t i = 0; i < NUM_FRAMES_IN_FLIGHT; i++) {
+        if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
+            DEFAULT_VK_BUFFER,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            .size = NUM_REGION_CULLING_PHASES * NUM_REGIONS * sizeof(VkDrawIndirectCommand)
+        }, &device_allocation_create_info, &region_culling_draw_command_buffers[i], &draw_command_buffer_allocations[i], NULL) != VK_SUCCESS) {
+            return result_buffer_create_failure;
+        }
+
+        if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
+            DEFAULT_VK_BUFFER,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .size = NUM_REGION_CULLING_PHASES * sizeof(uint32_t)
+        }, &device_allocation_create_info, &region_culling_draw_count_buffers[i], &draw_count_buffer_allocations[i], NULL) != VK_SUCCESS) {
+            return result_buffer_create_failure;
+        }
+
+        if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
+            DEFAULT_VK_BUFFER,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .size = NUM_REGIONS * sizeof(uint32_t)
+        }, &device_allocation_create_info, &candidate_flags_buffers[i], &candidate_flags_buffer_allocations[i], NULL) != VK_SUCCESS) {
+            return result_buffer_create_failure;
+        }
+
+        if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
+            DEFAULT_VK_BUFFER,
+            .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .size = sizeof(view_projections_t)
+        }, &device_allocation_create_info, &view_projections_buffers[i], &view_projections_buffer_allocations[i], NULL) != VK_SUCCESS) {
+            return result_buffer_create_failure;
+        }
+
+        if (vkAllocateDescriptorSets(device, &(VkDescriptorSetAllocateInfo) {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &draw_descriptor_set_layout
+        }, &draw_descriptor_sets[i]) != VK_SUCCESS) {
+            return result_descriptor_sets_allocate_failure;
+        }
+
+        vkUpdateDescriptorSets(device, 4, (VkWriteDescriptorSet[4]) {
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = draw_descriptor_sets[i],
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &(VkDescriptorBufferInfo) {
+                    .buffer = region_culling_draw_command_buffers[i],
+                    .offset = 0,
+                    .range = VK_WHOLE_SIZE
+                }
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = draw_descriptor_sets[i],
+                .dstBinding = 1,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &(VkDescriptorBufferInfo) {
+                    .buffer = region_culling_draw_count_buffers[i],
+                    .offset = 0,
+                    .range = VK_WHOLE_SIZE
+                }
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = draw_descriptor_sets[i],
+                .dstBinding = 2,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &(VkDescriptorBufferInfo) {
+                    .buffer = candidate_flags_buffers[i],
+                    .offset = 0,
+                    .range = VK_WHOLE_SIZE
+                }
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = draw_descriptor_sets[i],
+                .dstBinding = 3,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &(VkDescriptorBufferInfo) {
+                    .buffer = view_projections_buffers[i],
+                    .offset = 0,
+                    .range = VK_WHOLE_SIZE
+                }
+            }
+        }, 0, NULL);
+    }
+
+    VkShaderModule shader_module;
+    if ((result = create_shader_module("shader/region_culling.spv", &shader_module)) != result_success) {
+        return result;
+    }
+
+    if (vkCreatePipelineLayout(device, &(VkPipelineLayoutCreateInfo) {
+        DEFAULT_VK_PIPELINE_LAYOUT,
+        .setLayoutCount = 3,
+        .pSetLayouts = (VkDescriptorSetLayout[3]) {
+            region_culling_compute_pipeline_set_layout,
+            draw_descriptor_set_layout,
+            hi_z_set_layout
+        },
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &(VkPushConstantRange) {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .size = sizeof(push_constants_t)
+        }
+    }, NULL, &pipeline.pipeline_layout) != VK_SUCCESS) {
+        return result_pipeline_layout_create_failure;
+    }
+
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &(VkComputePipelineCreateInfo) {
+        DEFAULT_VK_COMPUTE_PIPELINE,
+        .stage = {
+            DEFAULT_VK_SHADER_STAGE,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader_module
+        },
+        .layout = pipeline.pipeline_layout
+    }, NULL, &pipeline.pipeline) != VK_SUCCESS) {
+        return result_compute_pipelines_create_failure;
+    }
+
+    vkDestroyShaderModule(device, shader_module, NULL);
+
+    return result_success;
+}
+
+void dispatch_region_culling_compute_pipeline(VkCommandBuffer command_buffer, uint32_t frame_index, region_culling_phase_t phase) {
+    if (phase == region_culling_phase_first) {
+        vkCmdFillBuffer(command_buffer, region_culling_draw_count_buffers[frame_index], 0, NUM_REGION_CULLING_PHASES * sizeof(uint32_t), 0);
+        vkCmdUpdateBuffer(command_buffer, view_projections_buffers[frame_index], 0, sizeof(view_projections_t), &(view_projections_t) {
+            .view_projection = get_view_projection(),
+            .hi_z_view_projection = hi_z_state.view_projection
+        });
+
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &(VkMemoryBarrier) {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_UNIFORM_READ_BIT
+        }, 0, NULL, 0, NULL);
+    }
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline_layout, 0, 3, (VkDescriptorSet[3]) { region_culling_compute_pipeline_descriptor_sets[frame_index], draw_descriptor_sets[frame_index], hi_z_descriptor_set }, 0, NULL);
+    vkCmdPushConstants(command_buffer, pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_t), &(push_constants_t) {
+        .num_regions = NUM_REGIONS,
+        .phase = phase,
+        .is_hi_z_valid = hi_z_state.is_valid,
+        .num_hi_z_levels = hi_z_state.num_levels,
+        .hi_z_width = hi_z_state.extent.width,
+        .hi_z_height = hi_z_state.extent.height
+    });
+
+    vkCmdDispatch(command_buffer, (NUM_REGIONS + CULLING_WORKGROUP_SIZE - 1) / CULLING_WORKGROUP_SIZE, 1, 1);
+
+    // The second phase reads the candidate flags of the first
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &(VkMemoryBarrier) {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    }, 0, NULL, 0, NULL);
+}
+
+void term_region_culling_compute_pipeline(void) {
+    destroy_pipeline(&pipeline);
+
+    for (size_t i = 0; i < NUM_FRAMES_IN_FLIGHT; i++) {
+        vmaDestroyBuffer(allocator, region_culling_draw_command_buffers[i], draw_command_buffer_allocations[i]);
+        vmaDestroyBuffer(allocator, region_culling_draw_count_buffers[i], draw_count_buffer_allocations[i]);
+        vmaDestroyBuffer(allocator, candidate_flags_buffers[i], candidate_flags_buffer_allocations[i]);
+        vmaDestroyBuffer(allocator, view_projections_buffers[i], view_projections_buffer_allocations[i]);
+    }
+
+    vkDestroyDescriptorSetLayout(device, draw_descriptor_set_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, region_culling_compute_pipeline_set_layout, NULL);
+    vkDestroyDescriptorPool(device, descriptor_pool, NULL);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "gfx/gfx.h"
+#include "result.h"
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+// The first phase runs before the first render pass and tests against the previous frame's Hi-Z pyramid, the second runs after the pyramid has been rebuilt from the first render pass
+typedef enum {
+    region_culling_phase_first,
+    region_culling_phase_second
+} region_culling_phase_t;
+
+#define NUM_REGION_CULLING_PHASES 2
+
+extern VkDescriptorSetLayout region_culling_compute_pipeline_set_layout;
+
+// Draw commands of the regions that passed culling (NUM_REGIONS per phase) and their count (one per phase), indexed by frame index
+extern VkBuffer region_culling_draw_command_buffers[NUM_FRAMES_IN_FLIGHT];
+extern VkBuffer region_culling_draw_count_buffers[NUM_FRAMES_IN_FLIGHT];
+
+// Must be initialized after the Hi-Z compute pipeline
+result_t init_region_culling_compute_pipeline(void);
+// Must be recorded outside of a render pass, the first phase before the second
+void dispatch_region_culling_compute_pipeline(VkCommandBuffer command_buffer, uint32_t frame_index, region_culling_phase_t phase);
+void term_region_culling_compute_pipeline(void);
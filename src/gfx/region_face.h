@@ -0,0 +1,21 @@
+#ifndef REGION_FACE_H
+#define REGION_FACE_H
+
+// Shared between C and GLSL, describes how region_face_t is packed into two 32-bit words
+
+// position_data: region-local voxel position and face index
+#define REGION_FACE_POSITION_BITS 5
+#define REGION_FACE_X_OFFSET 0
+#define REGION_FACE_Y_OFFSET 5
+#define REGION_FACE_Z_OFFSET 10
+#define REGION_FACE_INDEX_OFFSET 15
+#define REGION_FACE_INDEX_BITS 3
+
+// face_data: voxel type and merged face size, the face size is stored minus one
+#define REGION_FACE_VOXEL_TYPE_OFFSET 0
+#define REGION_FACE_VOXEL_TYPE_BITS 8
+#define REGION_FACE_WIDTH_OFFSET 8
+#define REGION_FACE_HEIGHT_OFFSET 13
+#define REGION_FACE_SIZE_BITS 5
+
+#endif
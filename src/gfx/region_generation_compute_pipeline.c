@@ -1,32 +1,136 @@
 #include "region_generation_compute_pipeline.h"
+#include "chrono.h"
 #include "gfx/default.h"
 #include "gfx/gfx.h"
 #include "gfx/gfx_util.h"
+#include "gfx/gpu_profiler.h"
 #include "gfx/pipeline.h"
 #include "result.h"
+#include "util.h"
+#include "voxel/region.h"
+#include "voxel/region_cpu_generation.h"
+#include "voxel/region_io.h"
 #include "voxel/region_management.h"
+#include "voxel/region_store.h"
+#include "voxel/region_voxels.h"
+#include "voxel/voxel.h"
+#include <assert.h>
 #include <cglm/types-struct.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
 
+// Every staging slot can have a load and a save in flight
+static_assert(REGION_IO_QUEUE_CAPACITY >= 2 * NUM_REGIONS);
+
+typedef enum {
+    staging_state_idle,
+    staging_state_loading,
+    // Holds the voxels of its staging position until they're copied
+    staging_state_ready
+} staging_state_t;
+
+typedef struct {
+    uint32_t region_index;
+} push_constants_t;
+
+typedef struct {
+    uint32_t level;
+} downsampling_push_constants_t;
+
+// Matches voxel_type_range_t in region_generation.comp
+typedef struct {
+    uint32_t min_voxel_type;
+    // Inverted so both bounds are found with atomicMin and cleared by a single fill
+    uint32_t inverted_max_voxel_type;
+} voxel_type_range_t;
+
 static pipeline_t pipeline;
+// Fills the coarser levels of detail of the voxel images from level 0
+static pipeline_t downsampling_pipeline;
+
+// Indexed by region index, read back once GPU generation has finished to find uniform regions
+static VkBuffer voxel_type_range_buffer;
+static VmaAllocation voxel_type_range_buffer_allocation;
+static VkDescriptorSetLayout voxel_type_range_set_layout;
+static VkDescriptorPool descriptor_pool;
+static VkDescriptorSet voxel_type_range_descriptor_set;
+
+static size_t num_dispatched_regions;
+static size_t dispatched_region_indices[NUM_REGIONS];
+
+// Only created for CPU generation, holds one region per resident region, indexed like the regions
+static VkBuffer staging_buffer;
+static VmaAllocation staging_buffer_allocation;
+static region_voxels_t* staging_voxels;
+
+static staging_state_t staging_states[NUM_REGIONS];
+static ivec3s staging_positions[NUM_REGIONS];
+// A slot being saved is read by the I/O thread, so it can't be loaded into until the save completes
+static bool staging_saving_flags[NUM_REGIONS];
+static atomic_bool staging_cancel_flags[NUM_REGIONS];
+// Reported by loading or generating the slot, uniform regions aren't copied into a voxel image
+static uint8_t staging_uniform_voxel_types[NUM_REGIONS];
+
+// Generation is submitted with a timeline signal and polled, at most one submission is in flight
+static VkSemaphore semaphore;
+static uint64_t semaphore_value;
+static bool is_generation_pending;
+static microseconds_t generation_start;
 
 VkDescriptorSetLayout region_generation_compute_pipeline_set_layout;
 
-result_t init_region_generation_compute_pipeline(void) {
+result_t init_region_generation_compute_pipeline(region_generation_mode_t generation_mode) {
     result_t result;
 
+    if (generation_mode == region_generation_mode_cpu) {
+        if ((result = init_region_store()) != result_success) {
+            return result;
+        }
+        if ((result = init_region_io()) != result_success) {
+            return result;
+        }
+
+        // Cached, since slots are read back by the I/O thread to save them and by the CPU mesher
+        if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
+            DEFAULT_VK_STAGING_BUFFER,
+            .size = NUM_REGIONS * sizeof(region_voxels_t)
+        }, &shared_read_allocation_create_info, &staging_buffer, &staging_buffer_allocation, NULL) != VK_SUCCESS) {
+            return result_buffer_create_failure;
+        }
+
+        // Kept mapped for the whole run so regions are generated straight into it
+        if (vmaMapMemory(allocator, staging_buffer_allocation, (void**) &staging_voxels) != VK_SUCCESS) {
+            return result_memory_map_failure;
+        }
+    }
+
+    if (vkCreateSemaphore(device, &(VkSemaphoreCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &(VkSemaphoreTypeCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0
+        }
+    }, NULL, &semaphore) != VK_SUCCESS) {
+        return result_synchronization_primitive_create_failure;
+    }
+
     VkShaderModule shader_module;
     if ((result = create_shader_module("shader/region_generation.spv", &shader_module)) != result_success) {
         return result;
     }
 
+    // Binding 2 holds every level of detail of the voxel image, for downsampling
     if (vkCreateDescriptorSetLayout(device, &(VkDescriptorSetLayoutCreateInfo) {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .bindingCount = 2,
-        .pBindings = (VkDescriptorSetLayoutBinding[2]) {
+        .bindingCount = 3,
+        .pBindings = (VkDescriptorSetLayoutBinding[3]) {
             {
                 DEFAULT_VK_DESCRIPTOR_BINDING,
                 .binding = 0,
@@ -38,15 +142,87 @@ result_t init_region_generation_compute_pipeline(void) {
                 .binding = 1,
                 .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
                 .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+            },
+            {
+                DEFAULT_VK_DESCRIPTOR_BINDING,
+                .binding = 2,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = NUM_REGION_LODS,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
             }
         }
     }, NULL, &region_generation_compute_pipeline_set_layout) != VK_SUCCESS) {
         return result_descriptor_set_layout_create_failure;
     }
 
+    if (vkCreateDescriptorSetLayout(device, &(VkDescriptorSetLayoutCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &(VkDescriptorSetLayoutBinding) {
+            DEFAULT_VK_DESCRIPTOR_BINDING,
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        }
+    }, NULL, &voxel_type_range_set_layout) != VK_SUCCESS) {
+        return result_descriptor_set_layout_create_failure;
+    }
+
+    if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
+        DEFAULT_VK_BUFFER,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .size = NUM_REGIONS * sizeof(voxel_type_range_t)
+    }, &shared_read_allocation_create_info, &voxel_type_range_buffer, &voxel_type_range_buffer_allocation, NULL) != VK_SUCCESS) {
+        return result_buffer_create_failure;
+    }
+
+    if (vkCreateDescriptorPool(device, &(VkDescriptorPoolCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 1,
+        .pPoolSizes = &(VkDescriptorPoolSize) {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1
+        },
+        .maxSets = 1
+    }, NULL, &descriptor_pool) != VK_SUCCESS) {
+        return result_descriptor_pool_create_failure;
+    }
+
+    if (vkAllocateDescriptorSets(device, &(VkDescriptorSetAllocateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &voxel_type_range_set_layout
+    }, &voxel_type_range_descriptor_set) != VK_SUCCESS) {
+        return result_descriptor_sets_allocate_failure;
+    }
+
+    vkUpdateDescriptorSets(device, 1, &(VkWriteDescriptorSet) {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = voxel_type_range_descriptor_set,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .pBufferInfo = &(VkDescriptorBufferInfo) {
+            .buffer = voxel_type_range_buffer,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE
+        }
+    }, 0, NULL);
+
     if (vkCreatePipelineLayout(device, &(VkPipelineLayoutCreateInfo) {
         DEFAULT_VK_PIPELINE_LAYOUT,
-        .pSetLayouts = &region_generation_compute_pipeline_set_layout
+        .setLayoutCount = 2,
+        .pSetLayouts = (VkDescriptorSetLayout[2]) {
+            region_generation_compute_pipeline_set_layout,
+            voxel_type_range_set_layout
+        },
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &(VkPushConstantRange) {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .size = sizeof(push_constants_t)
+        }
     }, NULL, &pipeline.pipeline_layout) != VK_SUCCESS) {
         return result_pipeline_layout_create_failure;
     }
@@ -65,50 +241,478 @@ result_t init_region_generation_compute_pipeline(void) {
 
     vkDestroyShaderModule(device, shader_module, NULL);
 
+    if ((result = create_shader_module("shader/region_voxel_downsampling.spv", &shader_module)) != result_success) {
+        return result;
+    }
+
+    if (vkCreatePipelineLayout(device, &(VkPipelineLayoutCreateInfo) {
+        DEFAULT_VK_PIPELINE_LAYOUT,
+        .setLayoutCount = 1,
+        .pSetLayouts = &region_generation_compute_pipeline_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &(VkPushConstantRange) {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .size = sizeof(downsampling_push_constants_t)
+        }
+    }, NULL, &downsampling_pipeline.pipeline_layout) != VK_SUCCESS) {
+        return result_pipeline_layout_create_failure;
+    }
+
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &(VkComputePipelineCreateInfo) {
+        DEFAULT_VK_COMPUTE_PIPELINE,
+        .stage = {
+            DEFAULT_VK_SHADER_STAGE,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shader_module
+        },
+        .layout = downsampling_pipeline.pipeline_layout
+    }, NULL, &downsampling_pipeline.pipeline) != VK_SUCCESS) {
+        return result_compute_pipelines_create_failure;
+    }
+
+    vkDestroyShaderModule(device, shader_module, NULL);
+
     return result_success;
 }
 
-result_t record_region_generation_compute_pipeline(VkCommandBuffer command_buffer) {
-    if (vkBeginCommandBuffer(command_buffer, &(VkCommandBufferBeginInfo) {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
-    }) != VK_SUCCESS) {
-        return result_command_buffer_begin_failure;
+// Every level of the regions' voxel images must be in the general layout with level 0 written and visible to compute shaders
+// Leaves every level ready to be sampled by meshing
+static void record_voxel_downsampling(VkCommandBuffer command_buffer, size_t num_regions, const size_t region_indices[]) {
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, downsampling_pipeline.pipeline);
+
+    // Each level is read once the level before it has been written for every region
+    for (uint32_t level = 1; level < NUM_REGION_LODS; level++) {
+        uint32_t num_workgroups = (REGION_SIZE >> level) / 4;
+
+        vkCmdPushConstants(command_buffer, downsampling_pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(downsampling_push_constants_t), &(downsampling_push_constants_t) {
+            .level = level
+        });
+        for (size_t i = 0; i < num_regions; i++) {
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, downsampling_pipeline.pipeline_layout, 0, 1, &region_generation_compute_pipeline_infos[region_indices[i]].descriptor_set, 0, NULL);
+            vkCmdDispatch(command_buffer, num_workgroups, num_workgroups, num_workgroups);
+        }
+
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &(VkMemoryBarrier) {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+        }, 0, NULL, 0, NULL);
     }
 
-    for (size_t i = 0; i < NUM_REGIONS; i++) {
-        const region_generation_compute_pipeline_info_t* info = &region_generation_compute_pipeline_infos[i];
+    VkImageMemoryBarrier image_memory_barriers[NUM_REGIONS];
+    for (size_t i = 0; i < num_regions; i++) {
+        image_memory_barriers[i] = (VkImageMemoryBarrier) {
+            DEFAULT_VK_IMAGE_MEMORY_BARRIER,
+            .image = region_generation_compute_pipeline_infos[region_indices[i]].voxel_image,
+            .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .subresourceRange.levelCount = NUM_REGION_LODS
+        };
+    }
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, (uint32_t) num_regions, image_memory_barriers);
+}
+
+static void start_region_generation(size_t region_index) {
+    region_mesh_states[region_index] = region_mesh_state_await_meshing_compute;
+
+    // Already meshed neighbours hid their border faces against this region's previous contents
+    for (uint32_t face_index = 0; face_index < NUM_CUBE_VOXEL_FACES; face_index++) {
+        size_t neighbour_region_index;
+        if (get_generated_region_neighbour_index(region_index, face_index, &neighbour_region_index) && region_mesh_states[neighbour_region_index] == region_mesh_state_completed) {
+            region_mesh_states[neighbour_region_index] = region_mesh_state_await_meshing_compute;
+        }
+    }
+}
+
+static void record_region_generation_dispatches(VkCommandBuffer command_buffer) {
+    num_dispatched_regions = 0;
+
+    vkCmdFillBuffer(command_buffer, voxel_type_range_buffer, 0, VK_WHOLE_SIZE, UINT32_MAX);
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &(VkMemoryBarrier) {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    }, 0, NULL, 0, NULL);
+
+    for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
+        if (region_mesh_states[region_index] != region_mesh_state_await_generation) {
+            continue;
+        }
+        // Every region is dispatched since uniform ones are only known from the voxel type ranges, others wait for uniform regions found by this generation to return their images
+        if (!acquire_region_voxel_image(region_index)) {
+            continue;
+        }
+        start_region_generation(region_index);
+        dispatched_region_indices[num_dispatched_regions++] = region_index;
+
+        const region_generation_compute_pipeline_info_t* info = &region_generation_compute_pipeline_infos[region_index];
 
         vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &(VkImageMemoryBarrier) {
             DEFAULT_VK_IMAGE_MEMORY_BARRIER,
             .image = info->voxel_image,
             .newLayout = VK_IMAGE_LAYOUT_GENERAL,
-            .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT
+            .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .subresourceRange.levelCount = NUM_REGION_LODS
         });
         vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
-        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline_layout, 0, 1, &info->descriptor_set, 0, NULL);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline_layout, 0, 2, (VkDescriptorSet[2]) { info->descriptor_set, voxel_type_range_descriptor_set }, 0, NULL);
+        vkCmdPushConstants(command_buffer, pipeline.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_t), &(push_constants_t) {
+            .region_index = (uint32_t) region_index
+        });
 
         vkCmdDispatch(command_buffer, 8, 8, 8);
+    }
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &(VkMemoryBarrier) {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+    }, 0, NULL, 0, NULL);
+
+    record_voxel_downsampling(command_buffer, num_dispatched_regions, dispatched_region_indices);
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &(VkMemoryBarrier) {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT
+    }, 0, NULL, 0, NULL);
+}
+
+static bool is_staging_slot_current(size_t region_index) {
+    ivec3s position = staging_positions[region_index];
+    ivec3s region_position = region_positions[region_index];
+    return region_mesh_states[region_index] == region_mesh_state_await_generation && position.x == region_position.x && position.y == region_position.y && position.z == region_position.z;
+}
+
+static result_t generate_missing_regions(size_t num_regions, const size_t region_indices[]) {
+    ivec3s positions[NUM_REGIONS];
+    region_voxels_t* voxels[NUM_REGIONS];
+    uint8_t uniform_voxel_types[NUM_REGIONS];
+    region_io_request_t save_requests[NUM_REGIONS];
+    for (size_t i = 0; i < num_regions; i++) {
+        size_t region_index = region_indices[i];
+        positions[i] = staging_positions[region_index];
+        voxels[i] = &staging_voxels[region_index];
+        save_requests[i] = (region_io_request_t) {
+            .type = region_io_request_type_save,
+            .region_position = positions[i],
+            .voxels = voxels[i],
+            .user_index = region_index
+        };
+    }
+
+    generate_regions_on_cpu(num_regions, positions, voxels, uniform_voxel_types);
+
+    // Copying only reads the slots, so they're ready while the I/O thread saves them
+    for (size_t i = 0; i < num_regions; i++) {
+        staging_states[region_indices[i]] = staging_state_ready;
+        staging_uniform_voxel_types[region_indices[i]] = uniform_voxel_types[i];
+        staging_saving_flags[region_indices[i]] = true;
+    }
+
+    if (queue_region_io_requests(num_regions, save_requests) != num_regions) {
+        return result_region_io_queue_full;
+    }
+
+    return result_success;
+}
+
+result_t update_region_generation(region_generation_mode_t generation_mode) {
+    if (generation_mode != region_generation_mode_cpu) {
+        return result_success;
+    }
+
+    result_t result;
+
+    size_t num_missing_regions = 0;
+    size_t missing_region_indices[NUM_REGIONS];
+
+    region_io_completion_t completion;
+    while (poll_region_io_completion(&completion)) {
+        size_t region_index = completion.user_index;
+        if (completion.status == region_io_status_failed) {
+            return completion.result;
+        }
+
+        if (completion.type == region_io_request_type_save) {
+            staging_saving_flags[region_index] = false;
+            continue;
+        }
+
+        if (completion.status == region_io_status_cancelled || !is_staging_slot_current(region_index)) {
+            staging_states[region_index] = staging_state_idle;
+        } else if (completion.status == region_io_status_loaded) {
+            staging_states[region_index] = staging_state_ready;
+            staging_uniform_voxel_types[region_index] = completion.uniform_voxel_type;
+        } else {
+            missing_region_indices[num_missing_regions++] = region_index;
+        }
+    }
+
+    if (num_missing_regions > 0 && (result = generate_missing_regions(num_missing_regions, missing_region_indices)) != result_success) {
+        return result;
+    }
+
+    size_t num_load_requests = 0;
+    region_io_request_t load_requests[NUM_REGIONS];
+    for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
+        // Regions that left the view radius or moved again before their load finished
+        if (staging_states[region_index] != staging_state_idle && !is_staging_slot_current(region_index)) {
+            if (staging_states[region_index] == staging_state_loading) {
+                atomic_store(&staging_cancel_flags[region_index], true);
+                continue;
+            }
+            staging_states[region_index] = staging_state_idle;
+        }
+
+        if (staging_states[region_index] != staging_state_idle || staging_saving_flags[region_index] || region_mesh_states[region_index] != region_mesh_state_await_generation) {
+            continue;
+        }
+
+        staging_positions[region_index] = region_positions[region_index];
+
+        // Uniform from their column's surface bounds already, so there's nothing to load
+        if (region_uniform_voxel_types[region_index] != NULL_UINT8) {
+            staging_states[region_index] = staging_state_ready;
+            staging_uniform_voxel_types[region_index] = region_uniform_voxel_types[region_index];
+            continue;
+        }
 
-        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &(VkImageMemoryBarrier) {
+        staging_states[region_index] = staging_state_loading;
+        atomic_store(&staging_cancel_flags[region_index], false);
+
+        // Decoded straight into the slot the voxel image is copied from
+        load_requests[num_load_requests++] = (region_io_request_t) {
+            .type = region_io_request_type_load,
+            .region_position = region_positions[region_index],
+            .voxels = &staging_voxels[region_index],
+            .user_index = region_index,
+            .is_cancelled = &staging_cancel_flags[region_index]
+        };
+    }
+
+    if (queue_region_io_requests(num_load_requests, load_requests) != num_load_requests) {
+        return result_region_io_queue_full;
+    }
+
+    return result_success;
+}
+
+const region_voxels_t* get_region_staging_voxels(size_t region_index) {
+    return &staging_voxels[region_index];
+}
+
+bool is_region_generation_ready(region_generation_mode_t generation_mode) {
+    switch (generation_mode) {
+        case region_generation_mode_gpu:
+            for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
+                if (region_mesh_states[region_index] == region_mesh_state_await_generation && has_free_region_voxel_image()) {
+                    return true;
+                }
+            }
+            return false;
+        case region_generation_mode_cpu:
+            for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
+                if (staging_states[region_index] == staging_state_ready && (staging_uniform_voxel_types[region_index] != NULL_UINT8 || has_free_region_voxel_image())) {
+                    return true;
+                }
+            }
+            return false;
+    }
+    return false;
+}
+
+static void record_region_generation_copies(VkCommandBuffer command_buffer) {
+    size_t num_generated_regions = 0;
+    size_t generated_region_indices[NUM_REGIONS];
+    for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
+        if (staging_states[region_index] != staging_state_ready || !is_staging_slot_current(region_index)) {
+            continue;
+        }
+
+        // Uniform regions are done without a copy, the others stay ready until a voxel image is free
+        uint8_t uniform_voxel_type = staging_uniform_voxel_types[region_index];
+        if (uniform_voxel_type != NULL_UINT8) {
+            set_region_uniform_voxel_type(region_index, uniform_voxel_type);
+        } else if (acquire_region_voxel_image(region_index)) {
+            generated_region_indices[num_generated_regions++] = region_index;
+        } else {
+            continue;
+        }
+
+        start_region_generation(region_index);
+        staging_states[region_index] = staging_state_idle;
+    }
+
+    VkImageMemoryBarrier image_memory_barriers[NUM_REGIONS];
+    for (size_t i = 0; i < num_generated_regions; i++) {
+        image_memory_barriers[i] = (VkImageMemoryBarrier) {
             DEFAULT_VK_IMAGE_MEMORY_BARRIER,
-            .image = info->voxel_image,
-            .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
-            .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+            .image = region_generation_compute_pipeline_infos[generated_region_indices[i]].voxel_image,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .subresourceRange.levelCount = NUM_REGION_LODS
+        };
+    }
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, (uint32_t) num_generated_regions, image_memory_barriers);
+
+    for (size_t i = 0; i < num_generated_regions; i++) {
+        vkCmdCopyBufferToImage(command_buffer, staging_buffer, region_generation_compute_pipeline_infos[generated_region_indices[i]].voxel_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &(VkBufferImageCopy) {
+            .bufferOffset = generated_region_indices[i] * sizeof(region_voxels_t),
+            .imageSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .layerCount = 1
+            },
+            .imageExtent = { REGION_SIZE, REGION_SIZE, REGION_SIZE }
         });
+
+        // Only level 0 is copied, downsampling writes the others
+        image_memory_barriers[i].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        image_memory_barriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        image_memory_barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        image_memory_barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    }
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, (uint32_t) num_generated_regions, image_memory_barriers);
+
+    record_voxel_downsampling(command_buffer, num_generated_regions, generated_region_indices);
+}
+
+result_t submit_region_generation_compute_pipeline(VkCommandBuffer command_buffer, region_generation_mode_t generation_mode) {
+    assert(!is_generation_pending);
+
+    if (vkResetCommandBuffer(command_buffer, 0) != VK_SUCCESS) {
+        return result_command_buffer_reset_failure;
     }
 
+    if (vkBeginCommandBuffer(command_buffer, &(VkCommandBufferBeginInfo) {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    }) != VK_SUCCESS) {
+        return result_command_buffer_begin_failure;
+    }
+
+    uint32_t profile_scope_index = begin_gpu_profile(command_buffer, gpu_profile_pass_generation);
+
+    switch (generation_mode) {
+        case region_generation_mode_gpu:
+            record_region_generation_dispatches(command_buffer);
+            break;
+        case region_generation_mode_cpu:
+            record_region_generation_copies(command_buffer);
+            break;
+    }
+
+    end_gpu_profile(command_buffer, profile_scope_index);
+
     if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
         return result_command_buffer_end_failure;
     }
 
+    semaphore_value++;
+    if (vkQueueSubmit(compute_queue, 1, &(VkSubmitInfo) {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &(VkTimelineSemaphoreSubmitInfo) {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &semaphore_value
+        },
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &semaphore
+    }, VK_NULL_HANDLE) != VK_SUCCESS) {
+        return result_queue_submit_failure;
+    }
+
+    is_generation_pending = true;
+    generation_start = get_current_microseconds();
+
     return result_success;
 }
 
+// Voxel type ranges were written by the submission, which has finished
+static result_t finish_region_generation(region_generation_mode_t generation_mode) {
+    is_generation_pending = false;
+    printf("Voxel generation took %ldμs\n", get_current_microseconds() - generation_start);
+
+    if (generation_mode != region_generation_mode_gpu || num_dispatched_regions == 0) {
+        return result_success;
+    }
+
+    const voxel_type_range_t* voxel_type_ranges;
+    if (vmaMapMemory(allocator, voxel_type_range_buffer_allocation, (void**) &voxel_type_ranges) != VK_SUCCESS) {
+        return result_memory_map_failure;
+    }
+
+    // Meshing hasn't started on these regions yet, so their voxel images can go back to the pool
+    for (size_t i = 0; i < num_dispatched_regions; i++) {
+        size_t region_index = dispatched_region_indices[i];
+        voxel_type_range_t range = voxel_type_ranges[region_index];
+        if (range.min_voxel_type == ~range.inverted_max_voxel_type) {
+            set_region_uniform_voxel_type(region_index, (uint8_t) range.min_voxel_type);
+        }
+    }
+
+    vmaUnmapMemory(allocator, voxel_type_range_buffer_allocation);
+    num_dispatched_regions = 0;
+
+    return result_success;
+}
+
+bool is_region_generation_pending(void) {
+    return is_generation_pending;
+}
+
+result_t complete_region_generation(region_generation_mode_t generation_mode) {
+    if (!is_generation_pending) {
+        return result_success;
+    }
+
+    uint64_t reached_semaphore_value;
+    if (vkGetSemaphoreCounterValue(device, semaphore, &reached_semaphore_value) != VK_SUCCESS) {
+        return result_semaphore_counter_value_get_failure;
+    }
+    if (reached_semaphore_value < semaphore_value) {
+        return result_success;
+    }
+
+    return finish_region_generation(generation_mode);
+}
+
+result_t wait_for_region_generation(region_generation_mode_t generation_mode) {
+    if (!is_generation_pending) {
+        return result_success;
+    }
+
+    if (vkWaitSemaphores(device, &(VkSemaphoreWaitInfo) {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &semaphore,
+        .pValues = &semaphore_value
+    }, UINT64_MAX) != VK_SUCCESS) {
+        return result_semaphores_wait_failure;
+    }
+
+    return finish_region_generation(generation_mode);
+}
+
 void term_region_generation_compute_pipeline(void) {
+    if (staging_buffer != VK_NULL_HANDLE) {
+        // Pending saves still read staging memory
+        term_region_io();
+        vmaUnmapMemory(allocator, staging_buffer_allocation);
+        vmaDestroyBuffer(allocator, staging_buffer, staging_buffer_allocation);
+    }
+
     destroy_pipeline(&pipeline);
+    destroy_pipeline(&downsampling_pipeline);
+
+    vkDestroyDescriptorPool(device, descriptor_pool, NULL);
+    vmaDestroyBuffer(allocator, voxel_type_range_buffer, voxel_type_range_buffer_allocation);
+    vkDestroySemaphore(device, semaphore, NULL);
 
     vkDestroyDescriptorSetLayout(device, region_generation_compute_pipeline_set_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, voxel_type_range_set_layout, NULL);
 }
\ No newline at end of file
@@ -1,9 +1,34 @@
 #pragma once
 #include "result.h"
+#include "voxel/region_voxels.h"
+#include <stdbool.h>
+#include <stddef.h>
 #include <vulkan/vulkan.h>
 
+typedef enum {
+    // Voxel images are written by the generation compute pipeline
+    region_generation_mode_gpu,
+    // Regions are generated on every CPU core and copied into the voxel images
+    region_generation_mode_cpu
+} region_generation_mode_t;
+
 extern VkDescriptorSetLayout region_generation_compute_pipeline_set_layout;
 
-result_t init_region_generation_compute_pipeline(void);
-result_t record_region_generation_compute_pipeline(VkCommandBuffer command_buffer);
+result_t init_region_generation_compute_pipeline(region_generation_mode_t generation_mode);
+// Only does something for CPU generation, where it loads regions on the I/O thread and generates the ones that were never saved
+result_t update_region_generation(region_generation_mode_t generation_mode);
+// Only for CPU generation, the voxels a generated region was copied from, they stay until the region is placed again
+// Uniform regions may never have had theirs written
+const region_voxels_t* get_region_staging_voxels(size_t region_index);
+// Whether recording would write any voxel images
+bool is_region_generation_ready(region_generation_mode_t generation_mode);
+// Records and submits the command buffer on the compute queue without waiting, the previous generation must have been completed
+// CPU generated voxels are copied from staging memory that's only refilled for regions placed again, which waits for completion
+result_t submit_region_generation_compute_pipeline(VkCommandBuffer command_buffer, region_generation_mode_t generation_mode);
+// Submitted but not completed yet, the generated regions already await meshing but mustn't be meshed or placed again until then
+bool is_region_generation_pending(void);
+// Polls the submission and completes it once it has finished on the GPU, regions found to be uniform give their voxel images back
+result_t complete_region_generation(region_generation_mode_t generation_mode);
+// Blocks until the submission has finished and completes it
+result_t wait_for_region_generation(region_generation_mode_t generation_mode);
 void term_region_generation_compute_pipeline(void);
\ No newline at end of file
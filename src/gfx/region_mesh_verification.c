@@ -0,0 +1,226 @@
+#include "region_mesh_verification.h"
+#include "gfx/default.h"
+#include "gfx/gfx.h"
+#include "gfx/gfx_util.h"
+#include "gfx/region_face.h"
+#include "gfx/region_meshing_compute_pipeline.h"
+#include "result.h"
+#include "util.h"
+#include "voxel/region.h"
+#include "voxel/region_cpu_generation.h"
+#include "voxel/region_cpu_meshing.h"
+#include "voxel/region_management.h"
+#include "voxel/region_voxels.h"
+#include "voxel/voxel.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+// The region itself followed by its neighbours in face order
+#define NUM_VERIFICATION_VOXEL_REGIONS (1 + NUM_CUBE_VOXEL_FACES)
+
+static region_voxels_t voxels[MAX_NUM_VERIFIED_REGION_MESHES][NUM_VERIFICATION_VOXEL_REGIONS];
+static region_face_t cpu_faces[MAX_NUM_REGION_CPU_MESHING_FACES];
+static region_face_t gpu_faces[MAX_NUM_REGION_CPU_MESHING_FACES];
+
+// Seams and coarser levels of detail give faces the CPU mesher can't reproduce
+static bool is_region_mesh_verifiable(size_t region_index) {
+    if (region_mesh_states[region_index] != region_mesh_state_completed || region_lods[region_index] != 0 || region_uniform_voxel_types[region_index] != NULL_UINT8 || region_render_pipeline_infos[region_index].num_faces == 0) {
+        return false;
+    }
+
+    for (uint32_t face_index = 0; face_index < NUM_CUBE_VOXEL_FACES; face_index++) {
+        size_t neighbour_region_index;
+        if (get_generated_region_neighbour_index(region_index, face_index, &neighbour_region_index) && region_lods[neighbour_region_index] != 0 && region_uniform_voxel_types[neighbour_region_index] == NULL_UINT8) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Splits merged faces back into one face per voxel, false if they'd overflow the face array
+static bool split_region_faces(size_t num_faces, const region_face_t faces[], size_t* num_split_faces, region_face_t split_faces[]) {
+    uint32_t position_mask = (1u << REGION_FACE_POSITION_BITS) - 1u;
+    uint32_t size_mask = (1u << REGION_FACE_SIZE_BITS) - 1u;
+    uint32_t voxel_type_mask = (1u << REGION_FACE_VOXEL_TYPE_BITS) - 1u;
+    uint32_t index_mask = (1u << REGION_FACE_INDEX_BITS) - 1u;
+    uint32_t position_offsets[3] = { REGION_FACE_X_OFFSET, REGION_FACE_Y_OFFSET, REGION_FACE_Z_OFFSET };
+
+    *num_split_faces = 0;
+    for (size_t i = 0; i < num_faces; i++) {
+        uint32_t face_index = (faces[i].position_data >> REGION_FACE_INDEX_OFFSET) & index_mask;
+        uint32_t width = ((faces[i].face_data >> REGION_FACE_WIDTH_OFFSET) & size_mask) + 1;
+        uint32_t height = ((faces[i].face_data >> REGION_FACE_HEIGHT_OFFSET) & size_mask) + 1;
+
+        // Width runs along the axis after the face's normal axis and height along the one after that, like in the greedy mesher
+        uint32_t normal_axis = face_index / 2;
+        uint32_t width_axis = (normal_axis + 1) % 3;
+        uint32_t height_axis = (normal_axis + 2) % 3;
+
+        uint32_t position[3];
+        for (size_t axis = 0; axis < 3; axis++) {
+            position[axis] = (faces[i].position_data >> position_offsets[axis]) & position_mask;
+        }
+
+        if (*num_split_faces + width * height > MAX_NUM_REGION_CPU_MESHING_FACES) {
+            return false;
+        }
+
+        for (uint32_t v = 0; v < height; v++) {
+            for (uint32_t u = 0; u < width; u++) {
+                uint32_t split_position[3] = { position[0], position[1], position[2] };
+                split_position[width_axis] += u;
+                split_position[height_axis] += v;
+
+                split_faces[(*num_split_faces)++] = (region_face_t) {
+                    .position_data = (split_position[0] << REGION_FACE_X_OFFSET) | (split_position[1] << REGION_FACE_Y_OFFSET) | (split_position[2] << REGION_FACE_Z_OFFSET) | (face_index << REGION_FACE_INDEX_OFFSET),
+                    .face_data = ((faces[i].face_data >> REGION_FACE_VOXEL_TYPE_OFFSET) & voxel_type_mask) << REGION_FACE_VOXEL_TYPE_OFFSET
+                };
+            }
+        }
+    }
+    return true;
+}
+
+result_t verify_region_meshes(VkCommandBuffer command_buffer, VkFence command_fence, region_mesh_verification_t* verification) {
+    result_t result;
+
+    *verification = (region_mesh_verification_t) { 0 };
+
+    size_t region_indices[MAX_NUM_VERIFIED_REGION_MESHES];
+    size_t num_regions = 0;
+    VkDeviceSize num_faces = 0;
+    for (size_t region_index = 0; region_index < NUM_REGIONS && num_regions < MAX_NUM_VERIFIED_REGION_MESHES; region_index++) {
+        if (is_region_mesh_verifiable(region_index)) {
+            region_indices[num_regions++] = region_index;
+            num_faces += region_render_pipeline_infos[region_index].num_faces;
+        }
+    }
+    if (num_regions == 0) {
+        return result_success;
+    }
+
+    VkBuffer readback_buffer;
+    VmaAllocation readback_buffer_allocation;
+    if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
+        DEFAULT_VK_BUFFER,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .size = num_faces * sizeof(region_face_t)
+    }, &shared_read_allocation_create_info, &readback_buffer, &readback_buffer_allocation, NULL) != VK_SUCCESS) {
+        return result_buffer_create_failure;
+    }
+
+    if (vkBeginCommandBuffer(command_buffer, &(VkCommandBufferBeginInfo) {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    }) != VK_SUCCESS) {
+        return result_command_buffer_begin_failure;
+    }
+
+    // Meshing wrote the faces in earlier submissions on the same queue
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &(VkMemoryBarrier) {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT
+    }, 0, NULL, 0, NULL);
+
+    VkBufferCopy copy_regions[MAX_NUM_VERIFIED_REGION_MESHES];
+    VkDeviceSize first_readback_face = 0;
+    for (size_t i = 0; i < num_regions; i++) {
+        const region_render_pipeline_info_t* render_info = &region_render_pipeline_infos[region_indices[i]];
+        copy_regions[i] = (VkBufferCopy) {
+            .srcOffset = render_info->first_face * sizeof(region_face_t),
+            .dstOffset = first_readback_face * sizeof(region_face_t),
+            .size = render_info->num_faces * sizeof(region_face_t)
+        };
+        first_readback_face += render_info->num_faces;
+    }
+    vkCmdCopyBuffer(command_buffer, region_face_buffer, readback_buffer, (uint32_t) num_regions, copy_regions);
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &(VkMemoryBarrier) {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT
+    }, 0, NULL, 0, NULL);
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        return result_command_buffer_end_failure;
+    }
+
+    // The CPU generates the voxels while the copy runs
+    ivec3s voxel_region_positions[MAX_NUM_VERIFIED_REGION_MESHES * NUM_VERIFICATION_VOXEL_REGIONS];
+    region_voxels_t* voxel_pointers[MAX_NUM_VERIFIED_REGION_MESHES * NUM_VERIFICATION_VOXEL_REGIONS];
+    uint8_t uniform_voxel_types[MAX_NUM_VERIFIED_REGION_MESHES * NUM_VERIFICATION_VOXEL_REGIONS];
+    for (size_t i = 0; i < num_regions; i++) {
+        ivec3s position = region_positions[region_indices[i]];
+        ivec3s neighbour_offsets[NUM_CUBE_VOXEL_FACES] = {
+            [VOXEL_PX_FACE_INDEX] = {{ 1, 0, 0 }},
+            [VOXEL_NX_FACE_INDEX] = {{ -1, 0, 0 }},
+            [VOXEL_PY_FACE_INDEX] = {{ 0, 1, 0 }},
+            [VOXEL_NY_FACE_INDEX] = {{ 0, -1, 0 }},
+            [VOXEL_PZ_FACE_INDEX] = {{ 0, 0, 1 }},
+            [VOXEL_NZ_FACE_INDEX] = {{ 0, 0, -1 }}
+        };
+
+        voxel_region_positions[i * NUM_VERIFICATION_VOXEL_REGIONS] = position;
+        for (size_t face_index = 0; face_index < NUM_CUBE_VOXEL_FACES; face_index++) {
+            voxel_region_positions[i * NUM_VERIFICATION_VOXEL_REGIONS + 1 + face_index] = (ivec3s) {{ position.x + neighbour_offsets[face_index].x, position.y + neighbour_offsets[face_index].y, position.z + neighbour_offsets[face_index].z }};
+        }
+        for (size_t j = 0; j < NUM_VERIFICATION_VOXEL_REGIONS; j++) {
+            voxel_pointers[i * NUM_VERIFICATION_VOXEL_REGIONS + j] = &voxels[i][j];
+        }
+    }
+
+    if (vkQueueSubmit(compute_queue, 1, &(VkSubmitInfo) {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer
+    }, command_fence) != VK_SUCCESS) {
+        return result_queue_submit_failure;
+    }
+
+    generate_regions_on_cpu(num_regions * NUM_VERIFICATION_VOXEL_REGIONS, voxel_region_positions, voxel_pointers, uniform_voxel_types);
+
+    if (vkWaitForFences(device, 1, &command_fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+        return result_fences_wait_failure;
+    }
+    if ((result = reset_command_processing(command_buffer, command_fence)) != result_success) {
+        return result;
+    }
+
+    const region_face_t* readback_faces;
+    if (vmaMapMemory(allocator, readback_buffer_allocation, (void**) &readback_faces) != VK_SUCCESS) {
+        return result_memory_map_failure;
+    }
+
+    first_readback_face = 0;
+    for (size_t i = 0; i < num_regions; i++) {
+        size_t region_index = region_indices[i];
+        uint32_t num_region_faces = region_render_pipeline_infos[region_index].num_faces;
+
+        // Faces towards neighbours that weren't generated are hidden on the GPU, which is what a missing neighbour does on the CPU
+        const region_voxels_t* neighbour_voxels[NUM_CUBE_VOXEL_FACES];
+        for (uint32_t face_index = 0; face_index < NUM_CUBE_VOXEL_FACES; face_index++) {
+            size_t neighbour_region_index;
+            neighbour_voxels[face_index] = get_generated_region_neighbour_index(region_index, face_index, &neighbour_region_index) ? &voxels[i][1 + face_index] : NULL;
+        }
+
+        region_cpu_mesh_info_t mesh_info;
+        mesh_region_on_cpu(&voxels[i][0], neighbour_voxels, cpu_faces, &mesh_info);
+
+        size_t num_gpu_faces;
+        bool is_mesh_equal = split_region_faces(num_region_faces, &readback_faces[first_readback_face], &num_gpu_faces, gpu_faces) && are_region_faces_equal(mesh_info.num_faces, cpu_faces, num_gpu_faces, gpu_faces);
+
+        verification->num_verified_regions++;
+        if (!is_mesh_equal) {
+            verification->num_mismatched_regions++;
+        }
+        first_readback_face += num_region_faces;
+    }
+
+    vmaUnmapMemory(allocator, readback_buffer_allocation);
+    vmaDestroyBuffer(allocator, readback_buffer, readback_buffer_allocation);
+
+    return result_success;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "result.h"
+#include <stddef.h>
+#include <vulkan/vulkan.h>
+
+// Regions checked per call, each needs its own and its neighbours' voxels generated on the CPU
+#define MAX_NUM_VERIFIED_REGION_MESHES 8
+
+typedef struct {
+    size_t num_verified_regions;
+    size_t num_mismatched_regions;
+} region_mesh_verification_t;
+
+// Reads the faces of meshed regions back and compares them with the CPU mesher's faces for the same voxels, merged faces are split up first
+// Only full detail regions without seams are checked since the CPU mesher doesn't downsample, every region must have finished meshing
+// The voxels are generated again on the CPU, so with GPU generation a mismatch can also mean the shader's noise broke from the CPU's bits
+result_t verify_region_meshes(VkCommandBuffer command_buffer, VkFence command_fence, region_mesh_verification_t* verification);
@@ -1,13 +1,21 @@
 #include "region_meshing_compute_pipeline.h"
+#include "chrono.h"
 #include "gfx/default.h"
 #include "gfx/gfx.h"
 #include "gfx/gfx_util.h"
-#include "gfx/pipeline.h"
+#include "gfx/gpu_profiler.h"
+#include "gfx/region_generation_compute_pipeline.h"
+#include "gfx/upload.h"
 #include "result.h"
 #include "util.h"
 #include "voxel/region.h"
+#include "voxel/region_cpu_meshing.h"
+#include "voxel/region_culling.h"
 #include "voxel/region_management.h"
+#include "voxel/region_voxels.h"
 #include "voxel/voxel.h"
+#include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,32 +23,165 @@
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
 
-#define NUM_STAGINGS 8
+// Batches in flight, so one batch's face counts can be read back while the next is being counted
+#define NUM_BATCHES 2
+#define NUM_BATCH_STAGINGS 64
+#define NUM_STAGINGS (NUM_BATCHES * NUM_BATCH_STAGINGS)
 
-static pipeline_t pipeline;
-static VkDescriptorSetLayout descriptor_set_layout;
+// The naive mesher has one meshing cell per 4x4x4 workgroup, the greedy mesher one per slice
+#define MAX_NUM_MESHING_CELLS ((REGION_SIZE / 4) * (REGION_SIZE / 4) * (REGION_SIZE / 4))
 
-static VkBuffer vertex_count_buffer;
-static VmaAllocation vertex_count_buffer_allocation;
+// The coarsest level of detail still fills a naive meshing workgroup
+static_assert((REGION_SIZE >> (NUM_REGION_LODS - 1)) >= 4);
 
-static VkBuffer vertex_staging_buffer;
-static VmaAllocation vertex_staging_buffer_allocation;
+// Regions the CPU meshes before flushing their faces, a batch of the largest meshes fits the upload staging memory even with one more skipped at the end of its ring
+#define NUM_CPU_BATCH_REGIONS 8
+#define MAX_NUM_CPU_BATCHES_PER_UPDATE 4
 
+static_assert((NUM_CPU_BATCH_REGIONS + 1) * MAX_NUM_REGION_CPU_MESHING_FACES * sizeof(region_face_t) <= UPLOAD_STAGING_BUFFER_SIZE);
+
+typedef struct {
+    uint32_t neighbour_mask;
+    uint32_t first_face;
+    uint32_t lod;
+    uint32_t seam_mask;
+} push_constants_t;
+
+typedef struct {
+    uint32_t num_cells;
+} scan_push_constants_t;
+
+// Matches mesh_info_t in region_meshing.glsl
+typedef struct {
+    uint32_t num_faces;
+    uint32_t box_min[3];
+    uint32_t box_max[3];
+} mesh_info_t;
+
+static VkPipelineLayout pipeline_layout;
+static VkPipeline count_pipelines[NUM_GPU_REGION_MESHING_MODES];
+static VkPipeline write_pipelines[NUM_GPU_REGION_MESHING_MODES];
+
+static VkPipelineLayout scan_pipeline_layout;
+static VkPipeline scan_pipeline;
+
+static VkDescriptorSetLayout staging_descriptor_set_layout;
+
+static VkBuffer face_offsets_buffer;
+static VmaAllocation face_offsets_buffer_allocation;
+
+static VkBuffer mesh_info_buffer;
+static VmaAllocation mesh_info_buffer_allocation;
+
+// Batch i uses the stagings from i * NUM_BATCH_STAGINGS on
 static VkDescriptorSet staging_descriptor_sets[NUM_STAGINGS];
 
+typedef enum {
+    batch_state_idle,
+    // Waiting for the count and scan passes before the face counts are read back
+    batch_state_counting,
+    // Waiting for the write pass, the batch's regions are already drawable since later submissions are ordered after it
+    batch_state_writing
+} batch_state_t;
+
+typedef struct {
+    batch_state_t state;
+    // Value of the timeline semaphore once the batch's last submission has finished
+    uint64_t semaphore_value;
+    VkCommandBuffer command_buffer;
+    size_t region_indices[NUM_BATCH_STAGINGS];
+    uint32_t neighbour_masks[NUM_BATCH_STAGINGS];
+    uint32_t seam_masks[NUM_BATCH_STAGINGS];
+    size_t num_regions;
+    // The batch's regions and the neighbours whose voxel images their descriptor sets bind
+    size_t bound_region_indices[NUM_BATCH_STAGINGS * (1 + NUM_CUBE_VOXEL_FACES)];
+    size_t num_bound_regions;
+    region_meshing_mode_t meshing_mode;
+    microseconds_t start;
+} batch_t;
+
+static batch_t batches[NUM_BATCHES];
+
+static VkCommandPool command_pool;
+static uint64_t semaphore_value;
+// Latest value seen on the timeline semaphore, only ever behind the GPU
+static uint64_t reached_semaphore_value;
+// Value of the timeline semaphore once no submitted batch reads the region's descriptor set or voxel image anymore
+static uint64_t region_semaphore_values[NUM_REGIONS];
+
 VkDescriptorSetLayout region_meshing_compute_pipeline_set_layout;
+VkDescriptorSetLayout region_meshing_compute_pipeline_face_set_layout;
 VkSampler voxel_sampler;
+VkSemaphore region_meshing_semaphore;
+uint64_t region_meshing_drawable_semaphore_value;
 
 static VkDescriptorPool descriptor_pool;
 
-static size_t vertex_count_stride;
-static size_t vertex_staging_stride;
+static region_face_t cpu_batch_faces[NUM_CPU_BATCH_REGIONS][MAX_NUM_REGION_CPU_MESHING_FACES];
+// Stand in for uniform regions on the CPU, which may have nothing in staging memory
+static region_voxels_t uniform_region_voxels[NUM_VOXEL_TYPES];
+// Upload semaphore value once the faces meshed on the CPU so far are in the face buffer
+static uint64_t cpu_upload_semaphore_value;
+
+static size_t face_offsets_stride;
+static size_t mesh_info_stride;
+
+static uint32_t get_num_meshing_cells(region_meshing_mode_t meshing_mode, uint32_t lod) {
+    uint32_t num_workgroups = (REGION_SIZE / 4) >> lod;
+    switch (meshing_mode) {
+        case region_meshing_mode_naive: return num_workgroups * num_workgroups * num_workgroups;
+        case region_meshing_mode_greedy: return NUM_CUBE_VOXEL_FACES * REGION_SIZE;
+        case region_meshing_mode_cpu: break;
+    }
+    return 0;
+}
 
-result_t init_region_meshing_compute_pipeline(const VkPhysicalDeviceProperties* physical_device_properties) {
+static void dispatch_meshing(VkCommandBuffer command_buffer, region_meshing_mode_t meshing_mode, uint32_t lod) {
+    uint32_t num_workgroups = (REGION_SIZE / 4) >> lod;
+    switch (meshing_mode) {
+        case region_meshing_mode_naive:
+            vkCmdDispatch(command_buffer, num_workgroups, num_workgroups, num_workgroups);
+            break;
+        case region_meshing_mode_greedy:
+            vkCmdDispatch(command_buffer, NUM_CUBE_VOXEL_FACES, 1, 1);
+            break;
+        case region_meshing_mode_cpu: break;
+    }
+}
+
+result_t init_region_meshing_compute_pipeline(const VkPhysicalDeviceProperties* physical_device_properties, uint32_t queue_family_index) {
     result_t result;
 
-    vertex_count_stride = ceil_to_next_multiple(sizeof(uint32_t), (uint32_t) physical_device_properties->limits.minStorageBufferOffsetAlignment);
-    vertex_staging_stride = ceil_to_next_multiple(NUM_CUBE_VOXEL_VERTICES * REGION_SIZE * REGION_SIZE * REGION_SIZE * sizeof(region_vertex_t), (uint32_t) physical_device_properties->limits.minStorageBufferOffsetAlignment);
+    if (vkCreateCommandPool(device, &(VkCommandPoolCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queue_family_index
+    }, NULL, &command_pool) != VK_SUCCESS) {
+        return result_command_pool_create_failure;
+    }
+
+    for (size_t i = 0; i < NUM_BATCHES; i++) {
+        if (vkAllocateCommandBuffers(device, &(VkCommandBufferAllocateInfo) {
+            DEFAULT_VK_COMMAND_BUFFER,
+            .commandPool = command_pool
+        }, &batches[i].command_buffer) != VK_SUCCESS) {
+            return result_command_buffers_allocate_failure;
+        }
+    }
+
+    if (vkCreateSemaphore(device, &(VkSemaphoreCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &(VkSemaphoreTypeCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0
+        }
+    }, NULL, &region_meshing_semaphore) != VK_SUCCESS) {
+        return result_synchronization_primitive_create_failure;
+    }
+
+    face_offsets_stride = ceil_to_next_multiple(MAX_NUM_MESHING_CELLS * sizeof(uint32_t), (uint32_t) physical_device_properties->limits.minStorageBufferOffsetAlignment);
+    mesh_info_stride = ceil_to_next_multiple(sizeof(mesh_info_t), (uint32_t) physical_device_properties->limits.minStorageBufferOffsetAlignment);
 
     if (vkCreateDescriptorPool(device, &(VkDescriptorPoolCreateInfo) {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
@@ -48,7 +189,7 @@ result_t init_region_meshing_compute_pipeline(const VkPhysicalDeviceProperties*
         .pPoolSizes = (VkDescriptorPoolSize[1]) {
             {
                 .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                .descriptorCount = 1
+                .descriptorCount = NUM_STAGINGS * 2
             }
         },
         .maxSets = NUM_STAGINGS
@@ -67,33 +208,28 @@ result_t init_region_meshing_compute_pipeline(const VkPhysicalDeviceProperties*
         .minFilter = VK_FILTER_NEAREST,
         .magFilter = VK_FILTER_NEAREST,
         .anisotropyEnable = VK_FALSE,
-        .maxLod = 0.0f
+        .maxLod = (float) (NUM_REGION_LODS - 1)
     }, NULL, &voxel_sampler) != VK_SUCCESS) {
         return result_sampler_create_failure;
     }
 
-    // TODO: Stop using unperformant shared read for this buffer, instead create a device side buffer and transfer it over for reading at the end of the compute pipeline
     if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
         DEFAULT_VK_BUFFER,
-        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        .size = NUM_STAGINGS * vertex_count_stride
-    }, &shared_read_allocation_create_info, &vertex_count_buffer, &vertex_count_buffer_allocation, NULL) != VK_SUCCESS) {
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .size = NUM_STAGINGS * face_offsets_stride
+    }, &device_allocation_create_info, &face_offsets_buffer, &face_offsets_buffer_allocation, NULL) != VK_SUCCESS) {
         return result_buffer_create_failure;
     }
 
+    // TODO: Stop using unperformant shared read for this buffer, instead create a device side buffer and transfer it over for reading at the end of the compute pipeline
     if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
         DEFAULT_VK_BUFFER,
-        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        .size = NUM_STAGINGS * vertex_staging_stride
-    }, &device_allocation_create_info, &vertex_staging_buffer, &vertex_staging_buffer_allocation, NULL) != VK_SUCCESS) {
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .size = NUM_STAGINGS * mesh_info_stride
+    }, &shared_read_allocation_create_info, &mesh_info_buffer, &mesh_info_buffer_allocation, NULL) != VK_SUCCESS) {
         return result_buffer_create_failure;
     }
 
-    VkShaderModule shader_module;
-    if ((result = create_shader_module("shader/region_meshing.spv", &shader_module)) != result_success) {
-        return result;
-    }
-
     if (vkCreateDescriptorSetLayout(device, &(VkDescriptorSetLayoutCreateInfo) {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
         .bindingCount = 2,
@@ -111,7 +247,20 @@ result_t init_region_meshing_compute_pipeline(const VkPhysicalDeviceProperties*
                 .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
             }
         }
-    }, NULL, &descriptor_set_layout) != VK_SUCCESS) {
+    }, NULL, &staging_descriptor_set_layout) != VK_SUCCESS) {
+        return result_descriptor_set_layout_create_failure;
+    }
+
+    if (vkCreateDescriptorSetLayout(device, &(VkDescriptorSetLayoutCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &(VkDescriptorSetLayoutBinding) {
+            DEFAULT_VK_DESCRIPTOR_BINDING,
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
+        }
+    }, NULL, &region_meshing_compute_pipeline_face_set_layout) != VK_SUCCESS) {
         return result_descriptor_set_layout_create_failure;
     }
 
@@ -120,7 +269,7 @@ result_t init_region_meshing_compute_pipeline(const VkPhysicalDeviceProperties*
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
             .descriptorPool = descriptor_pool,
             .descriptorSetCount = 1,
-            .pSetLayouts = &descriptor_set_layout
+            .pSetLayouts = &staging_descriptor_set_layout
         }, &staging_descriptor_sets[i]) != VK_SUCCESS) {
             return result_descriptor_sets_allocate_failure;
         }
@@ -134,9 +283,9 @@ result_t init_region_meshing_compute_pipeline(const VkPhysicalDeviceProperties*
                 .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                 .descriptorCount = 1,
                 .pBufferInfo = &(VkDescriptorBufferInfo) {
-                    .buffer = vertex_count_buffer,
-                    .offset = vertex_count_stride * i,
-                    .range = vertex_count_stride
+                    .buffer = face_offsets_buffer,
+                    .offset = face_offsets_stride * i,
+                    .range = face_offsets_stride
                 }
             },
             {
@@ -147,9 +296,9 @@ result_t init_region_meshing_compute_pipeline(const VkPhysicalDeviceProperties*
                 .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                 .descriptorCount = 1,
                 .pBufferInfo = &(VkDescriptorBufferInfo) {
-                    .buffer = vertex_staging_buffer,
-                    .offset = vertex_staging_stride * i,
-                    .range = vertex_staging_stride
+                    .buffer = mesh_info_buffer,
+                    .offset = mesh_info_stride * i,
+                    .range = mesh_info_stride
                 }
             }
         }, 0, NULL);
@@ -163,6 +312,7 @@ result_t init_region_meshing_compute_pipeline(const VkPhysicalDeviceProperties*
                 DEFAULT_VK_DESCRIPTOR_BINDING,
                 .binding = 0,
                 .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = NUM_REGION_MESHING_VOXEL_SAMPLERS,
                 .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT
             }
         }
@@ -170,157 +320,599 @@ result_t init_region_meshing_compute_pipeline(const VkPhysicalDeviceProperties*
         return result_descriptor_set_layout_create_failure;
     }
 
+    // The count passes only use the first two sets
     if (vkCreatePipelineLayout(device, &(VkPipelineLayoutCreateInfo) {
         DEFAULT_VK_PIPELINE_LAYOUT,
-        .setLayoutCount = 2,
-        .pSetLayouts = (VkDescriptorSetLayout[2]) {
-            descriptor_set_layout,
-            region_meshing_compute_pipeline_set_layout
+        .setLayoutCount = 3,
+        .pSetLayouts = (VkDescriptorSetLayout[3]) {
+            staging_descriptor_set_layout,
+            region_meshing_compute_pipeline_set_layout,
+            region_meshing_compute_pipeline_face_set_layout
         },
-    }, NULL, &pipeline.pipeline_layout) != VK_SUCCESS) {
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &(VkPushConstantRange) {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .size = sizeof(push_constants_t)
+        }
+    }, NULL, &pipeline_layout) != VK_SUCCESS) {
+        return result_pipeline_layout_create_failure;
+    }
+
+    if (vkCreatePipelineLayout(device, &(VkPipelineLayoutCreateInfo) {
+        DEFAULT_VK_PIPELINE_LAYOUT,
+        .setLayoutCount = 1,
+        .pSetLayouts = &staging_descriptor_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &(VkPushConstantRange) {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .size = sizeof(scan_push_constants_t)
+        }
+    }, NULL, &scan_pipeline_layout) != VK_SUCCESS) {
         return result_pipeline_layout_create_failure;
     }
 
+    // Indexed by region_meshing_mode_t, count pipelines first and write pipelines second
+    const char* shader_paths[NUM_GPU_REGION_MESHING_MODES * 2] = {
+        "shader/region_naive_meshing_count.spv",
+        "shader/region_greedy_meshing_count.spv",
+        "shader/region_naive_meshing_write.spv",
+        "shader/region_greedy_meshing_write.spv"
+    };
+
+    VkShaderModule shader_modules[NUM_GPU_REGION_MESHING_MODES * 2];
+    VkComputePipelineCreateInfo pipeline_create_infos[NUM_GPU_REGION_MESHING_MODES * 2];
+    for (size_t i = 0; i < NUM_GPU_REGION_MESHING_MODES * 2; i++) {
+        if ((result = create_shader_module(shader_paths[i], &shader_modules[i])) != result_success) {
+            return result;
+        }
+
+        pipeline_create_infos[i] = (VkComputePipelineCreateInfo) {
+            DEFAULT_VK_COMPUTE_PIPELINE,
+            .stage = {
+                DEFAULT_VK_SHADER_STAGE,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shader_modules[i]
+            },
+            .layout = pipeline_layout
+        };
+    }
+
+    VkPipeline pipelines[NUM_GPU_REGION_MESHING_MODES * 2];
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, NUM_GPU_REGION_MESHING_MODES * 2, pipeline_create_infos, NULL, pipelines) != VK_SUCCESS) {
+        return result_compute_pipelines_create_failure;
+    }
+    memcpy(count_pipelines, pipelines, sizeof(count_pipelines));
+    memcpy(write_pipelines, &pipelines[NUM_GPU_REGION_MESHING_MODES], sizeof(write_pipelines));
+
+    for (size_t i = 0; i < NUM_GPU_REGION_MESHING_MODES * 2; i++) {
+        vkDestroyShaderModule(device, shader_modules[i], NULL);
+    }
+
+    VkShaderModule scan_shader_module;
+    if ((result = create_shader_module("shader/region_meshing_scan.spv", &scan_shader_module)) != result_success) {
+        return result;
+    }
+
     if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &(VkComputePipelineCreateInfo) {
         DEFAULT_VK_COMPUTE_PIPELINE,
         .stage = {
             DEFAULT_VK_SHADER_STAGE,
             .stage = VK_SHADER_STAGE_COMPUTE_BIT,
-            .module = shader_module
+            .module = scan_shader_module
         },
-        .layout = pipeline.pipeline_layout
-    }, NULL, &pipeline.pipeline) != VK_SUCCESS) {
+        .layout = scan_pipeline_layout
+    }, NULL, &scan_pipeline) != VK_SUCCESS) {
         return result_compute_pipelines_create_failure;
     }
 
-    vkDestroyShaderModule(device, shader_module, NULL);
+    vkDestroyShaderModule(device, scan_shader_module, NULL);
+
+    for (uint32_t voxel_type = 0; voxel_type < NUM_VOXEL_TYPES; voxel_type++) {
+        memset(uniform_region_voxels[voxel_type].types, (int) voxel_type, sizeof(uniform_region_voxels[voxel_type].types));
+    }
+
+    return result_success;
+}
+
+static result_t submit_batch(batch_t* batch) {
+    semaphore_value++;
+    batch->semaphore_value = semaphore_value;
+
+    if (vkQueueSubmit(compute_queue, 1, &(VkSubmitInfo) {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &(VkTimelineSemaphoreSubmitInfo) {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &batch->semaphore_value
+        },
+        .commandBufferCount = 1,
+        .pCommandBuffers = &batch->command_buffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &region_meshing_semaphore
+    }, VK_NULL_HANDLE) != VK_SUCCESS) {
+        return result_queue_submit_failure;
+    }
+
+    for (size_t i = 0; i < batch->num_bound_regions; i++) {
+        region_semaphore_values[batch->bound_region_indices[i]] = batch->semaphore_value;
+    }
 
     return result_success;
 }
 
-result_t record_region_meshing_compute_pipeline(VkCommandBuffer command_buffer) {
-    if (vkBeginCommandBuffer(command_buffer, &(VkCommandBufferBeginInfo) {
+bool is_region_in_meshing_batch(size_t region_index) {
+    return region_semaphore_values[region_index] > reached_semaphore_value;
+}
+
+// The other batch may still have the region's descriptor set bound, so it's only rewritten once that batch has finished
+static bool can_region_join_batch(size_t region_index) {
+    return region_mesh_states[region_index] == region_mesh_state_await_meshing_compute && !is_region_in_meshing_batch(region_index);
+}
+
+static result_t begin_batch_command_buffer(batch_t* batch) {
+    if (vkResetCommandBuffer(batch->command_buffer, 0) != VK_SUCCESS) {
+        return result_command_buffer_reset_failure;
+    }
+
+    if (vkBeginCommandBuffer(batch->command_buffer, &(VkCommandBufferBeginInfo) {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
     }) != VK_SUCCESS) {
         return result_command_buffer_begin_failure;
     }
 
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
-    
-    size_t staging_index = 0;
+    return result_success;
+}
+
+static result_t start_batch_counting(size_t batch_index, region_meshing_mode_t meshing_mode) {
+    result_t result;
+
+    batch_t* batch = &batches[batch_index];
+    VkCommandBuffer command_buffer = batch->command_buffer;
+    const VkDescriptorSet* batch_staging_descriptor_sets = &staging_descriptor_sets[batch_index * NUM_BATCH_STAGINGS];
+    size_t first_staging_index = batch_index * NUM_BATCH_STAGINGS;
+
+    if ((result = begin_batch_command_buffer(batch)) != result_success) {
+        return result;
+    }
+
+    batch->meshing_mode = meshing_mode;
+    batch->num_regions = 0;
+    batch->num_bound_regions = 0;
+
     for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
-        if (staging_index == NUM_STAGINGS) {
+        if (batch->num_regions == NUM_BATCH_STAGINGS) {
             break;
         }
 
-        if (region_mesh_states[region_index] != region_mesh_state_await_meshing_compute) {
+        if (!can_region_join_batch(region_index)) {
             continue;
         }
-        region_mesh_states[region_index] = region_mesh_state_await_vertex_buffer_creation;
-        
-        // Clear the vertex count buffer since it is reused
-        vkCmdFillBuffer(command_buffer, vertex_count_buffer, vertex_count_stride * staging_index, vertex_count_stride, 0);
-        
-        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline_layout, 0, 2, (VkDescriptorSet[2]) { staging_descriptor_sets[staging_index], region_meshing_compute_pipeline_infos[region_index].descriptor_set }, 0, NULL);
+        region_mesh_states[region_index] = region_mesh_state_await_face_buffer_creation;
+        batch->bound_region_indices[batch->num_bound_regions++] = region_index;
+
+        const region_meshing_compute_pipeline_info_t* info = &region_meshing_compute_pipeline_infos[region_index];
+
+        // Missing neighbours keep the region's own image bound, the shader clamps instead of reading them
+        // Uniform neighbours look the same at every level of detail, so only the others can leave cracks along the border
+        uint8_t lod = region_lods[region_index];
+        uint32_t neighbour_mask = 0;
+        uint32_t seam_mask = 0;
+        VkDescriptorImageInfo voxel_image_infos[NUM_REGION_MESHING_VOXEL_SAMPLERS];
+        for (size_t i = 0; i < NUM_REGION_MESHING_VOXEL_SAMPLERS; i++) {
+            voxel_image_infos[i] = (VkDescriptorImageInfo) {
+                .sampler = voxel_sampler,
+                .imageView = info->voxel_image_view,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            };
+        }
+        for (uint32_t face_index = 0; face_index < NUM_CUBE_VOXEL_FACES; face_index++) {
+            size_t neighbour_region_index;
+            if (!get_generated_region_neighbour_index(region_index, face_index, &neighbour_region_index)) {
+                continue;
+            }
+            if (region_lods[neighbour_region_index] != lod && region_uniform_voxel_types[neighbour_region_index] == NULL_UINT8) {
+                seam_mask |= 1u << face_index;
+                continue;
+            }
+            neighbour_mask |= 1u << face_index;
+            voxel_image_infos[1 + face_index].imageView = region_meshing_compute_pipeline_infos[neighbour_region_index].voxel_image_view;
+            batch->bound_region_indices[batch->num_bound_regions++] = neighbour_region_index;
+        }
+
+        vkUpdateDescriptorSets(device, 1, &(VkWriteDescriptorSet) {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = info->descriptor_set,
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = NUM_REGION_MESHING_VOXEL_SAMPLERS,
+            .pImageInfo = voxel_image_infos
+        }, 0, NULL);
+
+        batch->region_indices[batch->num_regions] = region_index;
+        batch->neighbour_masks[batch->num_regions] = neighbour_mask;
+        batch->seam_masks[batch->num_regions] = seam_mask;
+        batch->num_regions++;
+    }
+
+    uint32_t profile_scope_index = begin_gpu_profile(command_buffer, gpu_profile_pass_meshing_count);
+
+    // The count pass shrinks an empty box to the bounds of the voxels with visible faces
+    for (size_t i = 0; i < batch->num_regions; i++) {
+        VkDeviceSize mesh_info_offset = mesh_info_stride * (first_staging_index + i);
+        vkCmdFillBuffer(command_buffer, mesh_info_buffer, mesh_info_offset + offsetof(mesh_info_t, box_min), sizeof(((mesh_info_t*) NULL)->box_min), UINT32_MAX);
+        vkCmdFillBuffer(command_buffer, mesh_info_buffer, mesh_info_offset + offsetof(mesh_info_t, box_max), sizeof(((mesh_info_t*) NULL)->box_max), 0);
+    }
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &(VkMemoryBarrier) {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    }, 0, NULL, 0, NULL);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, count_pipelines[meshing_mode]);
 
-        vkCmdDispatch(command_buffer, 8, 8, 8);
+    for (size_t i = 0; i < batch->num_regions; i++) {
+        size_t region_index = batch->region_indices[i];
+        vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_t), &(push_constants_t) {
+            .neighbour_mask = batch->neighbour_masks[i],
+            .lod = region_lods[region_index],
+            .seam_mask = batch->seam_masks[i]
+        });
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 2, (VkDescriptorSet[2]) { batch_staging_descriptor_sets[i], region_meshing_compute_pipeline_infos[region_index].descriptor_set }, 0, NULL);
+        dispatch_meshing(command_buffer, meshing_mode, region_lods[region_index]);
+    }
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &(VkMemoryBarrier) {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    }, 0, NULL, 0, NULL);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, scan_pipeline);
 
-        staging_index++;
+    for (size_t i = 0; i < batch->num_regions; i++) {
+        vkCmdPushConstants(command_buffer, scan_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(scan_push_constants_t), &(scan_push_constants_t) {
+            .num_cells = get_num_meshing_cells(meshing_mode, region_lods[batch->region_indices[i]])
+        });
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, scan_pipeline_layout, 0, 1, &batch_staging_descriptor_sets[i], 0, NULL);
+        vkCmdDispatch(command_buffer, 1, 1, 1);
     }
 
+    // Face totals are read back on the host, face offsets are read by the write pass
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &(VkMemoryBarrier) {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT
+    }, 0, NULL, 0, NULL);
+
+    end_gpu_profile(command_buffer, profile_scope_index);
+
     if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
         return result_command_buffer_end_failure;
     }
 
+    if ((result = submit_batch(batch)) != result_success) {
+        return result;
+    }
+
+    batch->state = batch_state_counting;
+    batch->start = get_current_microseconds();
+
     return result_success;
 }
 
-result_t create_vertex_buffers_for_awaiting_regions(VkCommandBuffer command_buffer, VkFence command_fence) {
+// Cube vertices span from -1 to 0 on the Z axis and bounds are in voxels of the region's level of detail, see region_vertex.vert
+static void set_region_mesh_culling_box(size_t region_index, const uint32_t mesh_box_min[3], const uint32_t mesh_box_max[3]) {
+    ivec3s region_position = region_positions[region_index];
+    float voxel_scale = (float) (1u << region_lods[region_index]);
+    vec3s box_min;
+    vec3s box_max;
+    for (size_t axis = 0; axis < 3; axis++) {
+        float region_offset = (float) ((int32_t) REGION_SIZE * region_position.raw[axis]) - (axis == 2 ? 1.0f : 0.0f);
+        box_min.raw[axis] = region_offset + voxel_scale * (float) mesh_box_min[axis];
+        box_max.raw[axis] = region_offset + voxel_scale * (float) (mesh_box_max[axis] + 1);
+    }
+    set_region_culling_box(region_index, box_min, box_max);
+}
+
+// The batch's counting submission must have finished
+static result_t start_batch_writing(size_t batch_index) {
     result_t result;
 
-    uint32_t num_vertices_array[NUM_STAGINGS];
+    batch_t* batch = &batches[batch_index];
+    VkCommandBuffer command_buffer = batch->command_buffer;
+    const VkDescriptorSet* batch_staging_descriptor_sets = &staging_descriptor_sets[batch_index * NUM_BATCH_STAGINGS];
+    size_t first_staging_index = batch_index * NUM_BATCH_STAGINGS;
+
+    printf("Voxel mesh counting took %ldμs\n", get_current_microseconds() - batch->start);
+
+    mesh_info_t mesh_infos[NUM_BATCH_STAGINGS];
     {
-        const uint8_t* vertex_count_buffer_mapped;
-        if (vmaMapMemory(allocator, vertex_count_buffer_allocation, (void**) &vertex_count_buffer_mapped) != VK_SUCCESS) {
+        const uint8_t* mesh_info_buffer_mapped;
+        if (vmaMapMemory(allocator, mesh_info_buffer_allocation, (void**) &mesh_info_buffer_mapped) != VK_SUCCESS) {
             return result_memory_map_failure;
         }
 
-        for (size_t i = 0; i < NUM_STAGINGS; i++) {
-            num_vertices_array[i] = *(const uint32_t*) &vertex_count_buffer_mapped[vertex_count_stride * i];
+        for (size_t i = 0; i < batch->num_regions; i++) {
+            memcpy(&mesh_infos[i], &mesh_info_buffer_mapped[mesh_info_stride * (first_staging_index + i)], sizeof(mesh_info_t));
         }
 
-        vmaUnmapMemory(allocator, vertex_count_buffer_allocation);
+        vmaUnmapMemory(allocator, mesh_info_buffer_allocation);
     }
 
-    for (size_t i = 0; i < NUM_STAGINGS; i++) {
-        printf("Voxel mesh vertices %ld: %d\n", i, num_vertices_array[i]);
+    if ((result = begin_batch_command_buffer(batch)) != result_success) {
+        return result;
     }
 
-    if (vkBeginCommandBuffer(command_buffer, &(VkCommandBufferBeginInfo) {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
-    }) != VK_SUCCESS) {
-        return result_command_buffer_begin_failure;
-    }
+    uint32_t profile_scope_index = begin_gpu_profile(command_buffer, gpu_profile_pass_meshing_write);
 
-    size_t staging_index = 0;
-    for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
-        if (staging_index == NUM_STAGINGS) {
-            break;
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, write_pipelines[batch->meshing_mode]);
+
+    for (size_t i = 0; i < batch->num_regions; i++) {
+        size_t region_index = batch->region_indices[i];
+        region_mesh_states[region_index] = region_mesh_state_completed;
+
+        const mesh_info_t* mesh_info = &mesh_infos[i];
+        uint32_t num_faces = mesh_info->num_faces;
+
+        if ((result = allocate_region_faces(region_index, num_faces)) != result_success) {
+            return result;
         }
 
-        if (region_mesh_states[region_index] != region_mesh_state_await_vertex_buffer_creation) {
+        // Regions without any visible faces are simply not drawn
+        if (num_faces == 0) {
             continue;
         }
-        region_mesh_states[region_index] = region_mesh_state_completed;
-        
-        uint32_t num_vertices = num_vertices_array[staging_index];
-
-        region_allocation_info_t* allocation_info = &region_allocation_infos[region_index];
-        
-        if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
-            DEFAULT_VK_VERTEX_BUFFER,
-            .size = num_vertices * sizeof(region_vertex_t)
-        }, &device_allocation_create_info, &allocation_info->vertex_buffer, &allocation_info->vertex_buffer_allocation, NULL) != VK_SUCCESS) {
-            return result_buffer_create_failure;
-        }
 
-        vkCmdCopyBuffer(command_buffer, vertex_staging_buffer, allocation_info->vertex_buffer, 1, &(VkBufferCopy) {
-            .srcOffset = NUM_CUBE_VOXEL_VERTICES * REGION_SIZE * REGION_SIZE * REGION_SIZE * sizeof(region_vertex_t) * staging_index,
-            .size = num_vertices * sizeof(region_vertex_t)
-        });
+        uint32_t lod = region_lods[region_index];
+        set_region_mesh_culling_box(region_index, mesh_info->box_min, mesh_info->box_max);
 
-        region_render_pipeline_infos[region_index].vertex_buffer = allocation_info->vertex_buffer;
+        vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants_t), &(push_constants_t) {
+            .neighbour_mask = batch->neighbour_masks[i],
+            .first_face = region_render_pipeline_infos[region_index].first_face,
+            .lod = lod,
+            .seam_mask = batch->seam_masks[i]
+        });
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 3, (VkDescriptorSet[3]) { batch_staging_descriptor_sets[i], region_meshing_compute_pipeline_infos[region_index].descriptor_set, region_meshing_compute_pipeline_face_descriptor_set }, 0, NULL);
+        dispatch_meshing(command_buffer, batch->meshing_mode, lod);
+    }
 
-        region_render_pipeline_info_t* render_pipeline_info = &region_render_pipeline_infos[region_index];
-        render_pipeline_info->num_vertices = num_vertices;
-        render_pipeline_info->vertex_buffer = allocation_info->vertex_buffer;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &(VkMemoryBarrier) {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+    }, 0, NULL, 0, NULL);
 
-        staging_index++;
-    }
+    end_gpu_profile(command_buffer, profile_scope_index);
 
     if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
         return result_command_buffer_end_failure;
     }
 
-    if ((result = submit_and_wait(command_buffer, command_fence)) != result_success) {
+    if ((result = submit_batch(batch)) != result_success) {
         return result;
     }
-    if ((result = reset_command_processing(command_buffer, command_fence)) != result_success) {
-        return result;
+
+    batch->state = batch_state_writing;
+    region_meshing_drawable_semaphore_value = batch->semaphore_value;
+    batch->start = get_current_microseconds();
+
+    region_face_buffer_stats_t stats;
+    get_region_face_buffer_stats(&stats);
+    printf("Face buffer: %.1f%% used (%lu deferred faces), %u allocations, %u free ranges, %.1f%% fragmented\n", 100.0 * (double) stats.num_used_faces / REGION_FACE_BUFFER_NUM_FACES, stats.num_deferred_free_faces, stats.num_allocations, stats.num_free_ranges, 100.0 * (double) stats.fragmentation);
+
+    return result_success;
+}
+
+// Moves the batch on if its last submission has finished
+static result_t advance_batch(size_t batch_index, uint64_t reached_semaphore_value) {
+    batch_t* batch = &batches[batch_index];
+    if (batch->state == batch_state_idle || batch->semaphore_value > reached_semaphore_value) {
+        return result_success;
+    }
+
+    switch (batch->state) {
+        case batch_state_idle: break;
+        case batch_state_counting: return start_batch_writing(batch_index);
+        case batch_state_writing:
+            printf("Voxel mesh writing took %ldμs\n", get_current_microseconds() - batch->start);
+            batch->state = batch_state_idle;
+            break;
+    }
+
+    return result_success;
+}
+
+static const region_voxels_t* get_cpu_region_voxels(size_t region_index) {
+    uint8_t uniform_voxel_type = region_uniform_voxel_types[region_index];
+    return uniform_voxel_type != NULL_UINT8 ? &uniform_region_voxels[uniform_voxel_type] : get_region_staging_voxels(region_index);
+}
+
+// Every batch is meshed on the job workers and its faces are flushed before the next one, its regions are completed right away
+static result_t mesh_cpu_batches(void) {
+    result_t result;
+
+    size_t next_region_index = 0;
+    for (size_t batch_index = 0; batch_index < MAX_NUM_CPU_BATCHES_PER_UPDATE; batch_index++) {
+        size_t num_regions = 0;
+        size_t region_indices[NUM_CPU_BATCH_REGIONS];
+        const region_voxels_t* voxels[NUM_CPU_BATCH_REGIONS];
+        const region_voxels_t* neighbour_voxels[NUM_CPU_BATCH_REGIONS][NUM_CUBE_VOXEL_FACES];
+        region_face_t* faces[NUM_CPU_BATCH_REGIONS];
+        for (; next_region_index < NUM_REGIONS && num_regions < NUM_CPU_BATCH_REGIONS; next_region_index++) {
+            if (region_mesh_states[next_region_index] != region_mesh_state_await_meshing_compute) {
+                continue;
+            }
+
+            region_indices[num_regions] = next_region_index;
+            voxels[num_regions] = get_cpu_region_voxels(next_region_index);
+            for (uint32_t face_index = 0; face_index < NUM_CUBE_VOXEL_FACES; face_index++) {
+                size_t neighbour_region_index;
+                neighbour_voxels[num_regions][face_index] = get_generated_region_neighbour_index(next_region_index, face_index, &neighbour_region_index) ? get_cpu_region_voxels(neighbour_region_index) : NULL;
+            }
+            faces[num_regions] = cpu_batch_faces[num_regions];
+            num_regions++;
+        }
+
+        if (num_regions == 0) {
+            break;
+        }
+
+        microseconds_t start = get_current_microseconds();
+
+        region_cpu_mesh_info_t mesh_infos[NUM_CPU_BATCH_REGIONS];
+        mesh_regions_on_cpu(num_regions, voxels, neighbour_voxels, faces, mesh_infos);
+
+        printf("CPU voxel meshing took %ldμs\n", get_current_microseconds() - start);
+
+        for (size_t i = 0; i < num_regions; i++) {
+            size_t region_index = region_indices[i];
+            region_mesh_states[region_index] = region_mesh_state_completed;
+
+            const region_cpu_mesh_info_t* mesh_info = &mesh_infos[i];
+            uint32_t num_faces = mesh_info->num_faces;
+
+            if ((result = allocate_region_faces(region_index, num_faces)) != result_success) {
+                return result;
+            }
+
+            // Regions without any visible faces are simply not drawn
+            if (num_faces == 0) {
+                continue;
+            }
+
+            set_region_mesh_culling_box(region_index, mesh_info->box_min, mesh_info->box_max);
+
+            if ((result = queue_buffer_upload(region_face_buffer, region_render_pipeline_infos[region_index].first_face * sizeof(region_face_t), num_faces * sizeof(region_face_t), faces[i])) != result_success) {
+                return result;
+            }
+        }
+
+        // Nothing reads the newly allocated face ranges yet, so the upload doesn't wait on anything
+        if ((result = flush_uploads(VK_NULL_HANDLE, 0, &cpu_upload_semaphore_value)) != result_success) {
+            return result;
+        }
+    }
+
+    return result_success;
+}
+
+static bool has_region_for_batch(void) {
+    for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
+        if (can_region_join_batch(region_index)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+result_t update_region_meshing(region_meshing_mode_t meshing_mode) {
+    result_t result;
+
+    if (vkGetSemaphoreCounterValue(device, region_meshing_semaphore, &reached_semaphore_value) != VK_SUCCESS) {
+        return result_semaphore_counter_value_get_failure;
+    }
+
+    for (size_t batch_index = 0; batch_index < NUM_BATCHES; batch_index++) {
+        if ((result = advance_batch(batch_index, reached_semaphore_value)) != result_success) {
+            return result;
+        }
+    }
+
+    // Uniform regions without visible faces are completed without a dispatch or a face count readback
+    for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
+        if (region_mesh_states[region_index] != region_mesh_state_await_meshing_compute || !is_region_mesh_empty(region_index)) {
+            continue;
+        }
+        if ((result = allocate_region_faces(region_index, 0)) != result_success) {
+            return result;
+        }
+        region_mesh_states[region_index] = region_mesh_state_completed;
+    }
+
+    if (meshing_mode == region_meshing_mode_cpu) {
+        return mesh_cpu_batches();
+    }
+
+    for (size_t batch_index = 0; batch_index < NUM_BATCHES; batch_index++) {
+        if (batches[batch_index].state != batch_state_idle || !has_region_for_batch()) {
+            continue;
+        }
+        if ((result = start_batch_counting(batch_index, meshing_mode)) != result_success) {
+            return result;
+        }
+    }
+
+    return result_success;
+}
+
+bool is_region_meshing_idle(void) {
+    for (size_t batch_index = 0; batch_index < NUM_BATCHES; batch_index++) {
+        if (batches[batch_index].state != batch_state_idle) {
+            return false;
+        }
+    }
+    return true;
+}
+
+result_t wait_for_region_meshing(void) {
+    result_t result;
+
+    while (!is_region_meshing_idle()) {
+        uint64_t wait_semaphore_value = UINT64_MAX;
+        for (size_t batch_index = 0; batch_index < NUM_BATCHES; batch_index++) {
+            if (batches[batch_index].state != batch_state_idle && batches[batch_index].semaphore_value < wait_semaphore_value) {
+                wait_semaphore_value = batches[batch_index].semaphore_value;
+            }
+        }
+
+        if (vkWaitSemaphores(device, &(VkSemaphoreWaitInfo) {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &region_meshing_semaphore,
+            .pValues = &wait_semaphore_value
+        }, UINT64_MAX) != VK_SUCCESS) {
+            return result_semaphores_wait_failure;
+        }
+        reached_semaphore_value = wait_semaphore_value;
+
+        for (size_t batch_index = 0; batch_index < NUM_BATCHES; batch_index++) {
+            if ((result = advance_batch(batch_index, wait_semaphore_value)) != result_success) {
+                return result;
+            }
+        }
+    }
+
+    if (vkWaitSemaphores(device, &(VkSemaphoreWaitInfo) {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &upload_semaphore,
+        .pValues = &cpu_upload_semaphore_value
+    }, UINT64_MAX) != VK_SUCCESS) {
+        return result_semaphores_wait_failure;
     }
 
     return result_success;
 }
 
 void term_region_meshing_compute_pipeline(void) {
-    destroy_pipeline(&pipeline);
-    vmaDestroyBuffer(allocator, vertex_count_buffer, vertex_count_buffer_allocation);
-    vmaDestroyBuffer(allocator, vertex_staging_buffer, vertex_staging_buffer_allocation);
+    for (size_t i = 0; i < NUM_GPU_REGION_MESHING_MODES; i++) {
+        vkDestroyPipeline(device, count_pipelines[i], NULL);
+        vkDestroyPipeline(device, write_pipelines[i], NULL);
+    }
+    vkDestroyPipeline(device, scan_pipeline, NULL);
+    vkDestroyPipelineLayout(device, pipeline_layout, NULL);
+    vkDestroyPipelineLayout(device, scan_pipeline_layout, NULL);
+    vmaDestroyBuffer(allocator, face_offsets_buffer, face_offsets_buffer_allocation);
+    vmaDestroyBuffer(allocator, mesh_info_buffer, mesh_info_buffer_allocation);
 
     vkDestroyDescriptorSetLayout(device, region_meshing_compute_pipeline_set_layout, NULL);
-    vkDestroyDescriptorSetLayout(device, descriptor_set_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, staging_descriptor_set_layout, NULL);
+    vkDestroyDescriptorSetLayout(device, region_meshing_compute_pipeline_face_set_layout, NULL);
     vkDestroySampler(device, voxel_sampler, NULL);
     vkDestroyDescriptorPool(device, descriptor_pool, NULL);
-}
\ No newline at end of file
+    vkDestroySemaphore(device, region_meshing_semaphore, NULL);
+    vkDestroyCommandPool(device, command_pool, NULL);
+}
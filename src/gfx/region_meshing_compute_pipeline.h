@@ -1,24 +1,52 @@
 #pragma once
 #include "gfx/default.h"
+#include "gfx/region_face.h"
 #include "result.h"
-#include <cglm/types-struct.h>
-#include <stdalign.h>
+#include "voxel/voxel.h"
 #include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <vulkan/vulkan.h>
 
+// See region_face.h for the bit layout
 typedef struct {
-    alignas(16) vec3s vertex_position;
-    uint32_t vertex_index;
-    uint32_t voxel_type;
-} region_vertex_t;
+    uint32_t position_data;
+    uint32_t face_data;
+} region_face_t;
 
-static_assert(sizeof(region_vertex_t) % 16 == 0);
+static_assert(sizeof(region_face_t) == 8);
+
+typedef enum {
+    // Two triangles for every visible voxel face
+    region_meshing_mode_naive,
+    // Coplanar faces of the same voxel type are merged into larger quads
+    region_meshing_mode_greedy,
+    // Naive faces meshed on the job workers from the voxels CPU generation staged, then uploaded on the transfer queue, always at full detail
+    region_meshing_mode_cpu
+} region_meshing_mode_t;
+
+// The modes before region_meshing_mode_cpu each have a count and a write pipeline
+#define NUM_GPU_REGION_MESHING_MODES 2
+
+// The region's own voxel image followed by the images of its neighbours, indexed by voxel face index
+#define NUM_REGION_MESHING_VOXEL_SAMPLERS (1 + NUM_CUBE_VOXEL_FACES)
 
 extern VkDescriptorSetLayout region_meshing_compute_pipeline_set_layout;
+extern VkDescriptorSetLayout region_meshing_compute_pipeline_face_set_layout;
 extern VkSampler voxel_sampler;
+// Timeline semaphore signaled by meshing submissions on the compute queue
+extern VkSemaphore region_meshing_semaphore;
+// Frames must wait for this value before drawing, regions become drawable as soon as their write pass is submitted
+extern uint64_t region_meshing_drawable_semaphore_value;
 
-result_t init_region_meshing_compute_pipeline(const VkPhysicalDeviceProperties* physical_device_properties);
-result_t record_region_meshing_compute_pipeline(VkCommandBuffer command_buffer);
-result_t create_vertex_buffers_for_awaiting_regions(VkCommandBuffer command_buffer, VkFence command_fence);
+result_t init_region_meshing_compute_pipeline(const VkPhysicalDeviceProperties* physical_device_properties, uint32_t queue_family_index);
+// Advances finished batches and starts new ones for regions awaiting meshing without waiting on the GPU
+// CPU meshing completes its regions within the update instead, their faces are drawable once the frame's uploads are
+result_t update_region_meshing(region_meshing_mode_t meshing_mode);
+bool is_region_meshing_idle(void);
+// Whether a batch still in flight binds the region's descriptor set or voxel image, as of the last update or wait
+bool is_region_in_meshing_batch(size_t region_index);
+// Blocks until every started batch has been written and the faces meshed on the CPU have been uploaded, without starting new ones
+result_t wait_for_region_meshing(void);
 void term_region_meshing_compute_pipeline(void);
\ No newline at end of file
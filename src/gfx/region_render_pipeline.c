@@ -4,10 +4,15 @@
 #include "gfx/default.h"
 #include "gfx/pipeline.h"
 #include "gfx/gfx_util.h"
+#include "gfx/region_culling_compute_pipeline.h"
 #include "gfx/region_meshing_compute_pipeline.h"
+#include "job.h"
 #include "util.h"
 #include "result.h"
+#include "voxel/region.h"
+#include "voxel/region_culling.h"
 #include "voxel/region_management.h"
+#include "voxel/voxel.h"
 #include <cglm/types-struct.h>
 #include <math.h>
 #include <stdint.h>
@@ -39,27 +44,51 @@ typedef struct {
     mat4s view_projection;
 } push_constants_t;
 
+typedef struct {
+    const char* path;
+    const void* pixels;
+    int32_t width;
+    int32_t height;
+} color_image_layer_load_t;
+
 VkDescriptorSetLayout region_render_pipeline_set_layout;
 
+static void load_color_image_layer(void* argument) {
+    color_image_layer_load_t* load = argument;
+    load->pixels = stbi_load(load->path, &load->width, &load->height, (int[1]) { 0 }, STBI_rgb_alpha);
+}
+
 result_t init_region_render_pipeline(VkCommandBuffer command_buffer, VkFence command_fence, VkDescriptorPool descriptor_pool, const VkPhysicalDeviceProperties* physical_device_properties) {
     result_t result;
 
     uint32_t texture_size = 16;
     uint32_t num_mip_levels = ((uint32_t)floorf(log2f((float)max_uint32(texture_size, texture_size)))) + 1;
 
+    // Layers are decoded in parallel
+    color_image_layer_load_t loads[NUM_COLOR_IMAGE_LAYERS];
+    job_t jobs[NUM_COLOR_IMAGE_LAYERS];
+    for (uint32_t layer_index = 0; layer_index < NUM_COLOR_IMAGE_LAYERS; layer_index++) {
+        loads[layer_index] = (color_image_layer_load_t) { .path = color_image_layer_paths[layer_index] };
+        jobs[layer_index] = (job_t) {
+            .function = load_color_image_layer,
+            .argument = &loads[layer_index]
+        };
+    }
+
+    job_counter_t counter = { 0 };
+    run_jobs(NUM_COLOR_IMAGE_LAYERS, jobs, &counter);
+    wait_for_job_counter(&counter);
+
     const void* pixel_arrays[NUM_COLOR_IMAGE_LAYERS];
 
     for (uint32_t layer_index = 0; layer_index < NUM_COLOR_IMAGE_LAYERS; layer_index++) {
-        int32_t width;
-        int32_t height;
-
-        const void* pixels = stbi_load(color_image_layer_paths[layer_index], &width, &height, (int[1]) { 0 }, STBI_rgb_alpha);
+        const color_image_layer_load_t* load = &loads[layer_index];
 
-        if (pixels == NULL || width != height || width != (int32_t) texture_size) {
+        if (load->pixels == NULL || load->width != load->height || load->width != (int32_t) texture_size) {
             return result_file_read_failure; // TODO: Use a different error
         }
 
-        pixel_arrays[layer_index] = pixels;
+        pixel_arrays[layer_index] = load->pixels;
     }
 
     if ((result = create_image(command_buffer, command_fence, &(VkImageCreateInfo) {
@@ -93,8 +122,9 @@ result_t init_region_render_pipeline(VkCommandBuffer command_buffer, VkFence com
     if (vkCreateSampler(device, &(VkSamplerCreateInfo) {
         DEFAULT_VK_SAMPLER,
         .maxAnisotropy = physical_device_properties->limits.maxSamplerAnisotropy,
-        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        // Repeats the texture across faces merged by greedy meshing
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
         .minFilter = VK_FILTER_NEAREST,
         .magFilter = VK_FILTER_NEAREST,
         .anisotropyEnable = VK_FALSE,
@@ -152,14 +182,21 @@ result_t init_region_render_pipeline(VkCommandBuffer command_buffer, VkFence com
         }
     }, 0, NULL);
 
+    // Region infos and the shared face buffer
     if (vkCreateDescriptorSetLayout(device, &(VkDescriptorSetLayoutCreateInfo) {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .bindingCount = 1,
-        .pBindings = (VkDescriptorSetLayoutBinding[1]) {
+        .bindingCount = 2,
+        .pBindings = (VkDescriptorSetLayoutBinding[2]) {
             {
                 DEFAULT_VK_DESCRIPTOR_BINDING,
                 .binding = 0,
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+            },
+            {
+                DEFAULT_VK_DESCRIPTOR_BINDING,
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                 .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
             }
         }
@@ -200,39 +237,9 @@ result_t init_region_render_pipeline(VkCommandBuffer command_buffer, VkFence com
             }
         },
 
+        // Faces are pulled from the shared face buffer in the vertex shader
         .pVertexInputState = &(VkPipelineVertexInputStateCreateInfo) {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        
-            .vertexBindingDescriptionCount = 1,
-            .pVertexBindingDescriptions = (VkVertexInputBindingDescription[1]) {
-                {
-                    .binding = 0,
-                    .stride = sizeof(region_vertex_t),
-                    .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
-                }
-            },
-
-            .vertexAttributeDescriptionCount = 3,
-            .pVertexAttributeDescriptions = (VkVertexInputAttributeDescription[3]) {
-                {
-                    .binding = 0,
-                    .location = 0,
-                    .format = VK_FORMAT_R32G32B32_SFLOAT,
-                    .offset = offsetof(region_vertex_t, vertex_position)
-                },
-                {
-                    .binding = 0,
-                    .location = 1,
-                    .format = VK_FORMAT_R32_UINT,
-                    .offset = offsetof(region_vertex_t, vertex_index)
-                },
-                {
-                    .binding = 0,
-                    .location = 2,
-                    .format = VK_FORMAT_R32_UINT,
-                    .offset = offsetof(region_vertex_t, voxel_type)
-                }
-            }
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO
         },
         .pRasterizationState = &(VkPipelineRasterizationStateCreateInfo) { DEFAULT_VK_RASTERIZATION },
         .pMultisampleState = &(VkPipelineMultisampleStateCreateInfo) {
@@ -251,24 +258,34 @@ result_t init_region_render_pipeline(VkCommandBuffer command_buffer, VkFence com
     return result_success;
 }
 
-result_t draw_region_render_pipeline(VkCommandBuffer command_buffer) {
-
+result_t draw_region_render_pipeline(VkCommandBuffer command_buffer, uint32_t frame_index, region_culling_mode_t culling_mode, region_culling_phase_t culling_phase) {
     vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
 
     mat4s view_projection = get_view_projection();
     vkCmdPushConstants(command_buffer, pipeline.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_constants_t), &view_projection);
 
-    for (uint32_t i = 0; i < NUM_REGIONS; i++) {
-        region_render_pipeline_info_t* info = &region_render_pipeline_infos[i];
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline_layout, 0, 2, (VkDescriptorSet[2]) { descriptor_set, region_render_pipeline_descriptor_sets[frame_index] }, 0, NULL);
 
-        if (info->vertex_buffer == NULL) {
-            continue;
-        }
+    switch (culling_mode) {
+        case region_culling_mode_gpu:
+            // Draw commands of the visible regions are written by the culling compute pipeline
+            vkCmdDrawIndirectCount(command_buffer, region_culling_draw_command_buffers[frame_index], culling_phase * NUM_REGIONS * sizeof(VkDrawIndirectCommand), region_culling_draw_count_buffers[frame_index], culling_phase * sizeof(uint32_t), NUM_REGIONS, sizeof(VkDrawIndirectCommand));
+            break;
+        case region_culling_mode_cpu: {
+            if (culling_phase != region_culling_phase_first) {
+                break;
+            }
 
-        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline_layout, 0, 2, (VkDescriptorSet[2]) { descriptor_set, info->descriptor_set }, 0, NULL);
-        vkCmdBindVertexBuffers(command_buffer, 0, 1, &info->vertex_buffer, (VkDeviceSize[1]) { 0 });
+            uint32_t visible_region_indices[NUM_REGIONS];
+            size_t num_visible_regions = cull_regions(view_projection, get_camera_position(), (float) (REGION_VIEW_RADIUS * REGION_SIZE), visible_region_indices);
 
-        vkCmdDraw(command_buffer, info->num_vertices, 1, 0, 0);
+            for (size_t i = 0; i < num_visible_regions; i++) {
+                uint32_t region_index = visible_region_indices[i];
+                const region_render_pipeline_info_t* info = &region_render_pipeline_infos[region_index];
+                vkCmdDraw(command_buffer, NUM_CUBE_VOXEL_FACE_VERTICES * info->num_faces, 1, NUM_CUBE_VOXEL_FACE_VERTICES * info->first_face, region_index);
+            }
+            break;
+        }
     }
 
     return result_success;
@@ -1,10 +1,20 @@
 #pragma once
+#include "gfx/region_culling_compute_pipeline.h"
 #include "result.h"
 #include <cglm/types-struct.h>
+#include <stdint.h>
 #include <vulkan/vulkan.h>
 
+typedef enum {
+    // Draw commands are written by the culling compute pipeline
+    region_culling_mode_gpu,
+    // Regions are culled on the CPU and drawn one draw call each
+    region_culling_mode_cpu
+} region_culling_mode_t;
+
 extern VkDescriptorSetLayout region_render_pipeline_set_layout;
 
 result_t init_region_render_pipeline(VkCommandBuffer command_buffer, VkFence command_fence, VkDescriptorPool descriptor_pool, const VkPhysicalDeviceProperties* physical_device_properties);
-result_t draw_region_render_pipeline(VkCommandBuffer command_buffer);
+// Draws the regions that passed the given culling phase, regions culled on the CPU are all drawn in the first phase
+result_t draw_region_render_pipeline(VkCommandBuffer command_buffer, uint32_t frame_index, region_culling_mode_t culling_mode, region_culling_phase_t culling_phase);
 void term_region_render_pipeline(void);
\ No newline at end of file
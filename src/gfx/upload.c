@@ -0,0 +1,244 @@
+#include "upload.h"
+#include "gfx/default.h"
+#include "gfx/gfx.h"
+#include "result.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+#define NUM_UPLOAD_SUBMISSIONS 4
+#define UPLOAD_STAGING_ALIGNMENT 16
+
+typedef struct {
+    VkCommandBuffer command_buffer;
+    uint64_t semaphore_value;
+    // Includes any bytes skipped at the end of the staging ring, released once the submission has finished
+    VkDeviceSize num_staging_bytes;
+} upload_submission_t;
+
+static VkCommandPool command_pool;
+// The num_in_flight_submissions before next_submission_index are still in flight
+static upload_submission_t submissions[NUM_UPLOAD_SUBMISSIONS];
+static size_t next_submission_index;
+static size_t num_in_flight_submissions;
+static uint64_t semaphore_value;
+
+static VkBuffer staging_buffer;
+static VmaAllocation staging_buffer_allocation;
+static uint8_t* staging_buffer_mapped;
+static VkDeviceSize staging_head;
+// Covers both in flight and pending staging bytes
+static VkDeviceSize num_used_staging_bytes;
+static VkDeviceSize num_pending_staging_bytes;
+
+static VkBuffer pending_copy_buffers[MAX_NUM_PENDING_UPLOAD_COPIES];
+static VkBufferCopy pending_copy_regions[MAX_NUM_PENDING_UPLOAD_COPIES];
+static size_t num_pending_copies;
+
+VkSemaphore upload_semaphore;
+
+result_t init_upload(uint32_t queue_family_index) {
+    if (vkCreateCommandPool(device, &(VkCommandPoolCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queue_family_index
+    }, NULL, &command_pool) != VK_SUCCESS) {
+        return result_command_pool_create_failure;
+    }
+
+    for (size_t i = 0; i < NUM_UPLOAD_SUBMISSIONS; i++) {
+        if (vkAllocateCommandBuffers(device, &(VkCommandBufferAllocateInfo) {
+            DEFAULT_VK_COMMAND_BUFFER,
+            .commandPool = command_pool
+        }, &submissions[i].command_buffer) != VK_SUCCESS) {
+            return result_command_buffers_allocate_failure;
+        }
+    }
+
+    if (vkCreateSemaphore(device, &(VkSemaphoreCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &(VkSemaphoreTypeCreateInfo) {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0
+        }
+    }, NULL, &upload_semaphore) != VK_SUCCESS) {
+        return result_synchronization_primitive_create_failure;
+    }
+
+    if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
+        DEFAULT_VK_STAGING_BUFFER,
+        .size = UPLOAD_STAGING_BUFFER_SIZE
+    }, &shared_write_allocation_create_info, &staging_buffer, &staging_buffer_allocation, NULL) != VK_SUCCESS) {
+        return result_buffer_create_failure;
+    }
+
+    // Kept mapped for the whole run since every upload writes to it
+    if (vmaMapMemory(allocator, staging_buffer_allocation, (void**) &staging_buffer_mapped) != VK_SUCCESS) {
+        return result_memory_map_failure;
+    }
+
+    return result_success;
+}
+
+// Releases the staging bytes of finished submissions, optionally waiting for the oldest one first
+static result_t release_finished_submissions(bool should_wait_for_oldest) {
+    if (num_in_flight_submissions == 0) {
+        return result_success;
+    }
+
+    size_t submission_index = (next_submission_index + NUM_UPLOAD_SUBMISSIONS - num_in_flight_submissions) % NUM_UPLOAD_SUBMISSIONS;
+
+    if (should_wait_for_oldest && vkWaitSemaphores(device, &(VkSemaphoreWaitInfo) {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &upload_semaphore,
+        .pValues = &submissions[submission_index].semaphore_value
+    }, UINT64_MAX) != VK_SUCCESS) {
+        return result_semaphores_wait_failure;
+    }
+
+    uint64_t reached_semaphore_value;
+    if (vkGetSemaphoreCounterValue(device, upload_semaphore, &reached_semaphore_value) != VK_SUCCESS) {
+        return result_semaphore_counter_value_get_failure;
+    }
+
+    while (num_in_flight_submissions > 0 && submissions[submission_index].semaphore_value <= reached_semaphore_value) {
+        num_used_staging_bytes -= submissions[submission_index].num_staging_bytes;
+        submission_index = (submission_index + 1) % NUM_UPLOAD_SUBMISSIONS;
+        num_in_flight_submissions--;
+    }
+
+    return result_success;
+}
+
+result_t queue_buffer_upload(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize num_bytes, const void* data) {
+    result_t result;
+
+    assert(num_bytes <= UPLOAD_STAGING_BUFFER_SIZE);
+
+    if (num_pending_copies == MAX_NUM_PENDING_UPLOAD_COPIES) {
+        return result_upload_copies_full;
+    }
+
+    VkDeviceSize num_aligned_bytes = (num_bytes + UPLOAD_STAGING_ALIGNMENT - 1) & ~((VkDeviceSize) UPLOAD_STAGING_ALIGNMENT - 1);
+
+    // Uploads are never split, so a copy that doesn't fit before the end of the ring skips to its start
+    bool does_wrap = staging_head + num_aligned_bytes > UPLOAD_STAGING_BUFFER_SIZE;
+    VkDeviceSize num_skipped_bytes = does_wrap ? UPLOAD_STAGING_BUFFER_SIZE - staging_head : 0;
+
+    while (num_used_staging_bytes + num_skipped_bytes + num_aligned_bytes > UPLOAD_STAGING_BUFFER_SIZE) {
+        if (num_in_flight_submissions == 0) {
+            return result_upload_staging_full;
+        }
+        if ((result = release_finished_submissions(true)) != result_success) {
+            return result;
+        }
+    }
+
+    if (does_wrap) {
+        staging_head = 0;
+    }
+    num_used_staging_bytes += num_skipped_bytes + num_aligned_bytes;
+    num_pending_staging_bytes += num_skipped_bytes + num_aligned_bytes;
+
+    memcpy(&staging_buffer_mapped[staging_head], data, num_bytes);
+
+    pending_copy_buffers[num_pending_copies] = buffer;
+    pending_copy_regions[num_pending_copies] = (VkBufferCopy) {
+        .srcOffset = staging_head,
+        .dstOffset = offset,
+        .size = num_bytes
+    };
+    num_pending_copies++;
+
+    staging_head += num_aligned_bytes;
+
+    return result_success;
+}
+
+result_t flush_uploads(VkSemaphore wait_semaphore, uint64_t wait_semaphore_value, uint64_t* out_semaphore_value) {
+    result_t result;
+
+    if (num_pending_copies == 0) {
+        *out_semaphore_value = semaphore_value;
+        return result_success;
+    }
+
+    if ((result = release_finished_submissions(num_in_flight_submissions == NUM_UPLOAD_SUBMISSIONS)) != result_success) {
+        return result;
+    }
+
+    upload_submission_t* submission = &submissions[next_submission_index];
+    VkCommandBuffer command_buffer = submission->command_buffer;
+
+    if (vkResetCommandBuffer(command_buffer, 0) != VK_SUCCESS) {
+        return result_command_buffer_reset_failure;
+    }
+
+    if (vkBeginCommandBuffer(command_buffer, &(VkCommandBufferBeginInfo) {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    }) != VK_SUCCESS) {
+        return result_command_buffer_begin_failure;
+    }
+
+    // Consecutive copies into the same buffer share one command
+    for (size_t i = 0; i < num_pending_copies;) {
+        size_t num_copies = 1;
+        while (i + num_copies < num_pending_copies && pending_copy_buffers[i + num_copies] == pending_copy_buffers[i]) {
+            num_copies++;
+        }
+        vkCmdCopyBuffer(command_buffer, staging_buffer, pending_copy_buffers[i], (uint32_t) num_copies, &pending_copy_regions[i]);
+        i += num_copies;
+    }
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        return result_command_buffer_end_failure;
+    }
+
+    semaphore_value++;
+
+    bool has_wait_semaphore = wait_semaphore != VK_NULL_HANDLE;
+    if (vkQueueSubmit(transfer_queue, 1, &(VkSubmitInfo) {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &(VkTimelineSemaphoreSubmitInfo) {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .waitSemaphoreValueCount = has_wait_semaphore ? 1 : 0,
+            .pWaitSemaphoreValues = &wait_semaphore_value,
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &semaphore_value
+        },
+        .waitSemaphoreCount = has_wait_semaphore ? 1 : 0,
+        .pWaitSemaphores = &wait_semaphore,
+        .pWaitDstStageMask = (VkPipelineStageFlags[1]) { VK_PIPELINE_STAGE_TRANSFER_BIT },
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &upload_semaphore
+    }, VK_NULL_HANDLE) != VK_SUCCESS) {
+        return result_queue_submit_failure;
+    }
+
+    submission->semaphore_value = semaphore_value;
+    submission->num_staging_bytes = num_pending_staging_bytes;
+    next_submission_index = (next_submission_index + 1) % NUM_UPLOAD_SUBMISSIONS;
+    num_in_flight_submissions++;
+
+    num_pending_staging_bytes = 0;
+    num_pending_copies = 0;
+
+    *out_semaphore_value = semaphore_value;
+
+    return result_success;
+}
+
+void term_upload(void) {
+    vmaUnmapMemory(allocator, staging_buffer_allocation);
+    vmaDestroyBuffer(allocator, staging_buffer, staging_buffer_allocation);
+    vkDestroySemaphore(device, upload_semaphore, NULL);
+    vkDestroyCommandPool(device, command_pool, NULL);
+}
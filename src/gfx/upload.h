@@ -0,0 +1,19 @@
+#pragma once
+#include "result.h"
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+// Staging memory shared by every upload that hasn't finished on the GPU yet
+#define UPLOAD_STAGING_BUFFER_SIZE (8u << 20)
+#define MAX_NUM_PENDING_UPLOAD_COPIES 1024
+
+// Timeline semaphore signaled by upload submissions on the transfer queue
+extern VkSemaphore upload_semaphore;
+
+result_t init_upload(uint32_t queue_family_index);
+// Copies the data into staging memory right away, the copy into the buffer is only recorded by the next flush
+result_t queue_buffer_upload(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize num_bytes, const void* data);
+// Submits every queued copy in one command buffer that starts once the wait semaphore reaches its value, without waiting on the CPU
+// Consumers wait for the returned semaphore value, which is the last submission's value if nothing was queued
+result_t flush_uploads(VkSemaphore wait_semaphore, uint64_t wait_semaphore_value, uint64_t* out_semaphore_value);
+void term_upload(void);
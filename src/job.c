@@ -0,0 +1,220 @@
+#include "job.h"
+#include "result.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+typedef struct {
+    job_t job;
+    job_counter_t* counter;
+} job_entry_t;
+
+// The owning worker pushes and pops at the bottom while other workers steal from the top
+typedef struct {
+    pthread_mutex_t mutex;
+    job_entry_t entries[JOB_DEQUE_CAPACITY];
+    size_t top;
+    size_t bottom;
+} job_deque_t;
+
+static size_t num_workers;
+static size_t num_started_threads;
+static job_deque_t deques[MAX_NUM_JOB_WORKERS];
+// Indexed by worker index, worker 0 has no thread of its own
+static pthread_t threads[MAX_NUM_JOB_WORKERS];
+
+// Idle workers sleep until jobs are queued, threads waiting on a counter also wake when any counter reaches zero
+static pthread_mutex_t sleep_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_condition = PTHREAD_COND_INITIALIZER;
+// Incremented before a job is pushed and decremented once it's taken, so it never undercounts
+static atomic_size_t num_queued_jobs;
+static atomic_bool should_stop;
+
+// Threads that aren't workers share worker 0's deque
+static _Thread_local size_t current_worker_index;
+
+static bool push_job(job_deque_t* deque, const job_entry_t* entry) {
+    pthread_mutex_lock(&deque->mutex);
+    bool is_full = deque->bottom - deque->top == JOB_DEQUE_CAPACITY;
+    if (!is_full) {
+        deque->entries[deque->bottom % JOB_DEQUE_CAPACITY] = *entry;
+        deque->bottom++;
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return !is_full;
+}
+
+// Newest first, so the owner keeps working on what it queued last while it's still in cache
+static bool pop_job(job_deque_t* deque, job_entry_t* entry) {
+    pthread_mutex_lock(&deque->mutex);
+    bool is_empty = deque->bottom == deque->top;
+    if (!is_empty) {
+        deque->bottom--;
+        *entry = deque->entries[deque->bottom % JOB_DEQUE_CAPACITY];
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return !is_empty;
+}
+
+static bool steal_job(job_deque_t* deque, job_entry_t* entry) {
+    pthread_mutex_lock(&deque->mutex);
+    bool is_empty = deque->bottom == deque->top;
+    if (!is_empty) {
+        *entry = deque->entries[deque->top % JOB_DEQUE_CAPACITY];
+        deque->top++;
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return !is_empty;
+}
+
+static bool take_job(job_entry_t* entry) {
+    bool is_taken = pop_job(&deques[current_worker_index], entry);
+    for (size_t i = 1; i < num_workers && !is_taken; i++) {
+        is_taken = steal_job(&deques[(current_worker_index + i) % num_workers], entry);
+    }
+
+    if (is_taken) {
+        atomic_fetch_sub(&num_queued_jobs, 1);
+    }
+    return is_taken;
+}
+
+static void execute_job(const job_entry_t* entry) {
+    entry->job.function(entry->job.argument);
+    // The counter may go out of scope as soon as it reaches zero, so it's not touched after the decrement
+    if (entry->counter != NULL && atomic_fetch_sub(&entry->counter->num_pending_jobs, 1) == 1) {
+        pthread_mutex_lock(&sleep_mutex);
+        pthread_cond_broadcast(&wake_condition);
+        pthread_mutex_unlock(&sleep_mutex);
+    }
+}
+
+static void* run_worker(void* argument) {
+    current_worker_index = (size_t) (uintptr_t) argument;
+
+    job_entry_t entry;
+    while (!atomic_load(&should_stop)) {
+        if (take_job(&entry)) {
+            execute_job(&entry);
+            continue;
+        }
+
+        pthread_mutex_lock(&sleep_mutex);
+        while (atomic_load(&num_queued_jobs) == 0 && !atomic_load(&should_stop)) {
+            pthread_cond_wait(&wake_condition, &sleep_mutex);
+        }
+        pthread_mutex_unlock(&sleep_mutex);
+    }
+
+    return NULL;
+}
+
+static void stop_workers(void) {
+    pthread_mutex_lock(&sleep_mutex);
+    atomic_store(&should_stop, true);
+    pthread_cond_broadcast(&wake_condition);
+    pthread_mutex_unlock(&sleep_mutex);
+
+    for (size_t i = 1; i <= num_started_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    num_started_threads = 0;
+
+    for (size_t i = 0; i < num_workers; i++) {
+        pthread_mutex_destroy(&deques[i].mutex);
+    }
+}
+
+result_t init_jobs(void) {
+    long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_workers = num_cores < 1 ? 1 : (size_t) num_cores;
+    if (num_workers > MAX_NUM_JOB_WORKERS) {
+        num_workers = MAX_NUM_JOB_WORKERS;
+    }
+
+    for (size_t i = 0; i < num_workers; i++) {
+        pthread_mutex_init(&deques[i].mutex, NULL);
+    }
+
+    for (size_t i = 1; i < num_workers; i++) {
+        if (pthread_create(&threads[i], NULL, run_worker, (void*) (uintptr_t) i) != 0) {
+            stop_workers();
+            return result_thread_create_failure;
+        }
+        num_started_threads++;
+    }
+
+    return result_success;
+}
+
+size_t get_num_job_workers(void) {
+    return num_workers;
+}
+
+void run_jobs(size_t num_jobs, const job_t jobs[], job_counter_t* counter) {
+    if (counter != NULL) {
+        atomic_fetch_add(&counter->num_pending_jobs, num_jobs);
+    }
+
+    job_deque_t* deque = &deques[current_worker_index];
+    for (size_t i = 0; i < num_jobs; i++) {
+        job_entry_t entry = {
+            .job = jobs[i],
+            .counter = counter
+        };
+
+        atomic_fetch_add(&num_queued_jobs, 1);
+        if (!push_job(deque, &entry)) {
+            atomic_fetch_sub(&num_queued_jobs, 1);
+            execute_job(&entry);
+        }
+    }
+
+    // Sleeping workers check the queued job count while holding the mutex, so they can't miss this
+    pthread_mutex_lock(&sleep_mutex);
+    pthread_cond_broadcast(&wake_condition);
+    pthread_mutex_unlock(&sleep_mutex);
+}
+
+void wait_for_job_counter(job_counter_t* counter) {
+    job_entry_t entry;
+    while (atomic_load(&counter->num_pending_jobs) != 0) {
+        if (take_job(&entry)) {
+            execute_job(&entry);
+            continue;
+        }
+
+        // The remaining jobs are running on other workers, sleep until they finish or more jobs are queued
+        pthread_mutex_lock(&sleep_mutex);
+        while (atomic_load(&counter->num_pending_jobs) != 0 && atomic_load(&num_queued_jobs) == 0) {
+            pthread_cond_wait(&wake_condition, &sleep_mutex);
+        }
+        pthread_mutex_unlock(&sleep_mutex);
+    }
+}
+
+void run_shared_work_jobs(size_t num_items, job_function_t function, void* work) {
+    size_t num_jobs = get_num_job_workers();
+    if (num_jobs > num_items) {
+        num_jobs = num_items;
+    }
+
+    job_t jobs[MAX_NUM_JOB_WORKERS];
+    for (size_t i = 0; i < num_jobs; i++) {
+        jobs[i] = (job_t) {
+            .function = function,
+            .argument = work
+        };
+    }
+
+    job_counter_t counter = { 0 };
+    run_jobs(num_jobs, jobs, &counter);
+    wait_for_job_counter(&counter);
+}
+
+void term_jobs(void) {
+    stop_workers();
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "result.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Jobs queued by one worker beyond this many run right away on the queuing thread
+#define JOB_DEQUE_CAPACITY 1024
+#define MAX_NUM_JOB_WORKERS 64
+
+typedef void (*job_function_t)(void* argument);
+
+typedef struct {
+    job_function_t function;
+    void* argument;
+} job_t;
+
+// Counts the unfinished jobs it was passed to, work that depends on them waits for it to reach zero
+typedef struct {
+    atomic_size_t num_pending_jobs;
+} job_counter_t;
+
+// Starts one worker per additional core, the thread calling init is worker 0 and only runs jobs while waiting
+result_t init_jobs(void);
+// Includes the thread that called init
+size_t get_num_job_workers(void);
+// Queues the jobs on the calling worker's deque where idle workers steal them from, the counter may be NULL
+void run_jobs(size_t num_jobs, const job_t jobs[], job_counter_t* counter);
+// Runs queued jobs on the calling thread until the counter reaches zero, so jobs may wait for other jobs too
+void wait_for_job_counter(job_counter_t* counter);
+// One job per worker at most, each taking items from the shared work until none are left, blocks until all of them are done
+void run_shared_work_jobs(size_t num_items, job_function_t function, void* work);
+void term_jobs(void);
@@ -1,12 +1,61 @@
 #include "camera.h"
 #include "chrono.h"
 #include "gfx/gfx.h"
+#include "gfx/region_meshing_compute_pipeline.h"
+#include "job.h"
 #include "result.h"
+#include "voxel/region_management.h"
 #include <GLFW/glfw3.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool are_regions_built(void) {
+    return !has_pending_region_placements() && !is_any_region_in_mesh_state(region_mesh_state_await_generation) && !is_any_region_in_mesh_state(region_mesh_state_await_meshing_compute) && is_region_meshing_idle();
+}
+
+// Builds the regions around the camera without a window, then exits
+static int run_headless(void) {
+    result_t result;
+    if ((result = init_jobs()) != result_success) {
+        print_result_error(result);
+        return 1;
+    }
+    if ((result = init_gfx(gfx_mode_headless)) != result_success) {
+        print_result_error(result);
+        return 1;
+    }
+
+    microseconds_t start = get_current_microseconds();
+
+    size_t num_frames = 0;
+    while (!are_regions_built()) {
+        if ((result = draw_gfx()) != result_success) {
+            print_result_error(result);
+            return 1;
+        }
+        num_frames++;
+    }
+
+    printf("Built regions in %ldμs over %lu frames\n", get_current_microseconds() - start, num_frames);
+
+    term_gfx();
+    term_jobs();
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0) {
+        return run_headless();
+    }
 
-int main() {
     result_t result;
-    if ((result = init_gfx()) != result_success) {
+    if ((result = init_jobs()) != result_success) {
+        print_result_error(result);
+        return 1;
+    }
+    if ((result = init_gfx(gfx_mode_windowed)) != result_success) {
         print_result_error(result);
         return 1;
     }
@@ -19,6 +68,11 @@ int main() {
         glfwPollEvents();
         camera_update();
 
+        if ((result = update_region_management(get_camera_position())) != result_success) {
+            print_result_error(result);
+            return 1;
+        }
+
         if ((result = draw_gfx()) != result_success) {
             print_result_error(result);
             return 1;
@@ -41,6 +95,7 @@ int main() {
     (void)delta;
 
     term_gfx();
+    term_jobs();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -25,8 +25,15 @@ static const char* get_result_string(result_t result) {
         case result_shader_module_create_failure: return "Failed to create shader module";
         case result_graphics_pipelines_create_failure: return "Failed to create graphics pipelines";
         case result_compute_pipelines_create_failure: return "Failed to create compute pipelines";
+        case result_virtual_block_create_failure: return "Failed to create virtual block";
+        case result_query_pool_create_failure: return "Failed to create query pool";
+        case result_thread_create_failure: return "Failed to create thread";
 
         case result_descriptor_sets_allocate_failure: return "Failed to allocate descriptor sets";
+        case result_virtual_allocate_failure: return "Failed to allocate from virtual block";
+        case result_upload_copies_full: return "Too many queued uploads";
+        case result_upload_staging_full: return "Not enough upload staging memory";
+        case result_region_io_queue_full: return "Too many region I/O requests in flight";
 
         case result_command_buffers_allocate_failure: return "Failed to allocate command buffers";
         case result_command_buffer_begin_failure: return "Failed to begin command buffer"; 
@@ -38,6 +45,9 @@ static const char* get_result_string(result_t result) {
         case result_memory_map_failure: return "Failed to map buffer memory";
         case result_fences_wait_failure: return "Faled to wait for fences";
         case result_fences_reset_failure: return "Failed to reset fences";
+        case result_semaphores_wait_failure: return "Failed to wait for semaphores";
+        case result_semaphore_counter_value_get_failure: return "Failed to get semaphore counter value";
+        case result_queue_wait_failure: return "Failed to wait for queue";
         case result_command_buffer_reset_failure: return "Failed to command buffer";
 
         case result_image_pixels_load_failure: return "Failed to load image pixels";
@@ -45,6 +55,8 @@ static const char* get_result_string(result_t result) {
         case result_file_access_failure: return "Failed to access file";
         case result_file_open_failure: return "Failed to open file";
         case result_file_read_failure: return "Failed to read file";
+        case result_file_write_failure: return "Failed to write file";
+        case result_file_map_failure: return "Failed to map file";
 
         case result_validation_layers_unavailable: return "Validation layers requested, but not available";
         case result_physical_device_support_unavailable: return "Failed to find physical devices with Vulkan support";
@@ -54,6 +66,7 @@ static const char* get_result_string(result_t result) {
 
         case result_text_model_index_invalid: return "Invalid text model index";
         case result_image_dimensions_invalid: return "Invalid image dimensions";
+        case result_region_file_invalid: return "Invalid region file";
 
         case result_glfw_init_failure: return "Failed to initialize GLFW";
 
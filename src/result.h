@@ -24,8 +24,15 @@ typedef enum {
     result_shader_module_create_failure,
     result_graphics_pipelines_create_failure,
     result_compute_pipelines_create_failure,
+    result_virtual_block_create_failure,
+    result_query_pool_create_failure,
+    result_thread_create_failure,
 
     result_descriptor_sets_allocate_failure,
+    result_virtual_allocate_failure,
+    result_upload_copies_full,
+    result_upload_staging_full,
+    result_region_io_queue_full,
 
     result_command_buffers_allocate_failure,
     result_command_buffer_begin_failure,
@@ -37,6 +44,9 @@ typedef enum {
     result_memory_map_failure,
     result_fences_wait_failure,
     result_fences_reset_failure,
+    result_semaphores_wait_failure,
+    result_semaphore_counter_value_get_failure,
+    result_queue_wait_failure,
     result_command_buffer_reset_failure,
 
     result_image_pixels_load_failure,
@@ -44,6 +54,8 @@ typedef enum {
     result_file_access_failure,
     result_file_open_failure,
     result_file_read_failure,
+    result_file_write_failure,
+    result_file_map_failure,
     
     result_validation_layers_unavailable,
     result_physical_device_support_unavailable,
@@ -53,6 +65,7 @@ typedef enum {
 
     result_text_model_index_invalid,
     result_image_dimensions_invalid,
+    result_region_file_invalid,
 
     result_glfw_init_failure
 } result_t;
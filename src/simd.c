@@ -0,0 +1,27 @@
+#include "simd.h"
+
+const char* simd_level_names[NUM_SIMD_LEVELS] = {
+    [simd_level_none] = "scalar",
+    [simd_level_sse2] = "sse2",
+    [simd_level_sse4_1] = "sse4.1",
+    [simd_level_avx] = "avx",
+    [simd_level_avx2] = "avx2"
+};
+
+simd_level_t get_simd_level(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+        return simd_level_avx2;
+    }
+    if (__builtin_cpu_supports("avx")) {
+        return simd_level_avx;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return simd_level_sse4_1;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return simd_level_sse2;
+    }
+#endif
+    return simd_level_none;
+}
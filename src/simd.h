@@ -0,0 +1,16 @@
+#pragma once
+
+// The build targets baseline x86-64, so vector kernels are compiled once per level under GCC target pragmas and picked at runtime from get_simd_level
+typedef enum {
+    simd_level_none,
+    simd_level_sse2,
+    simd_level_sse4_1,
+    simd_level_avx,
+    simd_level_avx2,
+    NUM_SIMD_LEVELS
+} simd_level_t;
+
+extern const char* simd_level_names[NUM_SIMD_LEVELS];
+
+// Highest level the running CPU supports
+simd_level_t get_simd_level(void);
@@ -0,0 +1,191 @@
+#include "perlin.h"
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAS_PERLIN_BATCHES
+#include <immintrin.h>
+#endif
+
+#define PERLIN_HASH_X_FACTOR 0x8da6b343u
+#define PERLIN_HASH_Y_FACTOR 0xd8163841u
+#define PERLIN_HASH_MIX_FACTOR_0 0x7feb352du
+#define PERLIN_HASH_MIX_FACTOR_1 0x846ca68bu
+
+static uint32_t get_hash(uint32_t x, uint32_t y, uint32_t seed) {
+    uint32_t hash = (x * PERLIN_HASH_X_FACTOR) ^ (y * PERLIN_HASH_Y_FACTOR) ^ seed;
+    hash ^= hash >> 16;
+    hash *= PERLIN_HASH_MIX_FACTOR_0;
+    hash ^= hash >> 15;
+    hash *= PERLIN_HASH_MIX_FACTOR_1;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// The two lowest hash bits pick one of the four diagonal gradients
+static float get_gradient_dot(uint32_t hash, float dx, float dy) {
+    return ((hash & 1u) != 0 ? -dx : dx) + ((hash & 2u) != 0 ? -dy : dy);
+}
+
+static float get_fade(float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static float get_perlin(float x, float y, uint32_t seed) {
+    float floor_x = floorf(x);
+    float floor_y = floorf(y);
+    uint32_t cell_x = (uint32_t) (int32_t) floor_x;
+    uint32_t cell_y = (uint32_t) (int32_t) floor_y;
+    float dx = x - floor_x;
+    float dy = y - floor_y;
+
+    float n00 = get_gradient_dot(get_hash(cell_x, cell_y, seed), dx, dy);
+    float n10 = get_gradient_dot(get_hash(cell_x + 1u, cell_y, seed), dx - 1.0f, dy);
+    float n01 = get_gradient_dot(get_hash(cell_x, cell_y + 1u, seed), dx, dy - 1.0f);
+    float n11 = get_gradient_dot(get_hash(cell_x + 1u, cell_y + 1u, seed), dx - 1.0f, dy - 1.0f);
+
+    float u = get_fade(dx);
+    float v = get_fade(dy);
+    float nx0 = n00 + u * (n10 - n00);
+    float nx1 = n01 + u * (n11 - n01);
+    return nx0 + v * (nx1 - nx0);
+}
+
+float get_perlin_fbm(float x, float y, float frequency, uint32_t num_octaves, float persistence, float lacunarity, uint32_t seed) {
+    float value = 0.0f;
+    float amplitude = 1.0f;
+    for (uint32_t octave = 0; octave < num_octaves; octave++) {
+        value = value + amplitude * get_perlin(x * frequency, y * frequency, seed + octave);
+        amplitude *= persistence;
+        frequency *= lacunarity;
+    }
+    return value;
+}
+
+#if defined(HAS_PERLIN_BATCHES)
+// FMA is left out on purpose, fused multiply-adds would round differently from the shader
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define PERLIN_BATCH_SIZE 8
+#define BATCH_FUNCTION(NAME) NAME##_avx2
+#define float_batch_t __m256
+#define uint_batch_t __m256i
+#define batch_load _mm256_loadu_ps
+#define batch_store _mm256_storeu_ps
+#define batch_set1 _mm256_set1_ps
+#define batch_add _mm256_add_ps
+#define batch_sub _mm256_sub_ps
+#define batch_mul _mm256_mul_ps
+#define batch_floor _mm256_floor_ps
+#define batch_to_uint _mm256_cvttps_epi32
+#define batch_set1_uint(A) _mm256_set1_epi32((int) (A))
+#define batch_add_uint _mm256_add_epi32
+#define batch_mul_uint _mm256_mullo_epi32
+#define batch_xor_uint _mm256_xor_si256
+#define batch_and_uint _mm256_and_si256
+#define batch_shl_uint _mm256_slli_epi32
+#define batch_shr_uint _mm256_srli_epi32
+#define batch_as_float _mm256_castsi256_ps
+#define batch_as_uint _mm256_castps_si256
+#include "perlin_batch.h"
+#undef PERLIN_BATCH_SIZE
+#undef BATCH_FUNCTION
+#undef float_batch_t
+#undef uint_batch_t
+#undef batch_load
+#undef batch_store
+#undef batch_set1
+#undef batch_add
+#undef batch_sub
+#undef batch_mul
+#undef batch_floor
+#undef batch_to_uint
+#undef batch_set1_uint
+#undef batch_add_uint
+#undef batch_mul_uint
+#undef batch_xor_uint
+#undef batch_and_uint
+#undef batch_shl_uint
+#undef batch_shr_uint
+#undef batch_as_float
+#undef batch_as_uint
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#define PERLIN_BATCH_SIZE 4
+#define BATCH_FUNCTION(NAME) NAME##_sse4_1
+#define float_batch_t __m128
+#define uint_batch_t __m128i
+#define batch_load _mm_loadu_ps
+#define batch_store _mm_storeu_ps
+#define batch_set1 _mm_set1_ps
+#define batch_add _mm_add_ps
+#define batch_sub _mm_sub_ps
+#define batch_mul _mm_mul_ps
+#define batch_floor _mm_floor_ps
+#define batch_to_uint _mm_cvttps_epi32
+#define batch_set1_uint(A) _mm_set1_epi32((int) (A))
+#define batch_add_uint _mm_add_epi32
+#define batch_mul_uint _mm_mullo_epi32
+#define batch_xor_uint _mm_xor_si128
+#define batch_and_uint _mm_and_si128
+#define batch_shl_uint _mm_slli_epi32
+#define batch_shr_uint _mm_srli_epi32
+#define batch_as_float _mm_castsi128_ps
+#define batch_as_uint _mm_castps_si128
+#include "perlin_batch.h"
+#undef PERLIN_BATCH_SIZE
+#undef BATCH_FUNCTION
+#undef float_batch_t
+#undef uint_batch_t
+#undef batch_load
+#undef batch_store
+#undef batch_set1
+#undef batch_add
+#undef batch_sub
+#undef batch_mul
+#undef batch_floor
+#undef batch_to_uint
+#undef batch_set1_uint
+#undef batch_add_uint
+#undef batch_mul_uint
+#undef batch_xor_uint
+#undef batch_and_uint
+#undef batch_shl_uint
+#undef batch_shr_uint
+#undef batch_as_float
+#undef batch_as_uint
+#pragma GCC pop_options
+#endif
+
+simd_level_t get_perlin_simd_level(void) {
+    simd_level_t level = get_simd_level();
+    if (level >= simd_level_avx2) {
+        return simd_level_avx2;
+    }
+    if (level >= simd_level_sse4_1) {
+        return simd_level_sse4_1;
+    }
+    return simd_level_none;
+}
+
+void get_perlin_fbm_values(size_t num_positions, const float x[], const float y[], float frequency, uint32_t num_octaves, float persistence, float lacunarity, uint32_t seed, float values[]) {
+    size_t position_index = 0;
+
+#if defined(HAS_PERLIN_BATCHES)
+    switch (get_perlin_simd_level()) {
+        case simd_level_avx2:
+            position_index = get_perlin_fbm_batches_avx2(num_positions, x, y, frequency, num_octaves, persistence, lacunarity, seed, values);
+            break;
+        case simd_level_sse4_1:
+            position_index = get_perlin_fbm_batches_sse4_1(num_positions, x, y, frequency, num_octaves, persistence, lacunarity, seed, values);
+            break;
+        default:
+            break;
+    }
+#endif
+
+    for (; position_index < num_positions; position_index++) {
+        values[position_index] = get_perlin_fbm(x[position_index], y[position_index], frequency, num_octaves, persistence, lacunarity, seed);
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include "simd.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Mirrors shader/perlin.glsl operation for operation, so both give the same bits for the same inputs
+// The octaves are summed without normalising, each one within about [-1, 1] times its amplitude
+float get_perlin_fbm(float x, float y, float frequency, uint32_t num_octaves, float persistence, float lacunarity, uint32_t seed);
+// Evaluates many positions at once, vectorised with AVX2 or SSE4.1 when the CPU supports them
+void get_perlin_fbm_values(size_t num_positions, const float x[], const float y[], float frequency, uint32_t num_octaves, float persistence, float lacunarity, uint32_t seed, float values[]);
+// The instruction set get_perlin_fbm_values runs on
+simd_level_t get_perlin_simd_level(void);
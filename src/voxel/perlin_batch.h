@@ -0,0 +1,72 @@
+// Batch kernel of perlin.c, which includes this once per instruction set with the batch types, operations and BATCH_FUNCTION naming defined and a target pragma in effect
+// There's deliberately no #pragma once
+
+// Same operations in the same order as the scalar path, so every lane gives the same bits
+static uint_batch_t BATCH_FUNCTION(get_hash_batch)(uint_batch_t x, uint_batch_t y, uint_batch_t seed) {
+    uint_batch_t hash = batch_xor_uint(batch_xor_uint(batch_mul_uint(x, batch_set1_uint(PERLIN_HASH_X_FACTOR)), batch_mul_uint(y, batch_set1_uint(PERLIN_HASH_Y_FACTOR))), seed);
+    hash = batch_xor_uint(hash, batch_shr_uint(hash, 16));
+    hash = batch_mul_uint(hash, batch_set1_uint(PERLIN_HASH_MIX_FACTOR_0));
+    hash = batch_xor_uint(hash, batch_shr_uint(hash, 15));
+    hash = batch_mul_uint(hash, batch_set1_uint(PERLIN_HASH_MIX_FACTOR_1));
+    hash = batch_xor_uint(hash, batch_shr_uint(hash, 16));
+    return hash;
+}
+
+// Negating only flips the sign bit, so the hash bits are moved into the sign bits directly
+static float_batch_t BATCH_FUNCTION(get_gradient_dot_batch)(uint_batch_t hash, float_batch_t dx, float_batch_t dy) {
+    uint_batch_t sign_x = batch_shl_uint(hash, 31);
+    uint_batch_t sign_y = batch_shl_uint(batch_and_uint(hash, batch_set1_uint(2u)), 30);
+    return batch_add(batch_as_float(batch_xor_uint(batch_as_uint(dx), sign_x)), batch_as_float(batch_xor_uint(batch_as_uint(dy), sign_y)));
+}
+
+static float_batch_t BATCH_FUNCTION(get_fade_batch)(float_batch_t t) {
+    float_batch_t polynomial = batch_add(batch_mul(t, batch_sub(batch_mul(t, batch_set1(6.0f)), batch_set1(15.0f))), batch_set1(10.0f));
+    return batch_mul(batch_mul(batch_mul(t, t), t), polynomial);
+}
+
+static float_batch_t BATCH_FUNCTION(get_perlin_batch)(float_batch_t x, float_batch_t y, uint_batch_t seed) {
+    float_batch_t floor_x = batch_floor(x);
+    float_batch_t floor_y = batch_floor(y);
+    uint_batch_t cell_x = batch_to_uint(floor_x);
+    uint_batch_t cell_y = batch_to_uint(floor_y);
+    uint_batch_t next_cell_x = batch_add_uint(cell_x, batch_set1_uint(1u));
+    uint_batch_t next_cell_y = batch_add_uint(cell_y, batch_set1_uint(1u));
+    float_batch_t dx = batch_sub(x, floor_x);
+    float_batch_t dy = batch_sub(y, floor_y);
+    float_batch_t one = batch_set1(1.0f);
+    float_batch_t next_dx = batch_sub(dx, one);
+    float_batch_t next_dy = batch_sub(dy, one);
+
+    float_batch_t n00 = BATCH_FUNCTION(get_gradient_dot_batch)(BATCH_FUNCTION(get_hash_batch)(cell_x, cell_y, seed), dx, dy);
+    float_batch_t n10 = BATCH_FUNCTION(get_gradient_dot_batch)(BATCH_FUNCTION(get_hash_batch)(next_cell_x, cell_y, seed), next_dx, dy);
+    float_batch_t n01 = BATCH_FUNCTION(get_gradient_dot_batch)(BATCH_FUNCTION(get_hash_batch)(cell_x, next_cell_y, seed), dx, next_dy);
+    float_batch_t n11 = BATCH_FUNCTION(get_gradient_dot_batch)(BATCH_FUNCTION(get_hash_batch)(next_cell_x, next_cell_y, seed), next_dx, next_dy);
+
+    float_batch_t u = BATCH_FUNCTION(get_fade_batch)(dx);
+    float_batch_t v = BATCH_FUNCTION(get_fade_batch)(dy);
+    float_batch_t nx0 = batch_add(n00, batch_mul(u, batch_sub(n10, n00)));
+    float_batch_t nx1 = batch_add(n01, batch_mul(u, batch_sub(n11, n01)));
+    return batch_add(nx0, batch_mul(v, batch_sub(nx1, nx0)));
+}
+
+// Returns how many positions were evaluated, the rest don't fill a whole batch
+static size_t BATCH_FUNCTION(get_perlin_fbm_batches)(size_t num_positions, const float x[], const float y[], float frequency, uint32_t num_octaves, float persistence, float lacunarity, uint32_t seed, float values[]) {
+    size_t position_index = 0;
+    for (; position_index + PERLIN_BATCH_SIZE <= num_positions; position_index += PERLIN_BATCH_SIZE) {
+        float_batch_t batch_x = batch_load(&x[position_index]);
+        float_batch_t batch_y = batch_load(&y[position_index]);
+
+        float_batch_t value = batch_set1(0.0f);
+        float amplitude = 1.0f;
+        float octave_frequency = frequency;
+        for (uint32_t octave = 0; octave < num_octaves; octave++) {
+            float_batch_t batch_frequency = batch_set1(octave_frequency);
+            float_batch_t noise = BATCH_FUNCTION(get_perlin_batch)(batch_mul(batch_x, batch_frequency), batch_mul(batch_y, batch_frequency), batch_set1_uint(seed + octave));
+            value = batch_add(value, batch_mul(batch_set1(amplitude), noise));
+            amplitude *= persistence;
+            octave_frequency *= lacunarity;
+        }
+        batch_store(&values[position_index], value);
+    }
+    return position_index;
+}
@@ -2,5 +2,16 @@
 #define REGION_H
 
 #define REGION_SIZE 32u
+// Voxel images have a mip level per level of detail, level l has REGION_SIZE >> l voxels per axis that each cover 2^l voxels per axis of level 0
+#define NUM_REGION_LODS 4u
+
+// Terrain parameters shared by region_generation.comp and the CPU generator
+#define REGION_GENERATION_SEED 0x578437adu
+#define REGION_GENERATION_NOISE_SCALE 0.01f
+#define REGION_GENERATION_NUM_OCTAVES 6u
+// Bounds of the terrain surface height in voxels, which is (noise * 0.5 + 1) * 8 rounded towards zero
+// Perlin noise with diagonal gradients stays within [-1, 1] and the octave amplitudes sum to less than 2, so the height stays within [0, 16)
+#define REGION_GENERATION_MIN_SURFACE_HEIGHT 0
+#define REGION_GENERATION_MAX_SURFACE_HEIGHT 15
 
 #endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "region_cpu_generation.h"
+#include "job.h"
+#include "util.h"
+#include "voxel/perlin.h"
+#include "voxel/region.h"
+#include "voxel/voxel.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+typedef struct {
+    size_t num_regions;
+    const ivec3s* region_positions;
+    region_voxels_t* const* voxels;
+    uint8_t* uniform_voxel_types;
+    atomic_size_t next_region_index;
+} region_generation_work_t;
+
+typedef struct {
+    size_t num_columns;
+    const ivec3s* column_positions;
+    int32_t* min_heights;
+    int32_t* max_heights;
+    atomic_size_t next_column_index;
+} column_surface_work_t;
+
+// Terrain heights along one row of a region, in voxels
+static void get_row_heights(int32_t first_x, int32_t world_z, int32_t heights[REGION_SIZE]) {
+    float noise_x[REGION_SIZE];
+    float noise_z[REGION_SIZE];
+    for (uint32_t x = 0; x < REGION_SIZE; x++) {
+        noise_x[x] = REGION_GENERATION_NOISE_SCALE * (float) (first_x + (int32_t) x);
+        noise_z[x] = REGION_GENERATION_NOISE_SCALE * (float) world_z;
+    }
+
+    float values[REGION_SIZE];
+    get_perlin_fbm_values(REGION_SIZE, noise_x, noise_z, 1.0f, REGION_GENERATION_NUM_OCTAVES, 0.5f, 2.0f, REGION_GENERATION_SEED, values);
+
+    // Same mapping from noise to terrain height as region_generation.comp
+    for (uint32_t x = 0; x < REGION_SIZE; x++) {
+        heights[x] = (int32_t) ((values[x] * 0.5f + 1.0f) * 8.0f);
+        // The view height and the voxel image pool are sized from these bounds
+        assert(heights[x] >= REGION_GENERATION_MIN_SURFACE_HEIGHT && heights[x] <= REGION_GENERATION_MAX_SURFACE_HEIGHT);
+    }
+}
+
+void get_region_column_surface_heights(int32_t column_x, int32_t column_z, int32_t* min_height, int32_t* max_height) {
+    int32_t first_x = (int32_t) REGION_SIZE * column_x;
+    int32_t first_z = (int32_t) REGION_SIZE * column_z;
+
+    *min_height = INT32_MAX;
+    *max_height = INT32_MIN;
+    for (uint32_t z = 0; z < REGION_SIZE; z++) {
+        int32_t heights[REGION_SIZE];
+        get_row_heights(first_x, first_z + (int32_t) z, heights);
+
+        for (uint32_t x = 0; x < REGION_SIZE; x++) {
+            *min_height = heights[x] < *min_height ? heights[x] : *min_height;
+            *max_height = heights[x] > *max_height ? heights[x] : *max_height;
+        }
+    }
+}
+
+uint8_t generate_region_on_cpu(ivec3s region_position, region_voxels_t* voxels) {
+    int32_t first_x = (int32_t) REGION_SIZE * region_position.x;
+    int32_t first_y = (int32_t) REGION_SIZE * region_position.y;
+    int32_t first_z = (int32_t) REGION_SIZE * region_position.z;
+
+    int32_t min_height = INT32_MAX;
+    int32_t max_height = INT32_MIN;
+
+    for (uint32_t z = 0; z < REGION_SIZE; z++) {
+        int32_t heights[REGION_SIZE];
+        get_row_heights(first_x, first_z + (int32_t) z, heights);
+
+        for (uint32_t x = 0; x < REGION_SIZE; x++) {
+            min_height = heights[x] < min_height ? heights[x] : min_height;
+            max_height = heights[x] > max_height ? heights[x] : max_height;
+        }
+
+        for (uint32_t y = 0; y < REGION_SIZE; y++) {
+            int32_t world_y = first_y + (int32_t) y;
+            for (uint32_t x = 0; x < REGION_SIZE; x++) {
+                voxels->types[z][y][x] = (uint8_t) (world_y > heights[x] ? VOXEL_TYPE_AIR : (world_y == heights[x] ? VOXEL_TYPE_GRASS : VOXEL_TYPE_DIRT));
+            }
+        }
+    }
+
+    // Decided from the heights, since the voxels may have been written to memory that's slow to read back
+    if (first_y > max_height) {
+        return VOXEL_TYPE_AIR;
+    }
+    if (first_y + (int32_t) REGION_SIZE - 1 < min_height) {
+        return VOXEL_TYPE_DIRT;
+    }
+    return NULL_UINT8;
+}
+
+// Every job keeps taking regions until none are left, so workers that start late still share the load
+static void run_region_generation_job(void* argument) {
+    region_generation_work_t* work = argument;
+
+    size_t region_index;
+    while ((region_index = atomic_fetch_add(&work->next_region_index, 1)) < work->num_regions) {
+        work->uniform_voxel_types[region_index] = generate_region_on_cpu(work->region_positions[region_index], work->voxels[region_index]);
+    }
+}
+
+static void run_column_surface_job(void* argument) {
+    column_surface_work_t* work = argument;
+
+    size_t column_index;
+    while ((column_index = atomic_fetch_add(&work->next_column_index, 1)) < work->num_columns) {
+        ivec3s column_position = work->column_positions[column_index];
+        get_region_column_surface_heights(column_position.x, column_position.z, &work->min_heights[column_index], &work->max_heights[column_index]);
+    }
+}
+
+void get_region_columns_surface_heights(size_t num_columns, const ivec3s column_positions[], int32_t min_heights[], int32_t max_heights[]) {
+    column_surface_work_t work = {
+        .num_columns = num_columns,
+        .column_positions = column_positions,
+        .min_heights = min_heights,
+        .max_heights = max_heights
+    };
+    atomic_init(&work.next_column_index, 0);
+
+    run_shared_work_jobs(num_columns, run_column_surface_job, &work);
+}
+
+void generate_regions_on_cpu(size_t num_regions, const ivec3s region_positions[], region_voxels_t* const voxels[], uint8_t uniform_voxel_types[]) {
+    region_generation_work_t work = {
+        .num_regions = num_regions,
+        .region_positions = region_positions,
+        .voxels = voxels,
+        .uniform_voxel_types = uniform_voxel_types
+    };
+    atomic_init(&work.next_region_index, 0);
+
+    run_shared_work_jobs(num_regions, run_region_generation_job, &work);
+}
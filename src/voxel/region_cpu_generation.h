@@ -0,0 +1,16 @@
+#pragma once
+#include "voxel/region_voxels.h"
+#include <cglm/types-struct.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Gives the same voxels as region_generation.comp, region positions are in regions rather than voxels
+// Returns the voxel type if every voxel has the same one, NULL_UINT8 otherwise
+uint8_t generate_region_on_cpu(ivec3s region_position, region_voxels_t* voxels);
+// Lowest and highest terrain surface over a column of regions, in voxels, voxels above it are air and voxels below it dirt
+void get_region_column_surface_heights(int32_t column_x, int32_t column_z, int32_t* min_height, int32_t* max_height);
+// Same for many columns, spread over the job workers, blocks until all of them are done
+// Column positions are region positions whose y is ignored
+void get_region_columns_surface_heights(size_t num_columns, const ivec3s column_positions[], int32_t min_heights[], int32_t max_heights[]);
+// Spreads the regions over the job workers and blocks until all of them are generated
+void generate_regions_on_cpu(size_t num_regions, const ivec3s region_positions[], region_voxels_t* const voxels[], uint8_t uniform_voxel_types[]);
@@ -0,0 +1,232 @@
+#include "region_cpu_meshing.h"
+#include "gfx/region_face.h"
+#include "job.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAS_MESHING_BATCHES
+#include <immintrin.h>
+#endif
+
+typedef struct {
+    size_t num_regions;
+    const region_voxels_t* const* voxels;
+    const region_voxels_t* (*neighbour_voxels)[NUM_CUBE_VOXEL_FACES];
+    region_face_t* const* faces;
+    region_cpu_mesh_info_t* mesh_infos;
+    atomic_size_t next_region_index;
+} region_meshing_work_t;
+
+// Every row of voxels along x fits into one mask
+static_assert(REGION_SIZE == 32);
+static_assert(VOXEL_TYPE_AIR == 0);
+
+// Bit x of a row is set if the voxel is solid
+typedef struct {
+    // Indexed by z + 1 and y + 1, the border rows belong to the neighbours across the y and z faces
+    uint32_t rows[REGION_SIZE + 2][REGION_SIZE + 2];
+    // Only bit 31 or bit 0 respectively, set if the voxel across the x face at the end of the row is solid
+    uint32_t px_border_bits[REGION_SIZE][REGION_SIZE];
+    uint32_t nx_border_bits[REGION_SIZE][REGION_SIZE];
+} region_occupancy_t;
+
+// Portable fallback, also what the vector kernels are checked against
+#define MESHING_BATCH_SIZE 1
+#define BATCH_FUNCTION(NAME) NAME##_scalar
+#define mask_batch_t uint32_t
+#define batch_load(P) (*(P))
+#define batch_store(P, A) (*(P) = (A))
+#define batch_or(A, B) ((A) | (B))
+#define batch_andnot(A, B) (~(A) & (B))
+#define batch_shl(A, N) ((A) << (N))
+#define batch_shr(A, N) ((A) >> (N))
+static uint32_t get_row_occupancy_scalar(const uint8_t row[REGION_SIZE]) {
+    uint32_t occupancy = 0;
+    for (uint32_t x = 0; x < REGION_SIZE; x++) {
+        occupancy |= (uint32_t) (row[x] != VOXEL_TYPE_AIR) << x;
+    }
+    return occupancy;
+}
+#include "region_cpu_meshing_batch.h"
+#undef MESHING_BATCH_SIZE
+#undef BATCH_FUNCTION
+#undef mask_batch_t
+#undef batch_load
+#undef batch_store
+#undef batch_or
+#undef batch_andnot
+#undef batch_shl
+#undef batch_shr
+
+#if defined(HAS_MESHING_BATCHES)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#define MESHING_BATCH_SIZE 4
+#define BATCH_FUNCTION(NAME) NAME##_sse2
+#define mask_batch_t __m128i
+#define batch_load(P) _mm_loadu_si128((const __m128i*) (P))
+#define batch_store(P, A) _mm_storeu_si128((__m128i*) (P), (A))
+#define batch_or _mm_or_si128
+#define batch_andnot _mm_andnot_si128
+#define batch_shl _mm_slli_epi32
+#define batch_shr _mm_srli_epi32
+static uint32_t get_row_occupancy_sse2(const uint8_t row[REGION_SIZE]) {
+    __m128i zero = _mm_setzero_si128();
+    uint32_t low_air_bits = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) row), zero));
+    uint32_t high_air_bits = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) &row[16]), zero));
+    return ~(low_air_bits | (high_air_bits << 16));
+}
+#include "region_cpu_meshing_batch.h"
+#undef MESHING_BATCH_SIZE
+#undef BATCH_FUNCTION
+#undef mask_batch_t
+#undef batch_load
+#undef batch_store
+#undef batch_or
+#undef batch_andnot
+#undef batch_shl
+#undef batch_shr
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define MESHING_BATCH_SIZE 8
+#define BATCH_FUNCTION(NAME) NAME##_avx2
+#define mask_batch_t __m256i
+#define batch_load(P) _mm256_loadu_si256((const __m256i*) (P))
+#define batch_store(P, A) _mm256_storeu_si256((__m256i*) (P), (A))
+#define batch_or _mm256_or_si256
+#define batch_andnot _mm256_andnot_si256
+#define batch_shl _mm256_slli_epi32
+#define batch_shr _mm256_srli_epi32
+static uint32_t get_row_occupancy_avx2(const uint8_t row[REGION_SIZE]) {
+    __m256i is_air = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) row), _mm256_setzero_si256());
+    return ~(uint32_t) _mm256_movemask_epi8(is_air);
+}
+#include "region_cpu_meshing_batch.h"
+#undef MESHING_BATCH_SIZE
+#undef BATCH_FUNCTION
+#undef mask_batch_t
+#undef batch_load
+#undef batch_store
+#undef batch_or
+#undef batch_andnot
+#undef batch_shl
+#undef batch_shr
+#pragma GCC pop_options
+#endif
+
+simd_level_t get_region_cpu_meshing_simd_level(void) {
+    simd_level_t level = get_simd_level();
+    if (level >= simd_level_avx2) {
+        return simd_level_avx2;
+    }
+    if (level >= simd_level_sse2) {
+        return simd_level_sse2;
+    }
+    return simd_level_none;
+}
+
+void mesh_region_on_cpu(const region_voxels_t* voxels, const region_voxels_t* neighbour_voxels[NUM_CUBE_VOXEL_FACES], region_face_t faces[MAX_NUM_REGION_CPU_MESHING_FACES], region_cpu_mesh_info_t* mesh_info) {
+    uint32_t visible_faces[NUM_CUBE_VOXEL_FACES][REGION_SIZE][REGION_SIZE];
+    switch (get_region_cpu_meshing_simd_level()) {
+#if defined(HAS_MESHING_BATCHES)
+        case simd_level_avx2:
+            get_visible_region_faces_avx2(voxels, neighbour_voxels, visible_faces);
+            break;
+        case simd_level_sse2:
+            get_visible_region_faces_sse2(voxels, neighbour_voxels, visible_faces);
+            break;
+#endif
+        default:
+            get_visible_region_faces_scalar(voxels, neighbour_voxels, visible_faces);
+            break;
+    }
+
+    *mesh_info = (region_cpu_mesh_info_t) {
+        .box_min = { UINT32_MAX, UINT32_MAX, UINT32_MAX }
+    };
+
+    uint32_t num_faces = 0;
+    for (uint32_t z = 0; z < REGION_SIZE; z++) {
+        for (uint32_t y = 0; y < REGION_SIZE; y++) {
+            uint32_t visible_voxels = 0;
+            for (uint32_t face_index = 0; face_index < NUM_CUBE_VOXEL_FACES; face_index++) {
+                visible_voxels |= visible_faces[face_index][z][y];
+            }
+            if (visible_voxels == 0) {
+                continue;
+            }
+
+            uint32_t row_min[3] = { (uint32_t) __builtin_ctz(visible_voxels), y, z };
+            uint32_t row_max[3] = { REGION_SIZE - 1 - (uint32_t) __builtin_clz(visible_voxels), y, z };
+            for (size_t axis = 0; axis < 3; axis++) {
+                if (row_min[axis] < mesh_info->box_min[axis]) {
+                    mesh_info->box_min[axis] = row_min[axis];
+                }
+                if (row_max[axis] > mesh_info->box_max[axis]) {
+                    mesh_info->box_max[axis] = row_max[axis];
+                }
+            }
+
+            uint32_t position_data = (y << REGION_FACE_Y_OFFSET) | (z << REGION_FACE_Z_OFFSET);
+            for (uint32_t face_index = 0; face_index < NUM_CUBE_VOXEL_FACES; face_index++) {
+                for (uint32_t bits = visible_faces[face_index][z][y]; bits != 0; bits &= bits - 1) {
+                    uint32_t x = (uint32_t) __builtin_ctz(bits);
+                    // Faces are never merged, so the stored width and height are zero
+                    faces[num_faces++] = (region_face_t) {
+                        .position_data = position_data | (x << REGION_FACE_X_OFFSET) | (face_index << REGION_FACE_INDEX_OFFSET),
+                        .face_data = (uint32_t) voxels->types[z][y][x] << REGION_FACE_VOXEL_TYPE_OFFSET
+                    };
+                }
+            }
+        }
+    }
+
+    mesh_info->num_faces = num_faces;
+}
+
+static void run_region_meshing_job(void* argument) {
+    region_meshing_work_t* work = argument;
+
+    size_t region_index;
+    while ((region_index = atomic_fetch_add(&work->next_region_index, 1)) < work->num_regions) {
+        mesh_region_on_cpu(work->voxels[region_index], work->neighbour_voxels[region_index], work->faces[region_index], &work->mesh_infos[region_index]);
+    }
+}
+
+void mesh_regions_on_cpu(size_t num_regions, const region_voxels_t* const voxels[], const region_voxels_t* neighbour_voxels[][NUM_CUBE_VOXEL_FACES], region_face_t* const faces[], region_cpu_mesh_info_t mesh_infos[]) {
+    region_meshing_work_t work = {
+        .num_regions = num_regions,
+        .voxels = voxels,
+        .neighbour_voxels = neighbour_voxels,
+        .faces = faces,
+        .mesh_infos = mesh_infos
+    };
+    atomic_init(&work.next_region_index, 0);
+
+    run_shared_work_jobs(num_regions, run_region_meshing_job, &work);
+}
+
+static int compare_faces(const void* a, const void* b) {
+    const region_face_t* face_a = a;
+    const region_face_t* face_b = b;
+    if (face_a->position_data != face_b->position_data) {
+        return face_a->position_data > face_b->position_data ? 1 : -1;
+    }
+    return (face_a->face_data > face_b->face_data) - (face_a->face_data < face_b->face_data);
+}
+
+bool are_region_faces_equal(size_t num_faces_a, region_face_t faces_a[], size_t num_faces_b, region_face_t faces_b[]) {
+    if (num_faces_a != num_faces_b) {
+        return false;
+    }
+
+    qsort(faces_a, num_faces_a, sizeof(region_face_t), compare_faces);
+    qsort(faces_b, num_faces_b, sizeof(region_face_t), compare_faces);
+
+    return memcmp(faces_a, faces_b, num_faces_a * sizeof(region_face_t)) == 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "gfx/region_meshing_compute_pipeline.h"
+#include "simd.h"
+#include "voxel/region.h"
+#include "voxel/region_voxels.h"
+#include "voxel/voxel.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A checkerboard of solid voxels shows every face of half the voxels
+#define MAX_NUM_REGION_CPU_MESHING_FACES (REGION_SIZE * REGION_SIZE * REGION_SIZE / 2 * NUM_CUBE_VOXEL_FACES)
+
+typedef struct {
+    uint32_t num_faces;
+    // Region-local bounds of the voxels with visible faces, only valid if there are faces
+    uint32_t box_min[3];
+    uint32_t box_max[3];
+} region_cpu_mesh_info_t;
+
+// Emits the same faces as the naive GPU mesher, in a different order, and doesn't touch any global state so it may run on any thread
+// Neighbours are NULL when they haven't been generated, faces towards them are hidden just like on the GPU
+void mesh_region_on_cpu(const region_voxels_t* voxels, const region_voxels_t* neighbour_voxels[NUM_CUBE_VOXEL_FACES], region_face_t faces[MAX_NUM_REGION_CPU_MESHING_FACES], region_cpu_mesh_info_t* mesh_info);
+// Spreads the regions over the job workers and blocks until all of them are meshed, every region needs its own face array
+void mesh_regions_on_cpu(size_t num_regions, const region_voxels_t* const voxels[], const region_voxels_t* neighbour_voxels[][NUM_CUBE_VOXEL_FACES], region_face_t* const faces[], region_cpu_mesh_info_t mesh_infos[]);
+// Sorts both face lists in place, so meshes emitted in any order can be checked against each other
+bool are_region_faces_equal(size_t num_faces_a, region_face_t faces_a[], size_t num_faces_b, region_face_t faces_b[]);
+// The instruction set mesh_region_on_cpu runs on
+simd_level_t get_region_cpu_meshing_simd_level(void);
@@ -0,0 +1,50 @@
+// Occupancy and face visibility kernels of region_cpu_meshing.c, which includes this once per instruction set with the batch type, operations, get_row_occupancy and BATCH_FUNCTION naming defined
+// There's deliberately no #pragma once
+
+// Missing neighbours count as solid, which hides every face towards them
+static void BATCH_FUNCTION(build_occupancy)(const region_voxels_t* voxels, const region_voxels_t* neighbour_voxels[NUM_CUBE_VOXEL_FACES], region_occupancy_t* occupancy) {
+    const region_voxels_t* px_voxels = neighbour_voxels[VOXEL_PX_FACE_INDEX];
+    const region_voxels_t* nx_voxels = neighbour_voxels[VOXEL_NX_FACE_INDEX];
+    const region_voxels_t* py_voxels = neighbour_voxels[VOXEL_PY_FACE_INDEX];
+    const region_voxels_t* ny_voxels = neighbour_voxels[VOXEL_NY_FACE_INDEX];
+    const region_voxels_t* pz_voxels = neighbour_voxels[VOXEL_PZ_FACE_INDEX];
+    const region_voxels_t* nz_voxels = neighbour_voxels[VOXEL_NZ_FACE_INDEX];
+
+    for (uint32_t z = 0; z < REGION_SIZE; z++) {
+        for (uint32_t y = 0; y < REGION_SIZE; y++) {
+            occupancy->rows[z + 1][y + 1] = BATCH_FUNCTION(get_row_occupancy)(voxels->types[z][y]);
+            occupancy->px_border_bits[z][y] = px_voxels == NULL || px_voxels->types[z][y][0] != VOXEL_TYPE_AIR ? 1u << (REGION_SIZE - 1) : 0;
+            occupancy->nx_border_bits[z][y] = nx_voxels == NULL || nx_voxels->types[z][y][REGION_SIZE - 1] != VOXEL_TYPE_AIR ? 1u : 0;
+        }
+        occupancy->rows[z + 1][REGION_SIZE + 1] = py_voxels == NULL ? UINT32_MAX : BATCH_FUNCTION(get_row_occupancy)(py_voxels->types[z][0]);
+        occupancy->rows[z + 1][0] = ny_voxels == NULL ? UINT32_MAX : BATCH_FUNCTION(get_row_occupancy)(ny_voxels->types[z][REGION_SIZE - 1]);
+    }
+
+    for (uint32_t y = 0; y < REGION_SIZE; y++) {
+        occupancy->rows[REGION_SIZE + 1][y + 1] = pz_voxels == NULL ? UINT32_MAX : BATCH_FUNCTION(get_row_occupancy)(pz_voxels->types[0][y]);
+        occupancy->rows[0][y + 1] = nz_voxels == NULL ? UINT32_MAX : BATCH_FUNCTION(get_row_occupancy)(nz_voxels->types[REGION_SIZE - 1][y]);
+    }
+}
+
+// Bit x of each mask is set if the voxel's face is visible, a batch covers consecutive rows along y
+static void BATCH_FUNCTION(get_visible_faces)(const region_occupancy_t* occupancy, uint32_t visible_faces[NUM_CUBE_VOXEL_FACES][REGION_SIZE][REGION_SIZE]) {
+    for (uint32_t z = 0; z < REGION_SIZE; z++) {
+        for (uint32_t y = 0; y < REGION_SIZE; y += MESHING_BATCH_SIZE) {
+            mask_batch_t row = batch_load(&occupancy->rows[z + 1][y + 1]);
+
+            // A face is visible if its voxel is solid and the voxel across it isn't
+            batch_store(&visible_faces[VOXEL_PX_FACE_INDEX][z][y], batch_andnot(batch_or(batch_shr(row, 1), batch_load(&occupancy->px_border_bits[z][y])), row));
+            batch_store(&visible_faces[VOXEL_NX_FACE_INDEX][z][y], batch_andnot(batch_or(batch_shl(row, 1), batch_load(&occupancy->nx_border_bits[z][y])), row));
+            batch_store(&visible_faces[VOXEL_PY_FACE_INDEX][z][y], batch_andnot(batch_load(&occupancy->rows[z + 1][y + 2]), row));
+            batch_store(&visible_faces[VOXEL_NY_FACE_INDEX][z][y], batch_andnot(batch_load(&occupancy->rows[z + 1][y]), row));
+            batch_store(&visible_faces[VOXEL_PZ_FACE_INDEX][z][y], batch_andnot(batch_load(&occupancy->rows[z + 2][y + 1]), row));
+            batch_store(&visible_faces[VOXEL_NZ_FACE_INDEX][z][y], batch_andnot(batch_load(&occupancy->rows[z][y + 1]), row));
+        }
+    }
+}
+
+static void BATCH_FUNCTION(get_visible_region_faces)(const region_voxels_t* voxels, const region_voxels_t* neighbour_voxels[NUM_CUBE_VOXEL_FACES], uint32_t visible_faces[NUM_CUBE_VOXEL_FACES][REGION_SIZE][REGION_SIZE]) {
+    region_occupancy_t occupancy;
+    BATCH_FUNCTION(build_occupancy)(voxels, neighbour_voxels, &occupancy);
+    BATCH_FUNCTION(get_visible_faces)(&occupancy, visible_faces);
+}
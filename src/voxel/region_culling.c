@@ -0,0 +1,199 @@
+#include "region_culling.h"
+#include "voxel/region_management.h"
+#include <math.h>
+#include <stdalign.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAS_CULLING_BATCHES
+#include <immintrin.h>
+#endif
+
+// Widest batch of any instruction set, the boxes are padded to a multiple of it
+#define MAX_CULLING_BATCH_SIZE 8
+
+#define NUM_PADDED_REGIONS (((NUM_REGIONS) + MAX_CULLING_BATCH_SIZE - 1) / MAX_CULLING_BATCH_SIZE * MAX_CULLING_BATCH_SIZE)
+
+#define NUM_FRUSTUM_PLANES 6
+
+region_culling_counters_t region_culling_counters;
+
+// Structure of arrays so a batch of regions is tested with one load per bound, padding regions are never reported as visible
+static struct {
+    alignas(32) float min_x[NUM_PADDED_REGIONS];
+    alignas(32) float min_y[NUM_PADDED_REGIONS];
+    alignas(32) float min_z[NUM_PADDED_REGIONS];
+    alignas(32) float max_x[NUM_PADDED_REGIONS];
+    alignas(32) float max_y[NUM_PADDED_REGIONS];
+    alignas(32) float max_z[NUM_PADDED_REGIONS];
+} boxes;
+
+void set_region_culling_box(size_t region_index, vec3s box_min, vec3s box_max) {
+    boxes.min_x[region_index] = box_min.x;
+    boxes.min_y[region_index] = box_min.y;
+    boxes.min_z[region_index] = box_min.z;
+    boxes.max_x[region_index] = box_max.x;
+    boxes.max_y[region_index] = box_max.y;
+    boxes.max_z[region_index] = box_max.z;
+}
+
+// Planes point inwards and are extracted for clip space depth from 0 to 1
+static void get_frustum_planes(mat4s view_projection, vec4s planes[NUM_FRUSTUM_PLANES]) {
+    vec4s rows[4];
+    for (size_t i = 0; i < 4; i++) {
+        rows[i] = (vec4s) {{ view_projection.raw[0][i], view_projection.raw[1][i], view_projection.raw[2][i], view_projection.raw[3][i] }};
+    }
+
+    for (size_t i = 0; i < 4; i++) {
+        planes[0].raw[i] = rows[3].raw[i] + rows[0].raw[i];
+        planes[1].raw[i] = rows[3].raw[i] - rows[0].raw[i];
+        planes[2].raw[i] = rows[3].raw[i] + rows[1].raw[i];
+        planes[3].raw[i] = rows[3].raw[i] - rows[1].raw[i];
+        planes[4].raw[i] = rows[2].raw[i];
+        planes[5].raw[i] = rows[3].raw[i] - rows[2].raw[i];
+    }
+}
+
+typedef void (*test_batch_function_t)(const vec4s planes[NUM_FRUSTUM_PLANES], vec3s camera_position, float max_distance, size_t first_region_index, uint32_t* frustum_mask, uint32_t* distance_mask);
+
+// Portable fallback, tests a single region
+static void test_batch_scalar(const vec4s planes[NUM_FRUSTUM_PLANES], vec3s camera_position, float max_distance, size_t first_region_index, uint32_t* frustum_mask, uint32_t* distance_mask) {
+    size_t i = first_region_index;
+    bool is_inside = true;
+    for (size_t j = 0; j < NUM_FRUSTUM_PLANES; j++) {
+        vec4s plane = planes[j];
+        float distance = plane.w + fmaxf(plane.x * boxes.min_x[i], plane.x * boxes.max_x[i]) + fmaxf(plane.y * boxes.min_y[i], plane.y * boxes.max_y[i]) + fmaxf(plane.z * boxes.min_z[i], plane.z * boxes.max_z[i]);
+        is_inside = is_inside && distance >= 0.0f;
+    }
+    *frustum_mask = is_inside;
+
+    float delta_x = fmaxf(fmaxf(boxes.min_x[i] - camera_position.x, camera_position.x - boxes.max_x[i]), 0.0f);
+    float delta_y = fmaxf(fmaxf(boxes.min_y[i] - camera_position.y, camera_position.y - boxes.max_y[i]), 0.0f);
+    float delta_z = fmaxf(fmaxf(boxes.min_z[i] - camera_position.z, camera_position.z - boxes.max_z[i]), 0.0f);
+    *distance_mask = delta_x * delta_x + delta_y * delta_y + delta_z * delta_z <= max_distance * max_distance;
+}
+
+#if defined(HAS_CULLING_BATCHES)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#define BATCH_FUNCTION(NAME) NAME##_sse2
+#define float_batch_t __m128
+#define batch_load _mm_load_ps
+#define batch_set1 _mm_set1_ps
+#define batch_add _mm_add_ps
+#define batch_sub _mm_sub_ps
+#define batch_mul _mm_mul_ps
+#define batch_max _mm_max_ps
+#define batch_and _mm_and_ps
+#define batch_cmpge _mm_cmpge_ps
+#define batch_cmple _mm_cmple_ps
+#define batch_movemask _mm_movemask_ps
+#include "region_culling_batch.h"
+#undef BATCH_FUNCTION
+#undef float_batch_t
+#undef batch_load
+#undef batch_set1
+#undef batch_add
+#undef batch_sub
+#undef batch_mul
+#undef batch_max
+#undef batch_and
+#undef batch_cmpge
+#undef batch_cmple
+#undef batch_movemask
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx")
+#define BATCH_FUNCTION(NAME) NAME##_avx
+#define float_batch_t __m256
+#define batch_load _mm256_load_ps
+#define batch_set1 _mm256_set1_ps
+#define batch_add _mm256_add_ps
+#define batch_sub _mm256_sub_ps
+#define batch_mul _mm256_mul_ps
+#define batch_max _mm256_max_ps
+#define batch_and _mm256_and_ps
+#define batch_cmpge(A, B) _mm256_cmp_ps((A), (B), _CMP_GE_OQ)
+#define batch_cmple(A, B) _mm256_cmp_ps((A), (B), _CMP_LE_OQ)
+#define batch_movemask _mm256_movemask_ps
+#include "region_culling_batch.h"
+#undef BATCH_FUNCTION
+#undef float_batch_t
+#undef batch_load
+#undef batch_set1
+#undef batch_add
+#undef batch_sub
+#undef batch_mul
+#undef batch_max
+#undef batch_and
+#undef batch_cmpge
+#undef batch_cmple
+#undef batch_movemask
+#pragma GCC pop_options
+#endif
+
+simd_level_t get_region_culling_simd_level(void) {
+    simd_level_t level = get_simd_level();
+    if (level >= simd_level_avx) {
+        return simd_level_avx;
+    }
+    if (level >= simd_level_sse2) {
+        return simd_level_sse2;
+    }
+    return simd_level_none;
+}
+
+size_t cull_regions(mat4s view_projection, vec3s camera_position, float max_distance, uint32_t visible_region_indices[NUM_REGIONS]) {
+    vec4s planes[NUM_FRUSTUM_PLANES];
+    get_frustum_planes(view_projection, planes);
+
+    region_culling_counters = (region_culling_counters_t) { 0 };
+
+    size_t batch_size = 1;
+    test_batch_function_t test_batch = test_batch_scalar;
+    switch (get_region_culling_simd_level()) {
+#if defined(HAS_CULLING_BATCHES)
+        case simd_level_avx:
+            batch_size = 8;
+            test_batch = test_batch_avx;
+            break;
+        case simd_level_sse2:
+            batch_size = 4;
+            test_batch = test_batch_sse2;
+            break;
+#endif
+        default:
+            break;
+    }
+
+    size_t num_visible_regions = 0;
+    for (size_t first_region_index = 0; first_region_index < NUM_REGIONS; first_region_index += batch_size) {
+        uint32_t frustum_mask;
+        uint32_t distance_mask;
+        test_batch(planes, camera_position, max_distance, first_region_index, &frustum_mask, &distance_mask);
+
+        for (size_t i = 0; i < batch_size && first_region_index + i < NUM_REGIONS; i++) {
+            size_t region_index = first_region_index + i;
+
+            // Boxes of regions without faces are stale
+            if (region_render_pipeline_infos[region_index].num_faces == 0) {
+                continue;
+            }
+            region_culling_counters.num_tested_regions++;
+
+            if ((distance_mask & (1u << i)) == 0) {
+                region_culling_counters.num_distance_culled_regions++;
+                continue;
+            }
+            if ((frustum_mask & (1u << i)) == 0) {
+                region_culling_counters.num_frustum_culled_regions++;
+                continue;
+            }
+
+            visible_region_indices[num_visible_regions++] = (uint32_t) region_index;
+        }
+    }
+
+    return num_visible_regions;
+}
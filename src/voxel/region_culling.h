@@ -0,0 +1,22 @@
+#pragma once
+#include "simd.h"
+#include "voxel/region_management.h"
+#include <cglm/types-struct.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t num_tested_regions;
+    uint32_t num_frustum_culled_regions;
+    uint32_t num_distance_culled_regions;
+} region_culling_counters_t;
+
+// Counters of the last cull_regions call
+extern region_culling_counters_t region_culling_counters;
+
+// World space bounds of the region's visible faces
+void set_region_culling_box(size_t region_index, vec3s box_min, vec3s box_max);
+// Writes the indices of the regions with faces that intersect the view frustum and lie within max_distance of the camera, returns their count
+size_t cull_regions(mat4s view_projection, vec3s camera_position, float max_distance, uint32_t visible_region_indices[NUM_REGIONS]);
+// The instruction set cull_regions tests its batches with
+simd_level_t get_region_culling_simd_level(void);
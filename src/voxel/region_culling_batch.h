@@ -0,0 +1,36 @@
+// Batch kernel of region_culling.c, which includes this once per instruction set with the batch type, operations and BATCH_FUNCTION naming defined
+// There's deliberately no #pragma once
+
+// Bit i of the result is set if region first_region_index + i is in the frustum, or within max_distance respectively
+static void BATCH_FUNCTION(test_batch)(const vec4s planes[NUM_FRUSTUM_PLANES], vec3s camera_position, float max_distance, size_t first_region_index, uint32_t* frustum_mask, uint32_t* distance_mask) {
+    float_batch_t min_x = batch_load(&boxes.min_x[first_region_index]);
+    float_batch_t min_y = batch_load(&boxes.min_y[first_region_index]);
+    float_batch_t min_z = batch_load(&boxes.min_z[first_region_index]);
+    float_batch_t max_x = batch_load(&boxes.max_x[first_region_index]);
+    float_batch_t max_y = batch_load(&boxes.max_y[first_region_index]);
+    float_batch_t max_z = batch_load(&boxes.max_z[first_region_index]);
+
+    // A box is outside a plane if even its corner furthest along the plane's normal is behind it
+    float_batch_t zero = batch_set1(0.0f);
+    float_batch_t is_inside = batch_cmpge(zero, zero);
+    for (size_t i = 0; i < NUM_FRUSTUM_PLANES; i++) {
+        float_batch_t a = batch_set1(planes[i].x);
+        float_batch_t b = batch_set1(planes[i].y);
+        float_batch_t c = batch_set1(planes[i].z);
+        float_batch_t distance = batch_set1(planes[i].w);
+        distance = batch_add(distance, batch_max(batch_mul(a, min_x), batch_mul(a, max_x)));
+        distance = batch_add(distance, batch_max(batch_mul(b, min_y), batch_mul(b, max_y)));
+        distance = batch_add(distance, batch_max(batch_mul(c, min_z), batch_mul(c, max_z)));
+        is_inside = batch_and(is_inside, batch_cmpge(distance, zero));
+    }
+    *frustum_mask = (uint32_t) batch_movemask(is_inside);
+
+    float_batch_t camera_x = batch_set1(camera_position.x);
+    float_batch_t camera_y = batch_set1(camera_position.y);
+    float_batch_t camera_z = batch_set1(camera_position.z);
+    float_batch_t delta_x = batch_max(batch_max(batch_sub(min_x, camera_x), batch_sub(camera_x, max_x)), zero);
+    float_batch_t delta_y = batch_max(batch_max(batch_sub(min_y, camera_y), batch_sub(camera_y, max_y)), zero);
+    float_batch_t delta_z = batch_max(batch_max(batch_sub(min_z, camera_z), batch_sub(camera_z, max_z)), zero);
+    float_batch_t distance_squared = batch_add(batch_add(batch_mul(delta_x, delta_x), batch_mul(delta_y, delta_y)), batch_mul(delta_z, delta_z));
+    *distance_mask = (uint32_t) batch_movemask(batch_cmple(distance_squared, batch_set1(max_distance * max_distance)));
+}
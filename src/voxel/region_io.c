@@ -0,0 +1,230 @@
+#include "region_io.h"
+#include "result.h"
+#include "util.h"
+#include "voxel/region_store.h"
+#include <cglm/types-struct.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+// Single producer single consumer, the producer only writes the tail and the consumer only writes the head
+typedef struct {
+    region_io_request_t requests[REGION_IO_QUEUE_CAPACITY];
+    atomic_size_t head;
+    atomic_size_t tail;
+} request_ring_t;
+
+typedef struct {
+    region_io_completion_t completions[REGION_IO_QUEUE_CAPACITY];
+    atomic_size_t head;
+    atomic_size_t tail;
+} completion_ring_t;
+
+typedef struct {
+    region_file_location_t location;
+    size_t request_index;
+} region_io_batch_entry_t;
+
+static pthread_t thread;
+static bool is_thread_started;
+static sem_t wake_semaphore;
+static atomic_bool should_stop;
+
+// Filled by the main thread and drained by the I/O thread
+static request_ring_t request_ring;
+// Filled by the I/O thread and drained by the main thread
+static completion_ring_t completion_ring;
+// Only touched by the main thread, neither ring can overflow while it stays within the capacity
+static size_t num_requests_in_flight;
+
+// Only touched by the I/O thread
+static region_io_request_t batch_requests[REGION_IO_QUEUE_CAPACITY];
+static region_io_batch_entry_t batch_entries[REGION_IO_QUEUE_CAPACITY];
+
+static void complete_request(const region_io_request_t* request, region_io_status_t status, uint8_t uniform_voxel_type, result_t result) {
+    size_t tail = atomic_load_explicit(&completion_ring.tail, memory_order_relaxed);
+    completion_ring.completions[tail % REGION_IO_QUEUE_CAPACITY] = (region_io_completion_t) {
+        .type = request->type,
+        .user_index = request->user_index,
+        .status = status,
+        .uniform_voxel_type = uniform_voxel_type,
+        .result = result
+    };
+    atomic_store_explicit(&completion_ring.tail, tail + 1, memory_order_release);
+}
+
+static int compare_batch_entries(const void* a, const void* b) {
+    const region_io_batch_entry_t* entry_a = a;
+    const region_io_batch_entry_t* entry_b = b;
+    ivec3s position_a = entry_a->location.file_position;
+    ivec3s position_b = entry_b->location.file_position;
+    if (position_a.x != position_b.x) {
+        return position_a.x < position_b.x ? -1 : 1;
+    }
+    if (position_a.y != position_b.y) {
+        return position_a.y < position_b.y ? -1 : 1;
+    }
+    if (position_a.z != position_b.z) {
+        return position_a.z < position_b.z ? -1 : 1;
+    }
+    return (entry_a->request_index > entry_b->request_index) - (entry_a->request_index < entry_b->request_index);
+}
+
+static void process_file_requests(region_io_request_type_t type, size_t num_entries, const region_io_batch_entry_t entries[]) {
+    ivec3s file_position = entries[0].location.file_position;
+
+    size_t entry_indices[REGION_IO_QUEUE_CAPACITY];
+    region_voxels_t* voxels[REGION_IO_QUEUE_CAPACITY];
+    for (size_t i = 0; i < num_entries; i++) {
+        entry_indices[i] = entries[i].location.entry_index;
+        voxels[i] = batch_requests[entries[i].request_index].voxels;
+    }
+
+    result_t result;
+    bool is_found[REGION_IO_QUEUE_CAPACITY];
+    uint8_t uniform_voxel_types[REGION_IO_QUEUE_CAPACITY];
+    switch (type) {
+        case region_io_request_type_load:
+            result = load_regions_from_file(file_position, num_entries, entry_indices, voxels, is_found, uniform_voxel_types);
+            break;
+        case region_io_request_type_save:
+            result = save_regions_to_file(file_position, num_entries, entry_indices, (const region_voxels_t* const*) voxels);
+            break;
+    }
+
+    for (size_t i = 0; i < num_entries; i++) {
+        const region_io_request_t* request = &batch_requests[entries[i].request_index];
+        if (result != result_success) {
+            complete_request(request, region_io_status_failed, NULL_UINT8, result);
+        } else if (type == region_io_request_type_save) {
+            complete_request(request, region_io_status_saved, NULL_UINT8, result_success);
+        } else if (is_found[i]) {
+            complete_request(request, region_io_status_loaded, uniform_voxel_types[i], result_success);
+        } else {
+            complete_request(request, region_io_status_missing, NULL_UINT8, result_success);
+        }
+    }
+}
+
+// Regions sharing a file are read or written together, since a file holds neighbouring regions
+static void process_requests(region_io_request_type_t type, size_t num_requests) {
+    size_t num_entries = 0;
+    for (size_t i = 0; i < num_requests; i++) {
+        const region_io_request_t* request = &batch_requests[i];
+        if (request->type != type) {
+            continue;
+        }
+        if (type == region_io_request_type_load && request->is_cancelled != NULL && atomic_load(request->is_cancelled)) {
+            complete_request(request, region_io_status_cancelled, NULL_UINT8, result_success);
+            continue;
+        }
+        batch_entries[num_entries++] = (region_io_batch_entry_t) {
+            .location = get_region_file_location(request->region_position),
+            .request_index = i
+        };
+    }
+
+    qsort(batch_entries, num_entries, sizeof(region_io_batch_entry_t), compare_batch_entries);
+
+    size_t file_start = 0;
+    while (file_start < num_entries) {
+        ivec3s file_position = batch_entries[file_start].location.file_position;
+        size_t file_end = file_start + 1;
+        while (file_end < num_entries && file_end - file_start < REGION_FILE_NUM_REGIONS) {
+            ivec3s position = batch_entries[file_end].location.file_position;
+            if (position.x != file_position.x || position.y != file_position.y || position.z != file_position.z) {
+                break;
+            }
+            file_end++;
+        }
+
+        process_file_requests(type, file_end - file_start, &batch_entries[file_start]);
+        file_start = file_end;
+    }
+}
+
+static void* run_region_io(void* argument) {
+    (void) argument;
+
+    while (true) {
+        sem_wait(&wake_semaphore);
+
+        // Everything queued so far forms one batch, regardless of how many wakes it took
+        size_t head = atomic_load_explicit(&request_ring.head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&request_ring.tail, memory_order_acquire);
+        size_t num_requests = tail - head;
+        for (size_t i = 0; i < num_requests; i++) {
+            batch_requests[i] = request_ring.requests[(head + i) % REGION_IO_QUEUE_CAPACITY];
+        }
+        atomic_store_explicit(&request_ring.head, tail, memory_order_release);
+
+        if (num_requests == 0 && atomic_load(&should_stop)) {
+            break;
+        }
+
+        // Saves go first so loads of the same regions see them
+        process_requests(region_io_request_type_save, num_requests);
+        process_requests(region_io_request_type_load, num_requests);
+    }
+
+    return NULL;
+}
+
+result_t init_region_io(void) {
+    if (sem_init(&wake_semaphore, 0, 0) != 0) {
+        return result_synchronization_primitive_create_failure;
+    }
+
+    if (pthread_create(&thread, NULL, run_region_io, NULL) != 0) {
+        return result_thread_create_failure;
+    }
+    is_thread_started = true;
+
+    return result_success;
+}
+
+size_t queue_region_io_requests(size_t num_requests, const region_io_request_t requests[]) {
+    if (num_requests > REGION_IO_QUEUE_CAPACITY - num_requests_in_flight) {
+        num_requests = REGION_IO_QUEUE_CAPACITY - num_requests_in_flight;
+    }
+    if (num_requests == 0) {
+        return 0;
+    }
+
+    size_t tail = atomic_load_explicit(&request_ring.tail, memory_order_relaxed);
+    for (size_t i = 0; i < num_requests; i++) {
+        request_ring.requests[(tail + i) % REGION_IO_QUEUE_CAPACITY] = requests[i];
+    }
+    atomic_store_explicit(&request_ring.tail, tail + num_requests, memory_order_release);
+    num_requests_in_flight += num_requests;
+
+    sem_post(&wake_semaphore);
+
+    return num_requests;
+}
+
+bool poll_region_io_completion(region_io_completion_t* completion) {
+    size_t head = atomic_load_explicit(&completion_ring.head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&completion_ring.tail, memory_order_acquire)) {
+        return false;
+    }
+
+    *completion = completion_ring.completions[head % REGION_IO_QUEUE_CAPACITY];
+    atomic_store_explicit(&completion_ring.head, head + 1, memory_order_release);
+    num_requests_in_flight--;
+
+    return true;
+}
+
+void term_region_io(void) {
+    if (is_thread_started) {
+        atomic_store(&should_stop, true);
+        sem_post(&wake_semaphore);
+        pthread_join(thread, NULL);
+    }
+
+    sem_destroy(&wake_semaphore);
+}
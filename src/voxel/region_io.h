@@ -0,0 +1,55 @@
+#pragma once
+#include "result.h"
+#include "voxel/region_voxels.h"
+#include <cglm/types-struct.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Requests beyond this many without a polled completion are refused
+#define REGION_IO_QUEUE_CAPACITY 2048
+
+typedef enum {
+    region_io_request_type_load,
+    region_io_request_type_save
+} region_io_request_type_t;
+
+typedef enum {
+    region_io_status_loaded,
+    // The region was never saved
+    region_io_status_missing,
+    region_io_status_saved,
+    region_io_status_cancelled,
+    region_io_status_failed
+} region_io_status_t;
+
+typedef struct {
+    region_io_request_type_t type;
+    ivec3s region_position;
+    // Loads decode straight into it and saves encode from it, so it's owned by the I/O thread until the completion is polled
+    region_voxels_t* voxels;
+    // Passed back with the completion
+    size_t user_index;
+    // Loads whose flag is set before their file is read complete as cancelled, may be NULL
+    const atomic_bool* is_cancelled;
+} region_io_request_t;
+
+typedef struct {
+    region_io_request_type_t type;
+    size_t user_index;
+    region_io_status_t status;
+    // Only set for loaded regions, NULL_UINT8 unless every voxel has the same type
+    uint8_t uniform_voxel_type;
+    // Only set for failed requests
+    result_t result;
+} region_io_completion_t;
+
+// Starts the thread that does all region file reads and writes from then on
+result_t init_region_io(void);
+// Never blocks, returns how many of the requests were queued in order
+size_t queue_region_io_requests(size_t num_requests, const region_io_request_t requests[]);
+// Never blocks, false once every finished request has been polled
+bool poll_region_io_completion(region_io_completion_t* completion);
+// Finishes the queued requests first, so no save is lost
+void term_region_io(void);
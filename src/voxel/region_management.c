@@ -1,75 +1,437 @@
 #include "region_management.h"
 #include "gfx/default.h"
 #include "gfx/gfx.h"
+#include "gfx/region_culling_compute_pipeline.h"
 #include "gfx/region_generation_compute_pipeline.h"
 #include "gfx/region_meshing_compute_pipeline.h"
 #include "gfx/region_render_pipeline.h"
+#include "gfx/upload.h"
+#include "gfx/gfx_util.h"
 #include "result.h"
+#include "util.h"
 #include "voxel/region.h"
+#include "voxel/region_cpu_generation.h"
+#include "voxel/voxel.h"
+#include <assert.h>
+#include <math.h>
 #include <vulkan/vulkan_core.h>
 
 region_mesh_state_t region_mesh_states[NUM_REGIONS];
+ivec3s region_positions[NUM_REGIONS];
+uint8_t region_lods[NUM_REGIONS];
+uint8_t region_uniform_voxel_types[NUM_REGIONS];
 
 region_allocation_info_t region_allocation_infos[NUM_REGIONS];
 region_generation_compute_pipeline_info_t region_generation_compute_pipeline_infos[NUM_REGIONS];
 region_meshing_compute_pipeline_info_t region_meshing_compute_pipeline_infos[NUM_REGIONS];
 region_render_pipeline_info_t region_render_pipeline_infos[NUM_REGIONS];
 
+VkDescriptorSet region_meshing_compute_pipeline_face_descriptor_set;
+VkDescriptorSet region_render_pipeline_descriptor_sets[NUM_FRAMES_IN_FLIGHT];
+VkDescriptorSet region_culling_compute_pipeline_descriptor_sets[NUM_FRAMES_IN_FLIGHT];
+
+VkBuffer region_face_buffer;
+
 static VkDescriptorPool descriptor_pool;
 
+typedef struct {
+    VkImage image;
+    VmaAllocation allocation;
+    // Covers every level of detail
+    VkImageView image_view;
+    // One per level of detail, only created for images that are written as storage images
+    VkImageView level_image_views[NUM_REGION_LODS];
+} voxel_image_t;
+
+// Only the first num_voxel_images are created, depending on the generation mode
+static voxel_image_t voxel_images[MAX_NUM_REGION_VOXEL_IMAGES];
+static uint32_t free_voxel_image_indices[MAX_NUM_REGION_VOXEL_IMAGES];
+static uint32_t num_voxel_images;
+static size_t num_free_voxel_images;
+
+// Indexed by voxel type, sampled in place of the voxel images of uniform regions
+static voxel_image_t uniform_voxel_images[NUM_VOXEL_TYPES];
+
+static VmaAllocation face_buffer_allocation;
+static VmaVirtualBlock face_virtual_block;
+
+typedef struct {
+    VmaVirtualAllocation allocation;
+    VkDeviceSize num_faces;
+    uint32_t num_remaining_frames;
+} deferred_face_free_t;
+
+static deferred_face_free_t deferred_face_frees[MAX_NUM_DEFERRED_REGION_FACE_FREES];
+static size_t num_deferred_face_frees;
+static VkDeviceSize num_deferred_free_faces;
+
+// One copy per frame in flight, so a frame's copy is only rewritten once the frame that last read it has finished
+static VkBuffer region_info_buffers[NUM_FRAMES_IN_FLIGHT];
+static VmaAllocation region_info_buffer_allocations[NUM_FRAMES_IN_FLIGHT];
+
+static bool has_center_region_position;
+static ivec3s center_region_position;
+// Camera position of the last update, slots still in use then are placed from it by later updates
+static vec3s placement_camera_position;
+static bool are_region_placements_pending;
+
+// Terrain surface bounds of the resident columns, in voxels
+typedef struct {
+    bool is_valid;
+    // Measured in regions
+    int32_t x;
+    int32_t z;
+    int32_t min_surface_height;
+    int32_t max_surface_height;
+} region_column_t;
+
+// Only evaluated for CPU generation, GPU generation finds the uniform regions from its own voxel type ranges
+static region_column_t region_columns[NUM_REGION_COLUMNS];
+static region_generation_mode_t region_generation_mode;
+static region_meshing_mode_t region_meshing_mode;
+
 typedef struct {
     ivec3s region_position;
 } region_uniform_t;
 
-result_t init_region_management(void) {
+// Matches region_info_t in region_info.glsl
+typedef struct {
+    ivec3s region_position;
+    uint32_t first_face;
+    uint32_t num_faces;
+    uint32_t lod;
+    uint32_t padding[2];
+} region_info_t;
+
+static_assert(sizeof(region_info_t) == 32);
+// Every region info can be uploaded in a single flush
+static_assert(NUM_REGIONS <= MAX_NUM_PENDING_UPLOAD_COPIES);
+
+// Host copies of the region infos, dirty ones are uploaded into a frame's copy before its command buffer so frames in flight never see a partial update
+static region_info_t region_infos[NUM_REGIONS];
+static bool region_info_dirty_flags[NUM_FRAMES_IN_FLIGHT][NUM_REGIONS];
+
+// Indexed by voxel face index
+static const ivec3s face_normals[NUM_CUBE_VOXEL_FACES] = {
+    {{ 1, 0, 0 }},
+    {{ -1, 0, 0 }},
+    {{ 0, 1, 0 }},
+    {{ 0, -1, 0 }},
+    {{ 0, 0, 1 }},
+    {{ 0, 0, -1 }}
+};
+
+// Every frame's copy is stale until that frame's next upload
+static void mark_region_info_dirty(size_t region_index) {
+    for (size_t i = 0; i < NUM_FRAMES_IN_FLIGHT; i++) {
+        region_info_dirty_flags[i][region_index] = true;
+    }
+}
+
+static int32_t positive_mod_int32(int32_t value, int32_t divisor) {
+    int32_t mod = value % divisor;
+    return mod < 0 ? mod + divisor : mod;
+}
+
+static size_t get_region_column_index(ivec3s region_position) {
+    return (size_t) (positive_mod_int32(region_position.x, REGION_VIEW_DIAMETER) * REGION_VIEW_DIAMETER + positive_mod_int32(region_position.z, REGION_VIEW_DIAMETER));
+}
+
+// Region positions are mapped onto the slots toroidally, so moving the camera by one region only recycles the slots of a single layer of regions
+// The regions of a column are adjacent
+static size_t get_region_index(ivec3s region_position) {
+    return get_region_column_index(region_position) * REGION_VIEW_HEIGHT + (size_t) positive_mod_int32(region_position.y, REGION_VIEW_HEIGHT);
+}
+
+static result_t create_voxel_image(VkImageUsageFlags usage, voxel_image_t* voxel_image) {
+    if (vmaCreateImage(allocator, &(VkImageCreateInfo) {
+        DEFAULT_VK_IMAGE,
+        .imageType = VK_IMAGE_TYPE_3D,
+        .format = VK_FORMAT_R8_UINT,
+        .extent = { REGION_SIZE, REGION_SIZE, REGION_SIZE },
+        .mipLevels = NUM_REGION_LODS,
+        .usage = usage
+    }, &device_allocation_create_info, &voxel_image->image, &voxel_image->allocation, NULL) != VK_SUCCESS) {
+        return result_image_create_failure;
+    }
+
+    if (vkCreateImageView(device, &(VkImageViewCreateInfo) {
+        DEFAULT_VK_IMAGE_VIEW,
+        .image = voxel_image->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_3D,
+        .format = VK_FORMAT_R8_UINT,
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.levelCount = NUM_REGION_LODS
+    }, NULL, &voxel_image->image_view) != VK_SUCCESS) {
+        return result_image_view_create_failure;
+    }
+
+    for (uint32_t level = 0; level < NUM_REGION_LODS; level++) {
+        voxel_image->level_image_views[level] = VK_NULL_HANDLE;
+        if ((usage & VK_IMAGE_USAGE_STORAGE_BIT) == 0) {
+            continue;
+        }
+
+        if (vkCreateImageView(device, &(VkImageViewCreateInfo) {
+            DEFAULT_VK_IMAGE_VIEW,
+            .image = voxel_image->image,
+            .viewType = VK_IMAGE_VIEW_TYPE_3D,
+            .format = VK_FORMAT_R8_UINT,
+            .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .subresourceRange.baseMipLevel = level
+        }, NULL, &voxel_image->level_image_views[level]) != VK_SUCCESS) {
+            return result_image_view_create_failure;
+        }
+    }
+
+    return result_success;
+}
+
+static void destroy_voxel_image(const voxel_image_t* voxel_image) {
+    for (uint32_t level = 0; level < NUM_REGION_LODS; level++) {
+        vkDestroyImageView(device, voxel_image->level_image_views[level], NULL);
+    }
+    vkDestroyImageView(device, voxel_image->image_view, NULL);
+    vmaDestroyImage(allocator, voxel_image->image, voxel_image->allocation);
+}
+
+static result_t init_uniform_voxel_images(VkCommandBuffer command_buffer, VkFence command_fence) {
+    result_t result;
+
+    for (size_t i = 0; i < NUM_VOXEL_TYPES; i++) {
+        if ((result = create_voxel_image(VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, &uniform_voxel_images[i])) != result_success) {
+            return result;
+        }
+    }
+
+    if (vkBeginCommandBuffer(command_buffer, &(VkCommandBufferBeginInfo) {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+    }) != VK_SUCCESS) {
+        return result_command_buffer_begin_failure;
+    }
+
+    VkImageMemoryBarrier image_memory_barriers[NUM_VOXEL_TYPES];
+    for (size_t i = 0; i < NUM_VOXEL_TYPES; i++) {
+        image_memory_barriers[i] = (VkImageMemoryBarrier) {
+            DEFAULT_VK_IMAGE_MEMORY_BARRIER,
+            .image = uniform_voxel_images[i].image,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .subresourceRange.levelCount = NUM_REGION_LODS
+        };
+    }
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, NUM_VOXEL_TYPES, image_memory_barriers);
+
+    for (uint32_t voxel_type = 0; voxel_type < NUM_VOXEL_TYPES; voxel_type++) {
+        vkCmdClearColorImage(command_buffer, uniform_voxel_images[voxel_type].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &(VkClearColorValue) { .uint32 = { voxel_type } }, 1, &(VkImageSubresourceRange) {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = NUM_REGION_LODS,
+            .layerCount = 1
+        });
+
+        image_memory_barriers[voxel_type].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        image_memory_barriers[voxel_type].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        image_memory_barriers[voxel_type].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        image_memory_barriers[voxel_type].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, NUM_VOXEL_TYPES, image_memory_barriers);
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        return result_command_buffer_end_failure;
+    }
+
+    if ((result = submit_and_wait(compute_queue, command_buffer, command_fence)) != result_success) {
+        return result;
+    }
+    if ((result = reset_command_processing(command_buffer, command_fence)) != result_success) {
+        return result;
+    }
+
+    return result_success;
+}
+
+result_t init_region_management(VkCommandBuffer command_buffer, VkFence command_fence, uint32_t graphics_queue_family_index, uint32_t compute_queue_family_index, uint32_t transfer_queue_family_index, region_generation_mode_t generation_mode, region_meshing_mode_t meshing_mode) {
+    region_generation_mode = generation_mode;
+    region_meshing_mode = meshing_mode;
+
+    result_t result;
+
     if (vkCreateDescriptorPool(device, &(VkDescriptorPoolCreateInfo) {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .poolSizeCount = 3,
-        .pPoolSizes = (VkDescriptorPoolSize[3]) {
+        .poolSizeCount = 4,
+        .pPoolSizes = (VkDescriptorPoolSize[4]) {
             {
                 .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-                .descriptorCount = 1
+                .descriptorCount = NUM_REGIONS * (1 + NUM_REGION_LODS)
             },
             {
                 .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                .descriptorCount = 1
+                .descriptorCount = NUM_REGIONS * NUM_REGION_MESHING_VOXEL_SAMPLERS
             },
             {
                 .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                .descriptorCount = 1
+                .descriptorCount = NUM_REGIONS
+            },
+            {
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1 + 3 * NUM_FRAMES_IN_FLIGHT
             }
         },
-        .maxSets = NUM_REGIONS * 3
+        .maxSets = NUM_REGIONS * 2 + 1 + 2 * NUM_FRAMES_IN_FLIGHT
     }, NULL, &descriptor_pool) != VK_SUCCESS) {
         return result_descriptor_pool_create_failure;
     }
 
-    for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
-        region_allocation_info_t* allocation_info = &region_allocation_infos[region_index];
+    // Written by meshing on the compute queue, or by uploads on the transfer queue when the CPU meshes, while frames read it on the graphics queue
+    // It's shared instead of having ownership transferred per batch, the compute queue also reads it back to verify meshes
+    uint32_t face_buffer_queue_family_indices[3] = { graphics_queue_family_index };
+    uint32_t num_face_buffer_queue_families = 1;
+    if (compute_queue_family_index != graphics_queue_family_index) {
+        face_buffer_queue_family_indices[num_face_buffer_queue_families++] = compute_queue_family_index;
+    }
+    if (meshing_mode == region_meshing_mode_cpu && transfer_queue_family_index != graphics_queue_family_index && transfer_queue_family_index != compute_queue_family_index) {
+        face_buffer_queue_family_indices[num_face_buffer_queue_families++] = transfer_queue_family_index;
+    }
+    bool is_face_buffer_shared = num_face_buffer_queue_families > 1;
+    if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
+        DEFAULT_VK_STORAGE_BUFFER,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .size = REGION_FACE_BUFFER_NUM_FACES * sizeof(region_face_t),
+        .sharingMode = is_face_buffer_shared ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = is_face_buffer_shared ? num_face_buffer_queue_families : 0,
+        .pQueueFamilyIndices = face_buffer_queue_family_indices
+    }, &device_allocation_create_info, &region_face_buffer, &face_buffer_allocation, NULL) != VK_SUCCESS) {
+        return result_buffer_create_failure;
+    }
 
-        // Set these to NULL so we don't accidentally destroy NULL buffers later
-        allocation_info->vertex_buffer = NULL;
-        allocation_info->vertex_buffer_allocation = NULL;
+    if (vmaCreateVirtualBlock(&(VmaVirtualBlockCreateInfo) {
+        .size = REGION_FACE_BUFFER_NUM_FACES * sizeof(region_face_t)
+    }, &face_virtual_block) != VK_SUCCESS) {
+        return result_virtual_block_create_failure;
+    }
 
-        if (vmaCreateImage(allocator, &(VkImageCreateInfo) {
-            DEFAULT_VK_IMAGE,
-            .imageType = VK_IMAGE_TYPE_3D,
-            .format = VK_FORMAT_R8_UINT,
-            .extent = { REGION_SIZE, REGION_SIZE, REGION_SIZE },
-            .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
-        }, &device_allocation_create_info, &allocation_info->voxel_image, &allocation_info->voxel_image_allocation, NULL) != VK_SUCCESS) {
-            return result_image_create_failure;
+    // Uploaded on the transfer queue while frames read it on the graphics queue
+    bool is_region_info_buffer_shared = graphics_queue_family_index != transfer_queue_family_index;
+    for (size_t i = 0; i < NUM_FRAMES_IN_FLIGHT; i++) {
+        if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
+            DEFAULT_VK_STORAGE_BUFFER,
+            .size = NUM_REGIONS * sizeof(region_info_t),
+            .sharingMode = is_region_info_buffer_shared ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = is_region_info_buffer_shared ? 2 : 0,
+            .pQueueFamilyIndices = (uint32_t[2]) { graphics_queue_family_index, transfer_queue_family_index }
+        }, &device_allocation_create_info, &region_info_buffers[i], &region_info_buffer_allocations[i], NULL) != VK_SUCCESS) {
+            return result_buffer_create_failure;
         }
+    }
 
-        if (vkCreateImageView(device, &(VkImageViewCreateInfo) {
-            DEFAULT_VK_IMAGE_VIEW,
-            .image = allocation_info->voxel_image,
-            .viewType = VK_IMAGE_VIEW_TYPE_3D,
-            .format = VK_FORMAT_R8_UINT,
-            .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT
-        }, NULL, &allocation_info->voxel_image_view) != VK_SUCCESS) {
-            return result_image_view_create_failure;
+    if (vkAllocateDescriptorSets(device, &(VkDescriptorSetAllocateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &region_meshing_compute_pipeline_face_set_layout
+    }, &region_meshing_compute_pipeline_face_descriptor_set) != VK_SUCCESS) {
+        return result_descriptor_sets_allocate_failure;
+    }
+
+    VkDescriptorSetLayout render_set_layouts[NUM_FRAMES_IN_FLIGHT];
+    VkDescriptorSetLayout culling_set_layouts[NUM_FRAMES_IN_FLIGHT];
+    for (size_t i = 0; i < NUM_FRAMES_IN_FLIGHT; i++) {
+        render_set_layouts[i] = region_render_pipeline_set_layout;
+        culling_set_layouts[i] = region_culling_compute_pipeline_set_layout;
+    }
+
+    if (vkAllocateDescriptorSets(device, &(VkDescriptorSetAllocateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptor_pool,
+        .descriptorSetCount = NUM_FRAMES_IN_FLIGHT,
+        .pSetLayouts = render_set_layouts
+    }, region_render_pipeline_descriptor_sets) != VK_SUCCESS) {
+        return result_descriptor_sets_allocate_failure;
+    }
+
+    if (vkAllocateDescriptorSets(device, &(VkDescriptorSetAllocateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptor_pool,
+        .descriptorSetCount = NUM_FRAMES_IN_FLIGHT,
+        .pSetLayouts = culling_set_layouts
+    }, region_culling_compute_pipeline_descriptor_sets) != VK_SUCCESS) {
+        return result_descriptor_sets_allocate_failure;
+    }
+
+    VkDescriptorBufferInfo face_buffer_info = {
+        .buffer = region_face_buffer,
+        .offset = 0,
+        .range = VK_WHOLE_SIZE
+    };
+
+    vkUpdateDescriptorSets(device, 1, &(VkWriteDescriptorSet) {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = region_meshing_compute_pipeline_face_descriptor_set,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .pBufferInfo = &face_buffer_info
+    }, 0, NULL);
+
+    for (size_t i = 0; i < NUM_FRAMES_IN_FLIGHT; i++) {
+        VkDescriptorBufferInfo region_info_buffer_info = {
+            .buffer = region_info_buffers[i],
+            .offset = 0,
+            .range = VK_WHOLE_SIZE
+        };
+
+        vkUpdateDescriptorSets(device, 3, (VkWriteDescriptorSet[3]) {
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = region_render_pipeline_descriptor_sets[i],
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &region_info_buffer_info
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = region_render_pipeline_descriptor_sets[i],
+                .dstBinding = 1,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &face_buffer_info
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = region_culling_compute_pipeline_descriptor_sets[i],
+                .dstBinding = 0,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &region_info_buffer_info
+            }
+        }, 0, NULL);
+    }
+
+    if ((result = init_uniform_voxel_images(command_buffer, command_fence)) != result_success) {
+        return result;
+    }
+
+    // Popped from the end, so the lowest indices are handed out first
+    uint32_t num_mode_voxel_images = generation_mode == region_generation_mode_gpu ? NUM_GPU_REGION_VOXEL_IMAGES : NUM_CPU_REGION_VOXEL_IMAGES;
+    for (uint32_t i = 0; i < num_mode_voxel_images; i++) {
+        if ((result = create_voxel_image(VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, &voxel_images[i])) != result_success) {
+            return result;
         }
+        num_voxel_images++;
+        free_voxel_image_indices[num_free_voxel_images++] = num_mode_voxel_images - 1 - i;
+    }
+
+    for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
+        region_allocation_info_t* allocation_info = &region_allocation_infos[region_index];
+
+        allocation_info->face_allocation = VK_NULL_HANDLE;
+        allocation_info->voxel_image_index = NULL_UINT32;
 
         if (vmaCreateBuffer(allocator, &(VkBufferCreateInfo) {
             DEFAULT_VK_UNIFORM_BUFFER,
@@ -77,44 +439,30 @@ result_t init_region_management(void) {
         }, &shared_write_allocation_create_info, &allocation_info->uniform_buffer, &allocation_info->uniform_buffer_allocation, NULL) != VK_SUCCESS) {
             return result_buffer_create_failure;
         }
-        
-        region_uniform_t* uniform;
-        if (vmaMapMemory(allocator, allocation_info->uniform_buffer_allocation, (void*) &uniform) != VK_SUCCESS) {
-            return result_memory_map_failure;
-        }
-        
-        *uniform = (region_uniform_t) {
-            .region_position = (ivec3s) {{ (int32_t) REGION_SIZE * (int32_t) (region_index / 16), 0, (int32_t) REGION_SIZE * (int32_t) (region_index % 16) }}
-        };
-
-        vmaUnmapMemory(allocator, allocation_info->uniform_buffer_allocation);
 
         if (vkAllocateDescriptorSets(device, &(VkDescriptorSetAllocateInfo) {
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
             .descriptorPool = descriptor_pool,
-            .descriptorSetCount = 3,
-            .pSetLayouts = (VkDescriptorSetLayout[3]) {
+            .descriptorSetCount = 2,
+            .pSetLayouts = (VkDescriptorSetLayout[2]) {
                 region_generation_compute_pipeline_set_layout,
-                region_meshing_compute_pipeline_set_layout,
-                region_render_pipeline_set_layout
+                region_meshing_compute_pipeline_set_layout
             }
         }, allocation_info->descriptor_sets) != VK_SUCCESS) {
             return result_descriptor_sets_allocate_failure;
         }
 
-        vkUpdateDescriptorSets(device, 4, (VkWriteDescriptorSet[4]) {
-            {
-                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                .dstSet = allocation_info->descriptor_sets[0],
-                .dstBinding = 0,
-                .dstArrayElement = 0,
-                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-                .descriptorCount = 1,
-                .pImageInfo = &(VkDescriptorImageInfo) {
-                    .imageView = allocation_info->voxel_image_view,
-                    .imageLayout = VK_IMAGE_LAYOUT_GENERAL
-                }
-            },
+        // Samplers start out as the air image and are rewritten whenever the region is meshed, the storage image is written once the region gets a voxel image
+        VkDescriptorImageInfo voxel_image_infos[NUM_REGION_MESHING_VOXEL_SAMPLERS];
+        for (size_t i = 0; i < NUM_REGION_MESHING_VOXEL_SAMPLERS; i++) {
+            voxel_image_infos[i] = (VkDescriptorImageInfo) {
+                .sampler = voxel_sampler,
+                .imageView = uniform_voxel_images[VOXEL_TYPE_AIR].image_view,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            };
+        }
+
+        vkUpdateDescriptorSets(device, 2, (VkWriteDescriptorSet[2]) {
             {
                 .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                 .dstSet = allocation_info->descriptor_sets[0],
@@ -134,29 +482,14 @@ result_t init_region_management(void) {
                 .dstBinding = 0,
                 .dstArrayElement = 0,
                 .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                .descriptorCount = 1,
-                .pImageInfo = &(VkDescriptorImageInfo) {
-                    .sampler = voxel_sampler,
-                    .imageView = allocation_info->voxel_image_view,
-                    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                }
-            },
-            {
-                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                .dstSet = allocation_info->descriptor_sets[2],
-                .dstBinding = 0,
-                .dstArrayElement = 0,
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                .descriptorCount = 1,
-                .pBufferInfo = &(VkDescriptorBufferInfo) {
-                    .buffer = allocation_info->uniform_buffer,
-                    .offset = 0,
-                    .range = sizeof(region_uniform_t)
-                }
+                .descriptorCount = NUM_REGION_MESHING_VOXEL_SAMPLERS,
+                .pImageInfo = voxel_image_infos
             }
         }, 0, NULL);
 
-        region_mesh_states[region_index] = region_mesh_state_await_meshing_compute;
+        // Slots are given a region position by the first call to update_region_management
+        region_mesh_states[region_index] = region_mesh_state_unused;
+        region_uniform_voxel_types[region_index] = NULL_UINT8;
 
         region_generation_compute_pipeline_info_t* generation_compute_pipeline_info = &region_generation_compute_pipeline_infos[region_index];
         region_meshing_compute_pipeline_info_t* meshing_compute_pipeline_info = &region_meshing_compute_pipeline_infos[region_index];
@@ -164,20 +497,511 @@ result_t init_region_management(void) {
 
         *generation_compute_pipeline_info = (region_generation_compute_pipeline_info_t) {
             .descriptor_set = allocation_info->descriptor_sets[0],
-            .voxel_image = allocation_info->voxel_image
+            .voxel_image = VK_NULL_HANDLE
         };
         *meshing_compute_pipeline_info = (region_meshing_compute_pipeline_info_t) {
-            .descriptor_set = allocation_info->descriptor_sets[1]
+            .descriptor_set = allocation_info->descriptor_sets[1],
+            .voxel_image_view = VK_NULL_HANDLE
         };
         *render_pipeline_info = (region_render_pipeline_info_t) {
-            .descriptor_set = allocation_info->descriptor_sets[2],
-            .vertex_buffer = NULL
+            .first_face = 0,
+            .num_faces = 0
         };
     }
 
     return result_success;
 }
 
+static void release_region_voxel_image(size_t region_index) {
+    region_allocation_info_t* allocation_info = &region_allocation_infos[region_index];
+    if (allocation_info->voxel_image_index == NULL_UINT32) {
+        return;
+    }
+
+    free_voxel_image_indices[num_free_voxel_images++] = allocation_info->voxel_image_index;
+    allocation_info->voxel_image_index = NULL_UINT32;
+
+    region_generation_compute_pipeline_infos[region_index].voxel_image = VK_NULL_HANDLE;
+    region_meshing_compute_pipeline_infos[region_index].voxel_image_view = VK_NULL_HANDLE;
+}
+
+bool acquire_region_voxel_image(size_t region_index) {
+    region_allocation_info_t* allocation_info = &region_allocation_infos[region_index];
+    if (allocation_info->voxel_image_index != NULL_UINT32) {
+        return true;
+    }
+    if (num_free_voxel_images == 0) {
+        return false;
+    }
+
+    uint32_t voxel_image_index = free_voxel_image_indices[--num_free_voxel_images];
+    const voxel_image_t* voxel_image = &voxel_images[voxel_image_index];
+    allocation_info->voxel_image_index = voxel_image_index;
+    region_uniform_voxel_types[region_index] = NULL_UINT8;
+
+    region_generation_compute_pipeline_infos[region_index].voxel_image = voxel_image->image;
+    region_meshing_compute_pipeline_infos[region_index].voxel_image_view = voxel_image->image_view;
+
+    VkDescriptorImageInfo level_image_infos[NUM_REGION_LODS];
+    for (uint32_t level = 0; level < NUM_REGION_LODS; level++) {
+        level_image_infos[level] = (VkDescriptorImageInfo) {
+            .imageView = voxel_image->level_image_views[level],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+        };
+    }
+
+    // Generation writes level 0 and downsampling the levels after it
+    vkUpdateDescriptorSets(device, 2, (VkWriteDescriptorSet[2]) {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = allocation_info->descriptor_sets[0],
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .pImageInfo = &level_image_infos[0]
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = allocation_info->descriptor_sets[0],
+            .dstBinding = 2,
+            .dstArrayElement = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = NUM_REGION_LODS,
+            .pImageInfo = level_image_infos
+        }
+    }, 0, NULL);
+
+    return true;
+}
+
+bool has_free_region_voxel_image(void) {
+    return num_free_voxel_images > 0;
+}
+
+void set_region_uniform_voxel_type(size_t region_index, uint8_t voxel_type) {
+    assert(voxel_type < NUM_VOXEL_TYPES);
+
+    release_region_voxel_image(region_index);
+    region_uniform_voxel_types[region_index] = voxel_type;
+    region_meshing_compute_pipeline_infos[region_index].voxel_image_view = uniform_voxel_images[voxel_type].image_view;
+}
+
+bool is_region_mesh_empty(size_t region_index) {
+    uint8_t voxel_type = region_uniform_voxel_types[region_index];
+    if (voxel_type == NULL_UINT8) {
+        return false;
+    }
+    if (voxel_type == VOXEL_TYPE_AIR) {
+        return true;
+    }
+
+    // Faces between solid voxels are hidden whatever their types, and missing neighbours hide border faces until they're generated
+    int32_t first_y = (int32_t) REGION_SIZE * region_positions[region_index].y;
+    for (uint32_t face_index = 0; face_index < NUM_CUBE_VOXEL_FACES; face_index++) {
+        size_t neighbour_region_index;
+        if (!get_generated_region_neighbour_index(region_index, face_index, &neighbour_region_index)) {
+            continue;
+        }
+        uint8_t neighbour_voxel_type = region_uniform_voxel_types[neighbour_region_index];
+        if (neighbour_voxel_type != NULL_UINT8 && neighbour_voxel_type != VOXEL_TYPE_AIR) {
+            continue;
+        }
+
+        // Highest neighbour voxel touching the region
+        int32_t border_max_y = first_y + (int32_t) REGION_SIZE - 1;
+        if (face_index == VOXEL_PY_FACE_INDEX) {
+            border_max_y = first_y + (int32_t) REGION_SIZE;
+        } else if (face_index == VOXEL_NY_FACE_INDEX) {
+            border_max_y = first_y - 1;
+        }
+        if (region_generation_mode != region_generation_mode_cpu || border_max_y >= region_columns[get_region_column_index(region_positions[neighbour_region_index])].min_surface_height) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static result_t place_region(size_t region_index, ivec3s region_position, uint8_t lod) {
+    region_allocation_info_t* allocation_info = &region_allocation_infos[region_index];
+
+    result_t result;
+    if ((result = free_region_faces(region_index)) != result_success) {
+        return result;
+    }
+
+    // Nothing reads the previous voxels anymore, see place_regions
+    release_region_voxel_image(region_index);
+    region_uniform_voxel_types[region_index] = NULL_UINT8;
+    region_meshing_compute_pipeline_infos[region_index].voxel_image_view = VK_NULL_HANDLE;
+
+    ivec3s voxel_region_position = {{ (int32_t) REGION_SIZE * region_position.x, (int32_t) REGION_SIZE * region_position.y, (int32_t) REGION_SIZE * region_position.z }};
+
+    region_uniform_t* uniform;
+    if (vmaMapMemory(allocator, allocation_info->uniform_buffer_allocation, (void*) &uniform) != VK_SUCCESS) {
+        return result_memory_map_failure;
+    }
+    
+    *uniform = (region_uniform_t) {
+        .region_position = voxel_region_position
+    };
+
+    vmaUnmapMemory(allocator, allocation_info->uniform_buffer_allocation);
+
+    region_infos[region_index].region_position = voxel_region_position;
+    mark_region_info_dirty(region_index);
+
+    region_positions[region_index] = region_position;
+    region_lods[region_index] = lod;
+    region_mesh_states[region_index] = region_mesh_state_await_generation;
+
+    // Voxels above the surface are air and voxels below it dirt, so these regions don't need generating
+    // GPU generated regions are all dispatched instead, the ones found to be uniform give their voxel images back once generation completes
+    if (region_generation_mode != region_generation_mode_cpu) {
+        return result_success;
+    }
+    const region_column_t* column = &region_columns[get_region_column_index(region_position)];
+    int32_t first_y = voxel_region_position.y;
+    if (first_y > column->max_surface_height) {
+        set_region_uniform_voxel_type(region_index, VOXEL_TYPE_AIR);
+    } else if (first_y + (int32_t) REGION_SIZE - 1 < column->min_surface_height) {
+        set_region_uniform_voxel_type(region_index, VOXEL_TYPE_DIRT);
+    }
+
+    return result_success;
+}
+
+// To the nearest point of the region, measured in voxels
+static float get_region_distance(ivec3s region_position, vec3s camera_position) {
+    float squared_distance = 0.0f;
+    for (size_t axis = 0; axis < 3; axis++) {
+        float region_min = (float) ((int32_t) REGION_SIZE * region_position.raw[axis]);
+        float region_max = region_min + (float) REGION_SIZE;
+        float offset = camera_position.raw[axis] < region_min ? region_min - camera_position.raw[axis] : (camera_position.raw[axis] > region_max ? camera_position.raw[axis] - region_max : 0.0f);
+        squared_distance += offset * offset;
+    }
+    return sqrtf(squared_distance);
+}
+
+// The CPU mesher doesn't downsample, so regions it meshes stay at full detail
+static uint8_t get_region_lod(float distance) {
+    uint8_t lod = 0;
+    if (region_meshing_mode == region_meshing_mode_cpu) {
+        return lod;
+    }
+    float lod_distance = REGION_LOD_DISTANCE;
+    while (lod + 1u < NUM_REGION_LODS && distance >= lod_distance) {
+        lod++;
+        lod_distance *= 2.0f;
+    }
+    return lod;
+}
+
+// Faces of regions being meshed depend on the levels of detail of the region and its neighbours, so those stay until the faces are written
+// Regions written by a batch still in flight stay too, since meshing them again would rewrite a descriptor set the batch has bound
+static bool can_switch_region_lod(size_t region_index) {
+    if (region_mesh_states[region_index] == region_mesh_state_await_face_buffer_creation || is_region_in_meshing_batch(region_index)) {
+        return false;
+    }
+    for (uint32_t face_index = 0; face_index < NUM_CUBE_VOXEL_FACES; face_index++) {
+        size_t neighbour_region_index;
+        if (get_generated_region_neighbour_index(region_index, face_index, &neighbour_region_index) && region_mesh_states[neighbour_region_index] == region_mesh_state_await_face_buffer_creation) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void update_region_lods(vec3s camera_position) {
+    for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
+        if (region_mesh_states[region_index] == region_mesh_state_unused) {
+            continue;
+        }
+
+        // Levels of detail the region would have if it were closer or further by the hysteresis margin
+        float distance = get_region_distance(region_positions[region_index], camera_position);
+        uint8_t coarser_lod = get_region_lod(distance / (1.0f + REGION_LOD_HYSTERESIS));
+        uint8_t finer_lod = get_region_lod(distance * (1.0f + REGION_LOD_HYSTERESIS));
+
+        uint8_t lod = region_lods[region_index];
+        if (coarser_lod > lod) {
+            lod = coarser_lod;
+        } else if (finer_lod < lod) {
+            lod = finer_lod;
+        }
+        if (lod == region_lods[region_index] || !can_switch_region_lod(region_index)) {
+            continue;
+        }
+        region_lods[region_index] = lod;
+
+        if (region_mesh_states[region_index] == region_mesh_state_completed) {
+            region_mesh_states[region_index] = region_mesh_state_await_meshing_compute;
+        }
+
+        // Neighbours close their border with faces where their levels of detail differ, unless the region looks the same at every level
+        if (region_uniform_voxel_types[region_index] != NULL_UINT8) {
+            continue;
+        }
+        for (uint32_t face_index = 0; face_index < NUM_CUBE_VOXEL_FACES; face_index++) {
+            size_t neighbour_region_index;
+            if (get_generated_region_neighbour_index(region_index, face_index, &neighbour_region_index) && region_mesh_states[neighbour_region_index] == region_mesh_state_completed) {
+                region_mesh_states[neighbour_region_index] = region_mesh_state_await_meshing_compute;
+            }
+        }
+    }
+}
+
+// Every column that came into view has its surface evaluated on the job workers at once, a whole row of them whenever the camera crosses a region border
+static void update_region_columns(void) {
+    size_t num_stale_columns = 0;
+    ivec3s stale_column_positions[NUM_REGION_COLUMNS];
+    for (int32_t x = center_region_position.x - REGION_VIEW_RADIUS; x <= center_region_position.x + REGION_VIEW_RADIUS; x++) {
+        for (int32_t z = center_region_position.z - REGION_VIEW_RADIUS; z <= center_region_position.z + REGION_VIEW_RADIUS; z++) {
+            const region_column_t* column = &region_columns[get_region_column_index((ivec3s) {{ x, 0, z }})];
+            if (!column->is_valid || column->x != x || column->z != z) {
+                stale_column_positions[num_stale_columns++] = (ivec3s) {{ x, 0, z }};
+            }
+        }
+    }
+    if (num_stale_columns == 0) {
+        return;
+    }
+
+    int32_t min_surface_heights[NUM_REGION_COLUMNS];
+    int32_t max_surface_heights[NUM_REGION_COLUMNS];
+    get_region_columns_surface_heights(num_stale_columns, stale_column_positions, min_surface_heights, max_surface_heights);
+
+    for (size_t i = 0; i < num_stale_columns; i++) {
+        ivec3s column_position = stale_column_positions[i];
+        region_columns[get_region_column_index(column_position)] = (region_column_t) {
+            .is_valid = true,
+            .x = column_position.x,
+            .z = column_position.z,
+            .min_surface_height = min_surface_heights[i],
+            .max_surface_height = max_surface_heights[i]
+        };
+    }
+}
+
+static result_t place_regions(void) {
+    result_t result;
+
+    // The generation in flight reads the region uniform buffer and writes the voxel images of the slots it generates, so every placement waits for it
+    if (is_region_generation_pending()) {
+        are_region_placements_pending = true;
+        return result_success;
+    }
+
+    if (region_generation_mode == region_generation_mode_cpu) {
+        update_region_columns();
+    }
+
+    are_region_placements_pending = false;
+    for (int32_t x = center_region_position.x - REGION_VIEW_RADIUS; x <= center_region_position.x + REGION_VIEW_RADIUS; x++) {
+        for (int32_t z = center_region_position.z - REGION_VIEW_RADIUS; z <= center_region_position.z + REGION_VIEW_RADIUS; z++) {
+            for (int32_t y = REGION_VIEW_MIN_Y; y <= REGION_VIEW_MAX_Y; y++) {
+                ivec3s region_position = {{ x, y, z }};
+                size_t region_index = get_region_index(region_position);
+
+                if (region_mesh_states[region_index] != region_mesh_state_unused && region_positions[region_index].x == x && region_positions[region_index].y == y && region_positions[region_index].z == z) {
+                    continue;
+                }
+
+                // Meshing batches in flight may still read the slot's voxel image or descriptor sets, so it keeps its old region until they've finished
+                // Frames in flight only read its faces, which are freed deferred, and its region info, whose uploads wait for the frames reading it
+                if (is_region_in_meshing_batch(region_index)) {
+                    are_region_placements_pending = true;
+                    continue;
+                }
+
+                if ((result = place_region(region_index, region_position, get_region_lod(get_region_distance(region_position, placement_camera_position)))) != result_success) {
+                    return result;
+                }
+            }
+        }
+    }
+
+    return result_success;
+}
+
+result_t update_region_management(vec3s camera_position) {
+    update_region_lods(camera_position);
+
+    // Only the horizontal position places regions, see REGION_VIEW_MIN_Y
+    ivec3s new_center_region_position = {{ (int32_t) floorf(camera_position.x / (float) REGION_SIZE), 0, (int32_t) floorf(camera_position.z / (float) REGION_SIZE) }};
+    if (has_center_region_position && new_center_region_position.x == center_region_position.x && new_center_region_position.z == center_region_position.z) {
+        return place_pending_regions();
+    }
+    has_center_region_position = true;
+    center_region_position = new_center_region_position;
+    placement_camera_position = camera_position;
+
+    return place_regions();
+}
+
+bool has_pending_region_placements(void) {
+    return are_region_placements_pending;
+}
+
+result_t place_pending_regions(void) {
+    return are_region_placements_pending ? place_regions() : result_success;
+}
+
+bool is_any_region_in_mesh_state(region_mesh_state_t mesh_state) {
+    for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
+        if (region_mesh_states[region_index] == mesh_state) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool get_generated_region_neighbour_index(size_t region_index, uint32_t face_index, size_t* neighbour_region_index) {
+    ivec3s region_position = region_positions[region_index];
+    ivec3s normal = face_normals[face_index];
+    ivec3s neighbour_position = {{ region_position.x + normal.x, region_position.y + normal.y, region_position.z + normal.z }};
+    size_t index = get_region_index(neighbour_position);
+
+    region_mesh_state_t mesh_state = region_mesh_states[index];
+    if (mesh_state == region_mesh_state_unused || mesh_state == region_mesh_state_await_generation || region_positions[index].x != neighbour_position.x || region_positions[index].y != neighbour_position.y || region_positions[index].z != neighbour_position.z) {
+        return false;
+    }
+
+    *neighbour_region_index = index;
+    return true;
+}
+
+static void set_region_faces(size_t region_index, uint32_t first_face, uint32_t num_faces) {
+    region_render_pipeline_infos[region_index] = (region_render_pipeline_info_t) {
+        .first_face = first_face,
+        .num_faces = num_faces
+    };
+    region_infos[region_index].first_face = first_face;
+    region_infos[region_index].num_faces = num_faces;
+    region_infos[region_index].lod = region_lods[region_index];
+    mark_region_info_dirty(region_index);
+}
+
+static void release_deferred_face_frees(bool is_device_idle) {
+    size_t num_kept_frees = 0;
+    for (size_t i = 0; i < num_deferred_face_frees; i++) {
+        deferred_face_free_t deferred_free = deferred_face_frees[i];
+
+        if (!is_device_idle && deferred_free.num_remaining_frames > 0) {
+            deferred_face_frees[num_kept_frees++] = deferred_free;
+            continue;
+        }
+
+        vmaVirtualFree(face_virtual_block, deferred_free.allocation);
+        num_deferred_free_faces -= deferred_free.num_faces;
+    }
+    num_deferred_face_frees = num_kept_frees;
+}
+
+result_t allocate_region_faces(size_t region_index, uint32_t num_faces) {
+    result_t result;
+    if ((result = free_region_faces(region_index)) != result_success) {
+        return result;
+    }
+
+    if (num_faces == 0) {
+        return result_success;
+    }
+
+    VmaVirtualAllocationCreateInfo allocation_create_info = {
+        .size = num_faces * sizeof(region_face_t),
+        .alignment = sizeof(region_face_t)
+    };
+    VkDeviceSize offset;
+    if (vmaVirtualAllocate(face_virtual_block, &allocation_create_info, &region_allocation_infos[region_index].face_allocation, &offset) != VK_SUCCESS) {
+        // The space may only be held by deferred frees, which can all be released once the frames in flight have finished
+        if (num_deferred_face_frees == 0) {
+            return result_virtual_allocate_failure;
+        }
+        if (vkQueueWaitIdle(queue) != VK_SUCCESS) {
+            return result_queue_wait_failure;
+        }
+        release_deferred_face_frees(true);
+
+        if (vmaVirtualAllocate(face_virtual_block, &allocation_create_info, &region_allocation_infos[region_index].face_allocation, &offset) != VK_SUCCESS) {
+            return result_virtual_allocate_failure;
+        }
+    }
+    set_region_faces(region_index, (uint32_t) (offset / sizeof(region_face_t)), num_faces);
+
+    return result_success;
+}
+
+result_t free_region_faces(size_t region_index) {
+    region_allocation_info_t* allocation_info = &region_allocation_infos[region_index];
+
+    if (allocation_info->face_allocation != VK_NULL_HANDLE) {
+        if (num_deferred_face_frees == MAX_NUM_DEFERRED_REGION_FACE_FREES) {
+            if (vkQueueWaitIdle(queue) != VK_SUCCESS) {
+                return result_queue_wait_failure;
+            }
+            release_deferred_face_frees(true);
+        }
+
+        // Frames recorded so far may still draw the faces until the last of them has finished
+        VkDeviceSize num_faces = region_render_pipeline_infos[region_index].num_faces;
+        deferred_face_frees[num_deferred_face_frees++] = (deferred_face_free_t) {
+            .allocation = allocation_info->face_allocation,
+            .num_faces = num_faces,
+            .num_remaining_frames = NUM_FRAMES_IN_FLIGHT
+        };
+        num_deferred_free_faces += num_faces;
+
+        allocation_info->face_allocation = VK_NULL_HANDLE;
+    }
+    set_region_faces(region_index, 0, 0);
+
+    return result_success;
+}
+
+void advance_deferred_region_face_frees(void) {
+    for (size_t i = 0; i < num_deferred_face_frees; i++) {
+        deferred_face_frees[i].num_remaining_frames--;
+    }
+    release_deferred_face_frees(false);
+}
+
+void get_region_face_buffer_stats(region_face_buffer_stats_t* stats) {
+    VmaDetailedStatistics statistics;
+    vmaCalculateVirtualBlockStatistics(face_virtual_block, &statistics);
+
+    VkDeviceSize num_free_faces = (statistics.statistics.blockBytes - statistics.statistics.allocationBytes) / sizeof(region_face_t);
+    VkDeviceSize largest_free_range_num_faces = statistics.unusedRangeCount > 0 ? statistics.unusedRangeSizeMax / sizeof(region_face_t) : 0;
+
+    *stats = (region_face_buffer_stats_t) {
+        .num_allocations = statistics.statistics.allocationCount,
+        .num_free_ranges = statistics.unusedRangeCount,
+        .num_used_faces = statistics.statistics.allocationBytes / sizeof(region_face_t),
+        .num_deferred_free_faces = num_deferred_free_faces,
+        .num_free_faces = num_free_faces,
+        .largest_free_range_num_faces = largest_free_range_num_faces,
+        .fragmentation = num_free_faces > 0 ? 1.0f - (float) largest_free_range_num_faces / (float) num_free_faces : 0.0f
+    };
+}
+
+result_t queue_region_info_uploads(uint32_t frame_index) {
+    result_t result;
+
+    bool* dirty_flags = region_info_dirty_flags[frame_index];
+    for (size_t region_index = 0; region_index < NUM_REGIONS; region_index++) {
+        if (!dirty_flags[region_index]) {
+            continue;
+        }
+
+        if ((result = queue_buffer_upload(region_info_buffers[frame_index], region_index * sizeof(region_info_t), sizeof(region_info_t), &region_infos[region_index])) != result_success) {
+            return result;
+        }
+        dirty_flags[region_index] = false;
+    }
+
+    return result_success;
+}
+
 void term_region_management(void) {
     vkDestroyDescriptorPool(device, descriptor_pool, NULL);
 
@@ -185,10 +1009,20 @@ void term_region_management(void) {
         region_allocation_info_t* allocation_info = &region_allocation_infos[region_index];
 
         vmaDestroyBuffer(allocator, allocation_info->uniform_buffer, allocation_info->uniform_buffer_allocation);
-        if (allocation_info->vertex_buffer != NULL && allocation_info->vertex_buffer_allocation != NULL) {
-            vmaDestroyBuffer(allocator, allocation_info->vertex_buffer, allocation_info->vertex_buffer_allocation);
-        }
-        vkDestroyImageView(device, allocation_info->voxel_image_view, NULL);
-        vmaDestroyImage(allocator, allocation_info->voxel_image, allocation_info->voxel_image_allocation);
+        free_region_faces(region_index);
+    }
+
+    for (size_t i = 0; i < num_voxel_images; i++) {
+        destroy_voxel_image(&voxel_images[i]);
+    }
+    for (size_t i = 0; i < NUM_VOXEL_TYPES; i++) {
+        destroy_voxel_image(&uniform_voxel_images[i]);
+    }
+
+    release_deferred_face_frees(true);
+    vmaDestroyVirtualBlock(face_virtual_block);
+    vmaDestroyBuffer(allocator, region_face_buffer, face_buffer_allocation);
+    for (size_t i = 0; i < NUM_FRAMES_IN_FLIGHT; i++) {
+        vmaDestroyBuffer(allocator, region_info_buffers[i], region_info_buffer_allocations[i]);
     }
 }
\ No newline at end of file
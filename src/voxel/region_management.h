@@ -1,20 +1,56 @@
 #pragma once
+#include "gfx/gfx.h"
+#include "gfx/region_generation_compute_pipeline.h"
+#include "gfx/region_meshing_compute_pipeline.h"
 #include "result.h"
+#include "voxel/region.h"
 #include <cglm/types-struct.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h>
 
-#define NUM_REGIONS 256
+// Regions within this many regions of the camera on each horizontal axis are kept resident
+#define REGION_VIEW_RADIUS 8
+#define REGION_VIEW_DIAMETER (2 * REGION_VIEW_RADIUS + 1)
+// Region y coordinate of a voxel height, rounded down
+#define GET_REGION_Y(HEIGHT) ((HEIGHT) >= 0 ? (HEIGHT) / (int32_t) REGION_SIZE : ((HEIGHT) + 1) / (int32_t) REGION_SIZE - 1)
+// Rows of regions the terrain surface can cross within a column, from the generator's height bounds
+#define NUM_REGION_SURFACE_ROWS (GET_REGION_Y(REGION_GENERATION_MAX_SURFACE_HEIGHT) - GET_REGION_Y(REGION_GENERATION_MIN_SURFACE_HEIGHT) + 1)
+// Vertically the view doesn't follow the camera, it holds every surface row and the rows bordering them so the terrain stays resident at any camera height
+#define REGION_VIEW_MIN_Y (GET_REGION_Y(REGION_GENERATION_MIN_SURFACE_HEIGHT) - 1)
+#define REGION_VIEW_MAX_Y (GET_REGION_Y(REGION_GENERATION_MAX_SURFACE_HEIGHT) + 1)
+#define REGION_VIEW_HEIGHT (REGION_VIEW_MAX_Y - REGION_VIEW_MIN_Y + 1)
+#define NUM_REGION_COLUMNS (REGION_VIEW_DIAMETER * REGION_VIEW_DIAMETER)
+#define NUM_REGIONS (NUM_REGION_COLUMNS * REGION_VIEW_HEIGHT)
+
+// Only regions with more than one voxel type keep a voxel image of their own, uniform ones share one per voxel type
+// CPU generation knows the uniform regions before copying, so its pool only needs one image per surface row in each column
+// GPU generation only finds them from the voxel type ranges it reads back, so every region holds an image until then and the pool covers all of them in one round
+// Regions wait to be generated while the pool is exhausted
+#define NUM_CPU_REGION_VOXEL_IMAGES (NUM_REGION_SURFACE_ROWS * NUM_REGION_COLUMNS)
+#define NUM_GPU_REGION_VOXEL_IMAGES NUM_REGIONS
+#define MAX_NUM_REGION_VOXEL_IMAGES (NUM_GPU_REGION_VOXEL_IMAGES > NUM_CPU_REGION_VOXEL_IMAGES ? NUM_GPU_REGION_VOXEL_IMAGES : NUM_CPU_REGION_VOXEL_IMAGES)
+
+// Regions whose nearest point is further than REGION_LOD_DISTANCE * 2^(l - 1) voxels from the camera are meshed at level of detail l
+#define REGION_LOD_DISTANCE 64.0f
+// Share of a switching distance a region has to move past it before its level of detail switches, so regions near it don't keep switching back and forth
+#define REGION_LOD_HYSTERESIS 0.1f
+
+// Capacity of the face buffer shared by all regions
+#define REGION_FACE_BUFFER_NUM_FACES (1u << 23)
+// Freed face ranges wait this many frames before they are reused, once the queue is drained instead if more are pending
+#define MAX_NUM_DEFERRED_REGION_FACE_FREES (4 * NUM_REGIONS)
 
 typedef struct {
-    VkDescriptorSet descriptor_sets[3];
+    VkDescriptorSet descriptor_sets[2];
     VkBuffer uniform_buffer;
     VmaAllocation uniform_buffer_allocation;
-    VkBuffer vertex_buffer;
-    VmaAllocation vertex_buffer_allocation;
-    VkImage voxel_image;
-    VmaAllocation voxel_image_allocation;
-    VkImageView voxel_image_view;
+    // Range of the shared face buffer, VK_NULL_HANDLE when the region has no faces
+    VmaVirtualAllocation face_allocation;
+    // Index into the voxel image pool, NULL_UINT32 when the region has none of its own
+    uint32_t voxel_image_index;
 } region_allocation_info_t;
 
 typedef struct {
@@ -24,26 +60,84 @@ typedef struct {
 
 typedef struct {
     VkDescriptorSet descriptor_set;
+    VkImageView voxel_image_view;
 } region_meshing_compute_pipeline_info_t;
 
 typedef struct {
-    VkDescriptorSet descriptor_set;
-    uint32_t num_vertices;
-    VkBuffer vertex_buffer;
+    uint32_t first_face;
+    uint32_t num_faces;
 } region_render_pipeline_info_t;
 
+typedef struct {
+    uint32_t num_allocations;
+    uint32_t num_free_ranges;
+    VkDeviceSize num_used_faces;
+    // Freed but still possibly drawn by frames in flight, included in num_used_faces
+    VkDeviceSize num_deferred_free_faces;
+    VkDeviceSize num_free_faces;
+    VkDeviceSize largest_free_range_num_faces;
+    // Share of the free faces outside of the largest free range
+    float fragmentation;
+} region_face_buffer_stats_t;
+
 typedef enum {
     region_mesh_state_completed,
+    region_mesh_state_unused,
+    region_mesh_state_await_generation,
     region_mesh_state_await_meshing_compute,
-    region_mesh_state_await_vertex_buffer_creation
+    region_mesh_state_await_face_buffer_creation
 } region_mesh_state_t;
 
 extern region_mesh_state_t region_mesh_states[NUM_REGIONS];
+extern ivec3s region_positions[NUM_REGIONS];
+// Level of detail each region is meshed at, see NUM_REGION_LODS
+extern uint8_t region_lods[NUM_REGIONS];
+// NULL_UINT8 unless every voxel of the generated region has the same type
+// Regions above or below the terrain surface of their column get theirs as soon as they're placed, they're never generated
+extern uint8_t region_uniform_voxel_types[NUM_REGIONS];
 
 extern region_allocation_info_t region_allocation_infos[NUM_REGIONS];
 extern region_generation_compute_pipeline_info_t region_generation_compute_pipeline_infos[NUM_REGIONS];
 extern region_meshing_compute_pipeline_info_t region_meshing_compute_pipeline_infos[NUM_REGIONS];
 extern region_render_pipeline_info_t region_render_pipeline_infos[NUM_REGIONS];
 
-result_t init_region_management(void);
+// Both cover the whole shared face buffer, the render sets also cover their frame's copy of the region infos indexed by region index
+extern VkDescriptorSet region_meshing_compute_pipeline_face_descriptor_set;
+extern VkDescriptorSet region_render_pipeline_descriptor_sets[NUM_FRAMES_IN_FLIGHT];
+// Cover their frame's copy of the region infos
+extern VkDescriptorSet region_culling_compute_pipeline_descriptor_sets[NUM_FRAMES_IN_FLIGHT];
+
+// Holds the faces of every region, also read back to check meshes against the CPU mesher
+extern VkBuffer region_face_buffer;
+
+// The shared uniform voxel images are filled with the command buffer on the compute queue
+// Regions are only known to be uniform from their column's surface bounds before generation when the CPU generates them, the GPU reports it once it has generated them
+result_t init_region_management(VkCommandBuffer command_buffer, VkFence command_fence, uint32_t graphics_queue_family_index, uint32_t compute_queue_family_index, uint32_t transfer_queue_family_index, region_generation_mode_t generation_mode, region_meshing_mode_t meshing_mode);
+// Also switches the levels of detail of regions whose distance to the camera changed, those and their meshed neighbours are meshed again
+// Slots still read by meshing batches in flight keep their old regions and are placed by a later update once the batches have finished
+result_t update_region_management(vec3s camera_position);
+bool has_pending_region_placements(void);
+// Places the regions an earlier update had to leave out, without moving the view
+result_t place_pending_regions(void);
+bool is_any_region_in_mesh_state(region_mesh_state_t mesh_state);
+// Only succeeds if the region adjacent across the given voxel face is resident and has been generated
+bool get_generated_region_neighbour_index(size_t region_index, uint32_t face_index, size_t* neighbour_region_index);
+// Gives the region a voxel image from the pool to be generated into, false if every image is in use
+// The image has a mip level per level of detail, written into through the generation set
+bool acquire_region_voxel_image(size_t region_index);
+bool has_free_region_voxel_image(void);
+// Returns the region's voxel image to the pool, it's meshed from the shared image of its voxel type instead
+void set_region_uniform_voxel_type(size_t region_index, uint8_t voxel_type);
+// Uniform regions can't have visible faces if they're air or every generated neighbour is solid along their shared border
+// Neighbours are solid there if they're uniformly solid or, with CPU generation, the border lies below the terrain surface of their column
+bool is_region_mesh_empty(size_t region_index);
+// Previous faces of the region are only reused once frames in flight can no longer draw them
+// If the buffer only has room once deferred frees are released, waits for the frames in flight and releases all of them
+result_t allocate_region_faces(size_t region_index, uint32_t num_faces);
+result_t free_region_faces(size_t region_index);
+// Must be called once per frame after waiting for the fence of the frame about to be recorded
+void advance_deferred_region_face_frees(void);
+void get_region_face_buffer_stats(region_face_buffer_stats_t* stats);
+// Queues uploads of the region infos changed since the frame's last call into its own copy, the flush must wait for the frame that last read that copy
+result_t queue_region_info_uploads(uint32_t frame_index);
 void term_region_management(void);
\ No newline at end of file
@@ -0,0 +1,318 @@
+#include "region_store.h"
+#include "util.h"
+#include "voxel/region.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ssize_t pread(int file, void* buffer, size_t num_bytes, off_t offset);
+ssize_t pwrite(int file, const void* buffer, size_t num_bytes, off_t offset);
+
+#define REGION_FILE_MAGIC 0x52475856u
+#define REGION_FILE_VERSION 1u
+
+#define NUM_REGION_VOXELS (REGION_SIZE * REGION_SIZE * REGION_SIZE)
+#define MAX_REGION_FILE_PATH_LENGTH 256
+// Encoded regions are gathered here so a batch of saves needs few writes
+#define REGION_STORE_WRITE_BUFFER_SIZE (1u << 20)
+
+static_assert(REGION_STORE_WRITE_BUFFER_SIZE >= MAX_ENCODED_REGION_SIZE);
+
+typedef struct {
+    // Zero if the region was never saved
+    uint32_t offset;
+    uint32_t size;
+} region_file_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    region_file_entry_t entries[REGION_FILE_NUM_REGIONS];
+} region_file_header_t;
+
+typedef struct {
+    uint32_t offset;
+    size_t region_index;
+} region_read_t;
+
+static uint8_t write_buffer[REGION_STORE_WRITE_BUFFER_SIZE];
+
+static int32_t floor_div(int32_t a, int32_t b) {
+    return a / b - (a % b < 0 ? 1 : 0);
+}
+
+region_file_location_t get_region_file_location(ivec3s region_position) {
+    ivec3s file_position = {{ floor_div(region_position.x, REGION_FILE_SIZE), floor_div(region_position.y, REGION_FILE_SIZE), floor_div(region_position.z, REGION_FILE_SIZE) }};
+
+    size_t local_x = (size_t) (region_position.x - file_position.x * REGION_FILE_SIZE);
+    size_t local_y = (size_t) (region_position.y - file_position.y * REGION_FILE_SIZE);
+    size_t local_z = (size_t) (region_position.z - file_position.z * REGION_FILE_SIZE);
+
+    return (region_file_location_t) {
+        .file_position = file_position,
+        .entry_index = local_x + REGION_FILE_SIZE * (local_y + REGION_FILE_SIZE * local_z)
+    };
+}
+
+static void get_region_file_path(ivec3s file_position, char path[MAX_REGION_FILE_PATH_LENGTH]) {
+    snprintf(path, MAX_REGION_FILE_PATH_LENGTH, REGION_STORE_DIRECTORY "/%" PRId32 ".%" PRId32 ".%" PRId32 ".region", file_position.x, file_position.y, file_position.z);
+}
+
+// Voxels are visited in y, z, x order since terrain tends to be uniform within horizontal layers
+static void get_voxel_row(size_t voxel_index, size_t* y, size_t* z, size_t* x) {
+    *y = voxel_index / (REGION_SIZE * REGION_SIZE);
+    *z = (voxel_index / REGION_SIZE) % REGION_SIZE;
+    *x = voxel_index % REGION_SIZE;
+}
+
+// Writes the number of palette entries minus one and the palette, followed by runs of a palette index and the run length minus one as 16 bits
+static size_t encode_region(const region_voxels_t* voxels, uint8_t data[MAX_ENCODED_REGION_SIZE]) {
+    uint16_t palette_indices[256];
+    memset(palette_indices, 0xff, sizeof(palette_indices));
+    uint8_t palette[256];
+    size_t num_palette_entries = 0;
+
+    for (size_t z = 0; z < REGION_SIZE; z++) {
+        for (size_t y = 0; y < REGION_SIZE; y++) {
+            for (size_t x = 0; x < REGION_SIZE; x++) {
+                uint8_t voxel_type = voxels->types[z][y][x];
+                if (palette_indices[voxel_type] == NULL_UINT16) {
+                    palette_indices[voxel_type] = (uint16_t) num_palette_entries;
+                    palette[num_palette_entries++] = voxel_type;
+                }
+            }
+        }
+    }
+
+    data[0] = (uint8_t) (num_palette_entries - 1);
+    memcpy(&data[1], palette, num_palette_entries);
+    size_t num_bytes = 1 + num_palette_entries;
+
+    size_t run_start = 0;
+    while (run_start < NUM_REGION_VOXELS) {
+        size_t y, z, x;
+        get_voxel_row(run_start, &y, &z, &x);
+        uint8_t voxel_type = voxels->types[z][y][x];
+
+        size_t run_end = run_start + 1;
+        while (run_end < NUM_REGION_VOXELS) {
+            get_voxel_row(run_end, &y, &z, &x);
+            if (voxels->types[z][y][x] != voxel_type) {
+                break;
+            }
+            run_end++;
+        }
+
+        size_t run_length = run_end - run_start - 1;
+        data[num_bytes] = (uint8_t) palette_indices[voxel_type];
+        data[num_bytes + 1] = (uint8_t) run_length;
+        data[num_bytes + 2] = (uint8_t) (run_length >> 8);
+        num_bytes += 3;
+
+        run_start = run_end;
+    }
+
+    return num_bytes;
+}
+
+// Palettes only hold the voxel types that occur, so a single entry means the region is uniform
+static result_t decode_region(const uint8_t* data, size_t num_bytes, region_voxels_t* voxels, uint8_t* uniform_voxel_type) {
+    if (num_bytes < 1) {
+        return result_region_file_invalid;
+    }
+    size_t num_palette_entries = (size_t) data[0] + 1;
+    if (1 + num_palette_entries > num_bytes) {
+        return result_region_file_invalid;
+    }
+    const uint8_t* palette = &data[1];
+    *uniform_voxel_type = num_palette_entries == 1 ? palette[0] : NULL_UINT8;
+
+    size_t offset = 1 + num_palette_entries;
+    size_t voxel_index = 0;
+    while (voxel_index < NUM_REGION_VOXELS) {
+        if (offset + 3 > num_bytes) {
+            return result_region_file_invalid;
+        }
+        size_t palette_index = data[offset];
+        size_t run_length = ((size_t) data[offset + 1] | ((size_t) data[offset + 2] << 8)) + 1;
+        offset += 3;
+
+        if (palette_index >= num_palette_entries || voxel_index + run_length > NUM_REGION_VOXELS) {
+            return result_region_file_invalid;
+        }
+
+        // Filled a row segment at a time
+        size_t run_end = voxel_index + run_length;
+        while (voxel_index < run_end) {
+            size_t y, z, x;
+            get_voxel_row(voxel_index, &y, &z, &x);
+            size_t num_row_voxels = REGION_SIZE - x < run_end - voxel_index ? REGION_SIZE - x : run_end - voxel_index;
+            memset(&voxels->types[z][y][x], palette[palette_index], num_row_voxels);
+            voxel_index += num_row_voxels;
+        }
+    }
+
+    return result_success;
+}
+
+result_t init_region_store(void) {
+    if (mkdir(REGION_STORE_DIRECTORY, 0755) != 0 && errno != EEXIST) {
+        return result_file_access_failure;
+    }
+    return result_success;
+}
+
+static int compare_region_reads(const void* a, const void* b) {
+    const region_read_t* read_a = a;
+    const region_read_t* read_b = b;
+    return (read_a->offset > read_b->offset) - (read_a->offset < read_b->offset);
+}
+
+result_t load_regions_from_file(ivec3s file_position, size_t num_regions, const size_t entry_indices[], region_voxels_t* const voxels[], bool is_found[], uint8_t uniform_voxel_types[]) {
+    assert(num_regions <= REGION_FILE_NUM_REGIONS);
+
+    for (size_t i = 0; i < num_regions; i++) {
+        is_found[i] = false;
+    }
+
+    char path[MAX_REGION_FILE_PATH_LENGTH];
+    get_region_file_path(file_position, path);
+
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return errno == ENOENT ? result_success : result_file_open_failure;
+    }
+
+    struct stat st;
+    if (fstat(file, &st) != 0) {
+        close(file);
+        return result_file_access_failure;
+    }
+    size_t file_size = (size_t) st.st_size;
+    if (file_size < sizeof(region_file_header_t)) {
+        close(file);
+        return result_region_file_invalid;
+    }
+
+    const uint8_t* mapped_file = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapped_file == MAP_FAILED) {
+        return result_file_map_failure;
+    }
+
+    result_t result = result_success;
+
+    const region_file_header_t* header = (const region_file_header_t*) mapped_file;
+    if (header->magic != REGION_FILE_MAGIC || header->version != REGION_FILE_VERSION) {
+        result = result_region_file_invalid;
+    }
+
+    region_read_t reads[REGION_FILE_NUM_REGIONS];
+    size_t num_reads = 0;
+    for (size_t i = 0; i < num_regions && result == result_success; i++) {
+        region_file_entry_t entry = header->entries[entry_indices[i]];
+        if (entry.offset == 0) {
+            continue;
+        }
+        if ((size_t) entry.offset + entry.size > file_size) {
+            result = result_region_file_invalid;
+            break;
+        }
+        reads[num_reads++] = (region_read_t) {
+            .offset = entry.offset,
+            .region_index = i
+        };
+    }
+
+    qsort(reads, num_reads, sizeof(region_read_t), compare_region_reads);
+
+    for (size_t i = 0; i < num_reads && result == result_success; i++) {
+        size_t region_index = reads[i].region_index;
+        region_file_entry_t entry = header->entries[entry_indices[region_index]];
+        result = decode_region(&mapped_file[entry.offset], entry.size, voxels[region_index], &uniform_voxel_types[region_index]);
+        is_found[region_index] = result == result_success;
+    }
+
+    munmap((void*) mapped_file, file_size);
+
+    return result;
+}
+
+result_t save_regions_to_file(ivec3s file_position, size_t num_regions, const size_t entry_indices[], const region_voxels_t* const voxels[]) {
+    assert(num_regions <= REGION_FILE_NUM_REGIONS);
+
+    char path[MAX_REGION_FILE_PATH_LENGTH];
+    get_region_file_path(file_position, path);
+
+    int file = open(path, O_RDWR | O_CREAT, 0644);
+    if (file < 0) {
+        return result_file_open_failure;
+    }
+
+    struct stat st;
+    if (fstat(file, &st) != 0) {
+        close(file);
+        return result_file_access_failure;
+    }
+    size_t file_size = (size_t) st.st_size;
+
+    // New files start with an empty offset table
+    region_file_header_t header = {
+        .magic = REGION_FILE_MAGIC,
+        .version = REGION_FILE_VERSION
+    };
+    if (file_size == 0) {
+        file_size = sizeof(header);
+    } else if (file_size < sizeof(header) || pread(file, &header, sizeof(header), 0) != (ssize_t) sizeof(header) || header.magic != REGION_FILE_MAGIC || header.version != REGION_FILE_VERSION) {
+        close(file);
+        return result_region_file_invalid;
+    }
+
+    size_t write_offset = file_size;
+    size_t num_buffered_bytes = 0;
+    for (size_t i = 0; i <= num_regions; i++) {
+        // Flushed before a region that might not fit and after the last one
+        if (i == num_regions || num_buffered_bytes + MAX_ENCODED_REGION_SIZE > REGION_STORE_WRITE_BUFFER_SIZE) {
+            if (pwrite(file, write_buffer, num_buffered_bytes, (off_t) write_offset) != (ssize_t) num_buffered_bytes) {
+                close(file);
+                return result_file_write_failure;
+            }
+            write_offset += num_buffered_bytes;
+            num_buffered_bytes = 0;
+        }
+        if (i == num_regions) {
+            break;
+        }
+
+        size_t num_bytes = encode_region(voxels[i], &write_buffer[num_buffered_bytes]);
+        size_t offset = write_offset + num_buffered_bytes;
+        if (offset + num_bytes > UINT32_MAX) {
+            close(file);
+            return result_region_file_invalid;
+        }
+
+        header.entries[entry_indices[i]] = (region_file_entry_t) {
+            .offset = (uint32_t) offset,
+            .size = (uint32_t) num_bytes
+        };
+        num_buffered_bytes += num_bytes;
+    }
+
+    // The regions are written before the table points at them
+    if (pwrite(file, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+        close(file);
+        return result_file_write_failure;
+    }
+
+    close(file);
+
+    return result_success;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "result.h"
+#include "voxel/region_voxels.h"
+#include <cglm/types-struct.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REGION_STORE_DIRECTORY "world"
+
+// Every region file holds a cube of this many regions per axis, found through an offset table at its start
+#define REGION_FILE_SIZE 8
+#define REGION_FILE_NUM_REGIONS (REGION_FILE_SIZE * REGION_FILE_SIZE * REGION_FILE_SIZE)
+
+// A palette entry count, the palette and one palette index plus length per run
+#define MAX_ENCODED_REGION_SIZE (1 + 256 + 3 * REGION_SIZE * REGION_SIZE * REGION_SIZE)
+
+typedef struct {
+    // Measured in region files
+    ivec3s file_position;
+    size_t entry_index;
+} region_file_location_t;
+
+result_t init_region_store(void);
+region_file_location_t get_region_file_location(ivec3s region_position);
+// Maps the file once and decodes at most REGION_FILE_NUM_REGIONS regions in file order, so readahead turns them into large sequential reads
+// Each region is decoded straight into its voxels, which may be upload staging memory, regions that were never saved aren't found
+// Found regions also get their voxel type if every voxel has the same one, NULL_UINT8 otherwise
+result_t load_regions_from_file(ivec3s file_position, size_t num_regions, const size_t entry_indices[], region_voxels_t* const voxels[], bool is_found[], uint8_t uniform_voxel_types[]);
+// Appends at most REGION_FILE_NUM_REGIONS regions with as few writes as possible, then points the offset table at them
+// The space of previous saves isn't reclaimed, and saves must come from one thread at a time
+result_t save_regions_to_file(ivec3s file_position, size_t num_regions, const size_t entry_indices[], const region_voxels_t* const voxels[]);
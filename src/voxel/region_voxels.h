@@ -0,0 +1,8 @@
+#pragma once
+#include "voxel/region.h"
+#include <stdint.h>
+
+// Laid out like a region's voxel image, indexed by z, y then x
+typedef struct {
+    uint8_t types[REGION_SIZE][REGION_SIZE][REGION_SIZE];
+} region_voxels_t;
@@ -18,4 +18,6 @@
 #define VOXEL_TYPE_STONE 2u
 #define VOXEL_TYPE_DIRT 3u
 
+#define NUM_VOXEL_TYPES 4u
+
 #endif
\ No newline at end of file